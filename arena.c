@@ -0,0 +1,102 @@
+/*
+ * arena.c
+ */
+
+#include <stdlib.h>
+
+#include "arena.h"
+#include "util.h"
+
+
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define ARENA_ALIGN 16
+#define ARENA_CHUNK_LEN_DEF 256
+#define ARENA_CHUNK_LEN_MAX 65536
+
+
+/*
+ * LOCAL DATA TYPES
+ */
+
+typedef struct arenaChunkType {
+	struct arenaChunkType *next;
+	size_t len;
+	size_t used;
+} arenaChunkType;
+
+struct arenaType {
+	arenaChunkType *chunk;
+};
+
+
+/*
+ * LOCAL FUNCTIONS
+ */
+
+static arenaChunkType *arenaNewChunk(size_t len);
+
+
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_HEADER_LEN ARENA_ROUND(sizeof(arenaChunkType))
+
+
+void *arenaAlloc(arenaType *a, size_t len) {
+	arenaChunkType *c = a->chunk;
+	size_t cLen = ARENA_CHUNK_LEN_DEF;
+	void *p;
+	len = ARENA_ROUND(len);
+	if (c == NULL || c->len - c->used < len) {
+		if (c != NULL && c->len < ARENA_CHUNK_LEN_MAX) {
+			cLen = c->len << 1;
+		}
+		if ((c = arenaNewChunk(len > cLen ? len : cLen)) == NULL) {
+			return(NULL);
+		}
+		c->next = a->chunk;
+		a->chunk = c;
+	}
+	p = (char *)c + ARENA_HEADER_LEN + c->used;
+	c->used += len;
+	return(p);
+}
+
+
+void arenaFree(arenaType *a) {
+	arenaChunkType *c;
+	arenaChunkType *n;
+	if (a == NULL) {
+		return;
+	}
+	for (c = a->chunk; c != NULL; c = n) {
+		n = c->next;
+		free(c);
+	}
+	free(a);
+}
+
+
+arenaType *arenaNew(void) {
+	arenaType *a;
+	if ((a = malloc(sizeof(arenaType))) == NULL) {
+		utilError("couldn't allocate memory");
+		return(NULL);
+	}
+	a->chunk = NULL;
+	return(a);
+}
+
+
+static arenaChunkType *arenaNewChunk(size_t len) {
+	arenaChunkType *c;
+	if ((c = malloc(ARENA_HEADER_LEN + len)) == NULL) {
+		utilError("couldn't allocate memory");
+		return(NULL);
+	}
+	c->next = NULL;
+	c->len = len;
+	c->used = 0;
+	return(c);
+}
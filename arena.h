@@ -0,0 +1,64 @@
+/*
+ * arena.h
+ *
+ * Arena allocator. Memory is handed out from large chunks and is only ever
+ * released all at once, when the arena itself is freed. Each program line
+ * keeps the expression trees, instructions and compiled code parsed from it
+ * in its own arena, so replacing or deleting a line releases them in bulk.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+
+#include <stddef.h>
+
+
+/*
+ * GLOBAL DATA TYPES
+ */
+
+typedef struct arenaType arenaType;
+
+
+/*
+ * GLOBAL FUNCTIONS
+ */
+
+
+/*
+ * arenaAlloc
+ *
+ * Allocate len bytes from arena a. The memory is suitably aligned for any
+ * object and stays valid until the arena is freed.
+ *
+ * Returns
+ *
+ *	NULL = error
+ *	otherwise, the allocated memory
+ */
+extern void *arenaAlloc(arenaType *a, size_t len);
+
+
+/*
+ * arenaFree
+ *
+ * Release arena a and everything allocated from it.
+ */
+extern void arenaFree(arenaType *a);
+
+
+/*
+ * arenaNew
+ *
+ * Create an empty arena.
+ *
+ * Returns
+ *
+ *	NULL = error
+ *	otherwise, the new arena
+ */
+extern arenaType *arenaNew(void);
+
+
+#endif /* ARENA_H */
@@ -0,0 +1,14 @@
+10 rem *** dense numeric matrix fill and sum
+20 dim a(1000,1000)
+30 for i = 1 to 1000
+40 for j = 1 to 1000
+50 a(i,j) = i + j
+60 next j
+70 next i
+80 s = 0
+90 for i = 1 to 1000
+100 for j = 1 to 1000
+110 s = s + a(i,j)
+120 next j
+130 next i
+140 print s
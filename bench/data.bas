@@ -0,0 +1,12 @@
+10 rem *** DATA/READ throughput
+20 s = 0
+30 for k = 1 to 20000
+40 restore
+50 for i = 1 to 20
+60 read d
+70 s = s + d
+80 next i
+90 next k
+100 print s
+200 data 1,2,3,4,5,6,7,8,9,10
+210 data 11,12,13,14,15,16,17,18,19,20
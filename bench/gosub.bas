@@ -0,0 +1,13 @@
+10 rem *** GOSUB-heavy recursion
+20 c = 0
+30 for k = 1 to 2000
+40 n = 500
+50 gosub 100
+60 next k
+70 print c
+80 end
+100 c = c + 1
+110 if n = 0 then 150
+120 n = n - 1
+130 gosub 100
+150 return
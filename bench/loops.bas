@@ -0,0 +1,8 @@
+10 rem *** tight nested FOR loops
+20 s = 0
+30 for i = 1 to 3000
+40 for j = 1 to 1000
+50 s = s + j
+60 next j
+70 next i
+80 print s
@@ -0,0 +1,13 @@
+10 rem *** ON dispatch: a four-state machine
+20 s = 1 : c = 0
+30 for k = 1 to 500000
+40 on s gosub 100, 200, 300, 400
+50 next k
+60 print c
+70 end
+100 c = c + 1 : s = 2 : return
+200 c = c + 2 : s = 3 : return
+300 on 1 goto 310, 320
+310 c = c + 3 : s = 4 : return
+320 print "wrong" : end
+400 c = c + 4 : s = 1 : return
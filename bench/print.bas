@@ -0,0 +1,4 @@
+10 rem *** PRINT-heavy output
+20 for i = 1 to 200000
+30 print "line "; i; " of output "; i * 2
+40 next i
@@ -0,0 +1,55 @@
+#!/bin/sh
+#
+# run.sh
+#
+# Run each benchmark program non-interactively and report wall time,
+# statements executed per second and peak resident set size. The
+# interpreter binary defaults to ../abasic relative to this directory;
+# pass another path as the first argument to compare builds.
+#
+
+dir=$(cd "$(dirname "$0")" && pwd)
+abasic=${1:-$dir/../abasic}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# Large-program LOAD: the matrix demo renumbered and repeated until the
+# program is a few megabytes long. Only LOAD is timed, the program isn't run.
+# The same program is saved as an image to time CLOAD against it.
+awk 'BEGIN { n = 0 }
+	{ src[n++] = $0 }
+	END {
+		for (r = 0; r < 4000; r++) {
+			for (i = 0; i < n; i++) {
+				line = src[i]
+				sub(/^[0-9]+/, "", line)
+				print (r * n + i + 1) * 10 line
+			}
+		}
+	}' "$dir/../demos/matrix.bas" > "$tmp/load.bas"
+
+# run name input [args...]
+#
+# Run abasic with the given arguments, feeding it input on stdin.
+run() {
+	name=$1
+	input=$2
+	shift 2
+	start=$(date +%s%N)
+	printf "$input" | ABASIC_STATS=1 "$abasic" "$@" > "$tmp/out" 2> "$tmp/stats"
+	end=$(date +%s%N)
+	awk -v name="$name" -v ns=$((end - start)) '
+		{ v[$1] = $2 }
+		END {
+			s = ns / 1e9
+			printf "%-10s %8.3f s %14.0f stmt/s %8d KB\n", name, s, v["statements"] / s, v["maxrss"]
+		}' "$tmp/stats"
+}
+
+printf "%-10s %10s %21s %11s\n" "benchmark" "wall" "throughput" "peak rss"
+for f in "$dir"/*.bas; do
+	run "$(basename "$f" .bas)" '' "$f"
+done
+run load "load \"$tmp/load.bas\"\nbye\n"
+printf 'load "%s"\ncsave "%s"\nbye\n' "$tmp/load.bas" "$tmp/load.img" | "$abasic" > /dev/null
+run cload "cload \"$tmp/load.img\"\nbye\n"
@@ -0,0 +1,10 @@
+10 rem *** string array churn
+20 dim a$(100), b$(100)
+30 for k = 1 to 2000
+40 for i = 1 to 100
+50 a$(i) = str$(i * k)
+60 b$(i) = a$(i)
+70 c$ = chr$(65 + i - int(i / 26) * 26)
+80 next i
+90 next k
+100 print b$(100); " "; c$
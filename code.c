@@ -0,0 +1,641 @@
+/*
+ * code.c
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "code.h"
+#include "scan.h"
+#include "util.h"
+#include "value.h"
+#include "var.h"
+
+
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define CODE_LEN_DEF 16
+
+
+/*
+ * LOCAL DATA TYPES
+ */
+
+typedef struct codeBuildType {
+	arenaType *arena;
+	codeOpType *ops;
+	unsigned long int len;
+	unsigned long int maxLen;
+	long int depth;
+	long int maxDepth;
+} codeBuildType;
+
+
+/*
+ * LOCAL FUNCTIONS
+ */
+
+static codeOpType *codeEmit(codeBuildType *b, opcodes op, int effect);
+static int codeEmitTree(codeBuildType *b, symbolType *e);
+static int codeFold(codeBuildType *b, unsigned long int start);
+static void codeNumeric(valueType *v);
+
+
+codeType *codeCompile(symbolType *e, arenaType *a) {
+	codeBuildType b;
+	codeType *c = NULL;
+	b.arena = a;
+	b.len = 0;
+	b.maxLen = CODE_LEN_DEF;
+	b.depth = 0;
+	b.maxDepth = 0;
+	if ((b.ops = malloc(sizeof(codeOpType) * b.maxLen)) == NULL) {
+		utilError("couldn't allocate memory");
+		goto err;
+	}
+	if (codeEmitTree(&b, e)) {
+		goto err;
+	}
+	if (codeEmit(&b, opEnd, 0) == NULL) {
+		goto err;
+	}
+	if ((c = arenaAlloc(a, sizeof(codeType) + sizeof(codeOpType) * b.len)) == NULL) {
+		goto err;
+	}
+	c->len = b.len;
+	c->depth = b.maxDepth;
+	memcpy(c->ops, b.ops, sizeof(codeOpType) * b.len);
+	free(b.ops);
+	return(c);
+err:
+	if (b.ops != NULL) {
+		free(b.ops);
+	}
+	return(NULL);
+}
+
+
+static codeOpType *codeEmit(codeBuildType *b, opcodes op, int effect) {
+	codeOpType *o;
+	if (b->len == b->maxLen) {
+		b->maxLen <<= 1;
+		if ((o = realloc(b->ops, sizeof(codeOpType) * b->maxLen)) == NULL) {
+			utilError("couldn't allocate memory");
+			return(NULL);
+		}
+		b->ops = o;
+	}
+	o = &b->ops[b->len++];
+	o->op = op;
+	o->arg.s = NULL;
+	b->depth += effect;
+	if (b->depth > b->maxDepth) {
+		b->maxDepth = b->depth;
+	}
+	return(o);
+}
+
+
+static int codeEmitTree(codeBuildType *b, symbolType *e) {
+	unsigned long int start = b->len;
+	codeOpType *o;
+	opcodes op;
+	if (e == NULL) {
+		utilError("expected expression");
+		return(1);
+	}
+	switch (e->id) {
+		case kwNumeric:
+			if ((o = codeEmit(b, opPushNumeric, 1)) == NULL) {
+				return(1);
+			}
+			o->arg.n = strtod(e->value, NULL);
+			return(0);
+		case kwString:
+			if ((o = codeEmit(b, opPushString, 1)) == NULL) {
+				return(1);
+			}
+			if ((o->arg.s = valueStringIntern(e->value)) == NULL) {
+				return(1);
+			}
+			return(0);
+		case kwIdentifier:
+			if (e->l == NULL) {
+				if ((o = codeEmit(b, opLoad, 1)) == NULL) {
+					return(1);
+				}
+			} else {
+				if (codeEmitTree(b, e->l)) {
+					return(1);
+				}
+				if (e->r != NULL) {
+					if (codeEmitTree(b, e->r)) {
+						return(1);
+					}
+				} else {
+					if ((o = codeEmit(b, opPushNumeric, 1)) == NULL) {
+						return(1);
+					}
+					o->arg.n = 1;
+				}
+				if ((o = codeEmit(b, opLoadArray, -1)) == NULL) {
+					return(1);
+				}
+			}
+			o->arg.slot = e->slot;
+			return(0);
+		case kwSubExpression:
+			return(codeEmitTree(b, e->r));
+		case kwOpAdd:
+		case kwOpSub:
+		case kwOpMul:
+		case kwOpDiv:
+		case kwOpExp:
+		case kwLogicalLT:
+		case kwLogicalLTE:
+		case kwLogicalEQ:
+		case kwLogicalNE:
+		case kwLogicalGT:
+		case kwLogicalGTE:
+		case kwOR:
+		case kwAND:
+			switch (e->id) {
+				case kwOpAdd:
+					op = opAdd;
+					break;
+				case kwOpSub:
+					op = opSub;
+					break;
+				case kwOpMul:
+					op = opMul;
+					break;
+				case kwOpDiv:
+					op = opDiv;
+					break;
+				case kwOpExp:
+					op = opPow;
+					break;
+				case kwLogicalLT:
+					op = opLT;
+					break;
+				case kwLogicalLTE:
+					op = opLTE;
+					break;
+				case kwLogicalEQ:
+					op = opEQ;
+					break;
+				case kwLogicalNE:
+					op = opNE;
+					break;
+				case kwLogicalGT:
+					op = opGT;
+					break;
+				case kwLogicalGTE:
+					op = opGTE;
+					break;
+				case kwOR:
+					op = opOr;
+					break;
+				default:
+					op = opAnd;
+					break;
+			}
+			if (codeEmitTree(b, e->l) || codeEmitTree(b, e->r)) {
+				return(1);
+			}
+			if (codeEmit(b, op, -1) == NULL) {
+				return(1);
+			}
+			return(codeFold(b, start));
+		case kwSignPlus:
+		case kwSignMinus:
+		case kwNOT:
+			if (codeEmitTree(b, e->r)) {
+				return(1);
+			}
+			if (e->id == kwSignPlus) {
+				op = opPlus;
+			} else if (e->id == kwSignMinus) {
+				op = opMinus;
+			} else {
+				op = opNot;
+			}
+			if (codeEmit(b, op, 0) == NULL) {
+				return(1);
+			}
+			return(codeFold(b, start));
+		case kwABS:
+		case kwASC:
+		case kwATN:
+		case kwCLOG:
+		case kwCOS:
+		case kwEXP:
+		case kwINT:
+		case kwLEN:
+		case kwLOG:
+		case kwRND:
+		case kwSGN:
+		case kwSIN:
+		case kwSQR:
+		case kwVAL:
+		case kwCHR:
+		case kwSTR:
+			switch (e->id) {
+				case kwABS:
+					op = opAbs;
+					break;
+				case kwASC:
+					op = opAsc;
+					break;
+				case kwATN:
+					op = opAtn;
+					break;
+				case kwCLOG:
+					op = opClog;
+					break;
+				case kwCOS:
+					op = opCos;
+					break;
+				case kwEXP:
+					op = opExp;
+					break;
+				case kwINT:
+					op = opInt;
+					break;
+				case kwLEN:
+					op = opLen;
+					break;
+				case kwLOG:
+					op = opLog;
+					break;
+				case kwRND:
+					op = opRnd;
+					break;
+				case kwSGN:
+					op = opSgn;
+					break;
+				case kwSIN:
+					op = opSin;
+					break;
+				case kwSQR:
+					op = opSqr;
+					break;
+				case kwVAL:
+					op = opVal;
+					break;
+				case kwCHR:
+					op = opChr;
+					break;
+				default:
+					op = opStr;
+					break;
+			}
+			if (codeEmitTree(b, e->l)) {
+				return(1);
+			}
+			if (codeEmit(b, op, 0) == NULL) {
+				return(1);
+			}
+			return(codeFold(b, start));
+	}
+	utilError("unable to compile expression");
+	return(1);
+}
+
+
+/*
+ * The dispatch loop uses computed goto where the compiler supports it, and
+ * falls back to a switch otherwise. sp always points at the first free stack
+ * entry; entries at and above sp hold no string.
+ */
+int codeExecute(codeType *c, valueType *r) {
+	valueType stack[c->depth + 1];
+	valueType *sp = stack;
+	codeOpType *pc = c->ops;
+	char b[VALUE_NUMERIC_LEN];
+	char *s;
+	unsigned long int i;
+	long int d1;
+	long int d2;
+	double d;
+	int cmp;
+	for (i = 0; i <= c->depth; i++) {
+		stack[i].type = valNumeric;
+		stack[i].s = NULL;
+	}
+#ifdef __GNUC__
+	static void *labels[opNumOps] = {
+		[opEnd] = &&LopEnd,
+		[opPushNumeric] = &&LopPushNumeric,
+		[opPushString] = &&LopPushString,
+		[opLoad] = &&LopLoad,
+		[opLoadArray] = &&LopLoadArray,
+		[opAdd] = &&LopAdd,
+		[opSub] = &&LopSub,
+		[opMul] = &&LopMul,
+		[opDiv] = &&LopDiv,
+		[opPow] = &&LopPow,
+		[opLT] = &&LopLT,
+		[opLTE] = &&LopLTE,
+		[opEQ] = &&LopEQ,
+		[opNE] = &&LopNE,
+		[opGT] = &&LopGT,
+		[opGTE] = &&LopGTE,
+		[opPlus] = &&LopPlus,
+		[opMinus] = &&LopMinus,
+		[opAbs] = &&LopAbs,
+		[opAsc] = &&LopAsc,
+		[opAtn] = &&LopAtn,
+		[opClog] = &&LopClog,
+		[opCos] = &&LopCos,
+		[opExp] = &&LopExp,
+		[opInt] = &&LopInt,
+		[opLen] = &&LopLen,
+		[opLog] = &&LopLog,
+		[opRnd] = &&LopRnd,
+		[opSgn] = &&LopSgn,
+		[opSin] = &&LopSin,
+		[opSqr] = &&LopSqr,
+		[opVal] = &&LopVal,
+		[opChr] = &&LopChr,
+		[opStr] = &&LopStr,
+		[opOr] = &&LopOr,
+		[opAnd] = &&LopAnd,
+		[opNot] = &&LopNot
+	};
+#define OP(o) L##o
+#define NEXT pc++; goto *labels[pc->op]
+	goto *labels[pc->op];
+#else
+#define OP(o) case o
+#define NEXT pc++; continue
+	for (;;) switch (pc->op) {
+#endif
+	OP(opEnd):
+		valueClear(r);
+		*r = sp[-1];
+		sp[-1].s = NULL;
+		return(0);
+	OP(opPushNumeric):
+		sp->type = valNumeric;
+		sp->n = pc->arg.n;
+		sp++;
+		NEXT;
+	OP(opPushString):
+		/* Literals are interned, so no reference needs to be taken. */
+		sp->type = valString;
+		sp->s = pc->arg.s;
+		sp++;
+		NEXT;
+	OP(opLoad):
+		if (varGetValue(pc->arg.slot, 1, 1, sp)) {
+			goto err;
+		}
+		sp++;
+		NEXT;
+	OP(opLoadArray):
+		codeNumeric(&sp[-2]);
+		codeNumeric(&sp[-1]);
+		d1 = sp[-2].n;
+		d2 = sp[-1].n;
+		sp--;
+		if (varGetValue(pc->arg.slot, d1, d2, &sp[-1])) {
+			goto err;
+		}
+		NEXT;
+	OP(opAdd):
+		sp--;
+		codeNumeric(&sp[-1]);
+		codeNumeric(sp);
+		sp[-1].n += sp->n;
+		NEXT;
+	OP(opSub):
+		sp--;
+		codeNumeric(&sp[-1]);
+		codeNumeric(sp);
+		sp[-1].n -= sp->n;
+		NEXT;
+	OP(opMul):
+		sp--;
+		codeNumeric(&sp[-1]);
+		codeNumeric(sp);
+		sp[-1].n *= sp->n;
+		NEXT;
+	OP(opDiv):
+		sp--;
+		codeNumeric(&sp[-1]);
+		codeNumeric(sp);
+		sp[-1].n /= sp->n;
+		NEXT;
+	OP(opPow):
+		sp--;
+		codeNumeric(&sp[-1]);
+		codeNumeric(sp);
+		sp[-1].n = pow(sp[-1].n, sp->n);
+		NEXT;
+	OP(opLT):
+	OP(opLTE):
+	OP(opEQ):
+	OP(opNE):
+	OP(opGT):
+	OP(opGTE):
+		sp--;
+		if (sp[-1].type == valString || sp->type == valString) {
+			cmp = valueCompare(&sp[-1], sp);
+			valueClear(sp);
+			valueClear(&sp[-1]);
+		} else {
+			cmp = (sp[-1].n > sp->n) - (sp[-1].n < sp->n);
+		}
+		switch (pc->op) {
+			case opLT:
+				sp[-1].n = cmp < 0;
+				break;
+			case opLTE:
+				sp[-1].n = cmp <= 0;
+				break;
+			case opEQ:
+				sp[-1].n = cmp == 0;
+				break;
+			case opNE:
+				sp[-1].n = cmp != 0;
+				break;
+			case opGT:
+				sp[-1].n = cmp > 0;
+				break;
+			default:
+				sp[-1].n = cmp >= 0;
+				break;
+		}
+		NEXT;
+	OP(opPlus):
+		codeNumeric(&sp[-1]);
+		NEXT;
+	OP(opMinus):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = 0 - sp[-1].n;
+		NEXT;
+	OP(opAbs):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = fabs(sp[-1].n);
+		NEXT;
+	OP(opAsc):
+	OP(opLen):
+		if (sp[-1].type == valString) {
+			d = pc->op == opAsc ? (sp[-1].s != NULL ? sp[-1].s[0] : 0) : valueStringLength(sp[-1].s);
+		} else {
+			valueFormatNumeric(sp[-1].n, b);
+			d = pc->op == opAsc ? b[0] : strlen(b);
+		}
+		valueSetNumeric(&sp[-1], d);
+		NEXT;
+	OP(opAtn):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = atan(sp[-1].n);
+		NEXT;
+	OP(opClog):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = log10(sp[-1].n);
+		NEXT;
+	OP(opCos):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = cos(sp[-1].n);
+		NEXT;
+	OP(opExp):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = exp(sp[-1].n);
+		NEXT;
+	OP(opInt):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = trunc(sp[-1].n);
+		NEXT;
+	OP(opLog):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = log(sp[-1].n);
+		NEXT;
+	OP(opRnd):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = (double)rand() / (double)RAND_MAX;
+		NEXT;
+	OP(opSgn):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = (sp[-1].n > 0) - (sp[-1].n < 0);
+		NEXT;
+	OP(opSin):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = sin(sp[-1].n);
+		NEXT;
+	OP(opSqr):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = sqrt(sp[-1].n);
+		NEXT;
+	OP(opVal):
+		codeNumeric(&sp[-1]);
+		NEXT;
+	OP(opChr):
+		codeNumeric(&sp[-1]);
+		b[0] = (char)trunc(sp[-1].n);
+		b[1] = 0;
+		if ((s = valueStringIntern(b)) == NULL) {
+			goto err;
+		}
+		valueSetStringRef(&sp[-1], s);
+		NEXT;
+	OP(opStr):
+		codeNumeric(&sp[-1]);
+		if (valueSetString(&sp[-1], valueFormatNumeric(sp[-1].n, b))) {
+			goto err;
+		}
+		NEXT;
+	OP(opOr):
+		sp--;
+		codeNumeric(&sp[-1]);
+		codeNumeric(sp);
+		sp[-1].n = sp[-1].n || sp->n;
+		NEXT;
+	OP(opAnd):
+		sp--;
+		codeNumeric(&sp[-1]);
+		codeNumeric(sp);
+		sp[-1].n = sp[-1].n && sp->n;
+		NEXT;
+	OP(opNot):
+		codeNumeric(&sp[-1]);
+		sp[-1].n = !sp[-1].n;
+		NEXT;
+#ifndef __GNUC__
+	}
+#endif
+#undef OP
+#undef NEXT
+err:
+	while (sp > stack) {
+		sp--;
+		valueClear(sp);
+	}
+	return(1);
+}
+
+
+/*
+ * Operands of the operation just emitted are all constants when everything
+ * from start up to it is a push, since any foldable operand has already
+ * been folded to one. The operation is then run now and replaced by a push
+ * of its result. RND is never folded. Only the code changes; the tree is
+ * left as parsed so LIST shows what was typed.
+ */
+static int codeFold(codeBuildType *b, unsigned long int start) {
+	codeType *t;
+	valueType v = {valNumeric, 0, NULL};
+	codeOpType *o = &b->ops[b->len - 1];
+	unsigned long int i;
+	char *s;
+	if (o->op == opRnd || b->len - start > 3) {
+		return(0);
+	}
+	for (i = start; i < b->len - 1; i++) {
+		if (b->ops[i].op != opPushNumeric && b->ops[i].op != opPushString) {
+			return(0);
+		}
+	}
+	if ((t = malloc(sizeof(codeType) + sizeof(codeOpType) * (b->len - start + 1))) == NULL) {
+		utilError("couldn't allocate memory");
+		return(1);
+	}
+	t->len = b->len - start + 1;
+	t->depth = b->len - start;
+	memcpy(t->ops, &b->ops[start], sizeof(codeOpType) * (b->len - start));
+	t->ops[b->len - start].op = opEnd;
+	i = codeExecute(t, &v);
+	free(t);
+	if (i) {
+		return(1);
+	}
+	b->depth--;
+	b->len = start;
+	if (v.type == valString) {
+		if ((s = valueStringIntern(v.s)) == NULL) {
+			valueClear(&v);
+			return(1);
+		}
+		o = codeEmit(b, opPushString, 1);
+		o->arg.s = s;
+	} else {
+		o = codeEmit(b, opPushNumeric, 1);
+		o->arg.n = v.n;
+	}
+	valueClear(&v);
+	return(0);
+}
+
+
+static void codeNumeric(valueType *v) {
+	if (v->type == valString) {
+		valueSetNumeric(v, valueGetNumeric(v));
+	}
+}
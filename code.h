@@ -0,0 +1,112 @@
+/*
+ * code.h
+ *
+ * Expression compiler and virtual machine. An expression tree built by the
+ * parser is lowered once into a flat array of stack machine operations,
+ * which is then run by a dispatch loop each time the expression is
+ * evaluated. The tree itself is kept for LIST and SAVE.
+ */
+
+#ifndef CODE_H
+#define CODE_H
+
+
+#include "arena.h"
+#include "scan.h"
+#include "value.h"
+
+
+/*
+ * GLOBAL DATA TYPES
+ */
+
+typedef enum {
+	opEnd,
+	opPushNumeric,
+	opPushString,
+	opLoad,
+	opLoadArray,
+	opAdd,
+	opSub,
+	opMul,
+	opDiv,
+	opPow,
+	opLT,
+	opLTE,
+	opEQ,
+	opNE,
+	opGT,
+	opGTE,
+	opPlus,
+	opMinus,
+	opAbs,
+	opAsc,
+	opAtn,
+	opClog,
+	opCos,
+	opExp,
+	opInt,
+	opLen,
+	opLog,
+	opRnd,
+	opSgn,
+	opSin,
+	opSqr,
+	opVal,
+	opChr,
+	opStr,
+	opOr,
+	opAnd,
+	opNot,
+	opNumOps
+} opcodes;
+
+typedef struct codeOpType {
+	opcodes op;
+	union {
+		double n;
+		char *s;
+		long int slot;
+	} arg;
+} codeOpType;
+
+typedef struct codeType {
+	unsigned long int len;
+	unsigned long int depth;
+	codeOpType ops[];
+} codeType;
+
+
+/*
+ * GLOBAL FUNCTIONS
+ */
+
+
+/*
+ * codeCompile
+ *
+ * Compile the expression tree e into arena a. String literals are interned,
+ * so the code doesn't depend on the tree once it is compiled.
+ *
+ * Returns
+ *
+ *	NULL = error
+ *	otherwise, the compiled expression
+ */
+extern codeType *codeCompile(symbolType *e, arenaType *a);
+
+
+/*
+ * codeExecute
+ *
+ * Run the compiled expression c and store its result in r.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int codeExecute(codeType *c, valueType *r);
+
+
+#endif /* CODE_H */
@@ -0,0 +1,980 @@
+/*
+ * emit.c
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "emit.h"
+#include "interp.h"
+#include "io.h"
+#include "scan.h"
+#include "util.h"
+
+
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define EMIT_VARIABLES_LEN_DEF 64
+
+
+/*
+ * LOCAL DATA TYPES
+ */
+
+/*
+ * A variable of the program, by slot. One that is ever subscripted or
+ * dimensioned is kept as a basArray; any other is a plain double or char *,
+ * which the C compiler can keep in a register. name is NULL for a slot the
+ * program doesn't use.
+ */
+typedef struct emitVariableType {
+	const char *name;
+	int array;
+	int string;
+} emitVariableType;
+
+/*
+ * The translation one interpreter is making.
+ */
+typedef struct emitStateType {
+	emitVariableType *variables;
+	long int variablesLen;
+	unsigned long int tempNext;
+} emitStateType;
+
+
+/*
+ * LOCAL DATA
+ *
+ * The first three name the state of the current interpreter.
+ */
+
+#define emitVariables (interpCurrent->emitState->variables)
+#define emitVariablesLen (interpCurrent->emitState->variablesLen)
+#define emitTempNext (interpCurrent->emitState->tempNext)
+
+/*
+ * The runtime of a generated program, which does what the interpreter does
+ * for each statement. BAS_TEMPS is defined between the two parts.
+ */
+static const char *emitRuntimeHead[] = {
+	"#define _GNU_SOURCE",
+	"#include <math.h>",
+	"#include <stdarg.h>",
+	"#include <stdio.h>",
+	"#include <stdlib.h>",
+	"#include <string.h>",
+	"#include <time.h>",
+	"",
+	"#define BAS static __attribute__((unused))",
+	"#define BAS_STACK_DEF 64",
+	"#define BAS_STACK_MAX 1048576",
+	"#define BAS_NUMERIC_LEN 64",
+	NULL
+};
+
+static const char *emitRuntimeBody[] = {
+	"",
+	"/* A variable used with subscripts, of numbers or of strings. */",
+	"typedef struct basArray {",
+	"\tlong dim1;",
+	"\tlong dim2;",
+	"\tdouble *num;",
+	"\tchar **str;",
+	"} basArray;",
+	"",
+	"/* A GOSUB (var is -1) or FOR frame; resume is where RETURN or NEXT goes. */",
+	"typedef struct basFrame {",
+	"\tlong var;",
+	"\tlong dim1;",
+	"\tlong dim2;",
+	"\tdouble limit;",
+	"\tdouble step;",
+	"\tvoid *resume;",
+	"} basFrame;",
+	"",
+	"typedef struct basDatum {",
+	"\tlong line;",
+	"\tconst char *s;",
+	"\tdouble n;",
+	"} basDatum;",
+	"",
+	"BAS basFrame *basStack;",
+	"BAS long basStackLen;",
+	"BAS long basStackMax;",
+	"BAS basDatum *basData;",
+	"BAS long basDataLen;",
+	"BAS long basDataMax;",
+	"BAS long basDataPos;",
+	"BAS char basTemps[BAS_TEMPS][BAS_NUMERIC_LEN];",
+	"BAS int basTempNext;",
+	"BAS int basArgc;",
+	"BAS char **basArgv;",
+	"BAS long basLine;",
+	"",
+	"BAS void basError(const char *fmt, ...) {",
+	"\tva_list vl;",
+	"\tprintf(\"ERROR: \");",
+	"\tva_start(vl, fmt);",
+	"\tvprintf(fmt, vl);",
+	"\tva_end(vl);",
+	"\tprintf(\"\\n\");",
+	"\texit(1);",
+	"}",
+	"",
+	"BAS char *basFormat(double d, char *b) {",
+	"\tchar t[BAS_NUMERIC_LEN];",
+	"\tchar *p = b;",
+	"\tlong long i;",
+	"\tint n = 0;",
+	"\tif (fabs(d) < 1e15) {",
+	"\t\tif (d == trunc(d)) {",
+	"\t\t\ti = d;",
+	"\t\t\tif (i < 0) {",
+	"\t\t\t\t*p++ = '-';",
+	"\t\t\t\ti = -i;",
+	"\t\t\t}",
+	"\t\t\tdo {",
+	"\t\t\t\tt[n++] = '0' + i % 10;",
+	"\t\t\t\ti /= 10;",
+	"\t\t\t} while (i > 0);",
+	"\t\t\twhile (n > 0) {",
+	"\t\t\t\t*p++ = t[--n];",
+	"\t\t\t}",
+	"\t\t\t*p = 0;",
+	"\t\t} else {",
+	"\t\t\tsprintf(b, \"%f\", d);",
+	"\t\t}",
+	"\t} else {",
+	"\t\tsprintf(b, \"%g\", d);",
+	"\t}",
+	"\treturn(b);",
+	"}",
+	"",
+	"/* Strings made by CHR$ and STR$ live in a ring big enough for a statement. */",
+	"BAS char *basTemp(void) {",
+	"\tchar *s = basTemps[basTempNext];",
+	"\tbasTempNext = (basTempNext + 1) % BAS_TEMPS;",
+	"\treturn(s);",
+	"}",
+	"",
+	"BAS double basAnd(double a, double b) {",
+	"\treturn(a && b);",
+	"}",
+	"",
+	"BAS double basAscN(double d) {",
+	"\tchar b[BAS_NUMERIC_LEN];",
+	"\treturn(basFormat(d, b)[0]);",
+	"}",
+	"",
+	"BAS double basAscS(const char *s) {",
+	"\treturn(s != NULL ? s[0] : 0);",
+	"}",
+	"",
+	"BAS char *basChr(double d) {",
+	"\tchar *s = basTemp();",
+	"\ts[0] = (char)trunc(d);",
+	"\ts[1] = 0;",
+	"\treturn(s);",
+	"}",
+	"",
+	"BAS int basCmpN(double a, double b) {",
+	"\treturn((a > b) - (a < b));",
+	"}",
+	"",
+	"BAS int basCmpS(const char *a, const char *b) {",
+	"\treturn(strcmp(a != NULL ? a : \"\", b != NULL ? b : \"\"));",
+	"}",
+	"",
+	"BAS double basLenN(double d) {",
+	"\tchar b[BAS_NUMERIC_LEN];",
+	"\treturn(strlen(basFormat(d, b)));",
+	"}",
+	"",
+	"BAS double basLenS(const char *s) {",
+	"\treturn(s != NULL ? strlen(s) : 0);",
+	"}",
+	"",
+	"BAS double basOr(double a, double b) {",
+	"\treturn(a || b);",
+	"}",
+	"",
+	"BAS double basRnd(void) {",
+	"\treturn((double)rand() / (double)RAND_MAX);",
+	"}",
+	"",
+	"BAS double basSgn(double d) {",
+	"\treturn((d > 0) - (d < 0));",
+	"}",
+	"",
+	"BAS char *basStr(double d) {",
+	"\treturn(basFormat(d, basTemp()));",
+	"}",
+	"",
+	"BAS double basVal(const char *s) {",
+	"\treturn(s != NULL ? strtod(s, NULL) : 0);",
+	"}",
+	"",
+	"BAS void basSet(char **v, const char *s) {",
+	"\tchar *t = NULL;",
+	"\tif (s != NULL && (t = strdup(s)) == NULL) {",
+	"\t\tbasError(\"unable to allocate memory\");",
+	"\t}",
+	"\tfree(*v);",
+	"\t*v = t;",
+	"}",
+	"",
+	"BAS void basClear(basArray *a) {",
+	"\tlong i;",
+	"\tif (a->str != NULL) {",
+	"\t\tfor (i = 0; i < a->dim1 * a->dim2; i++) {",
+	"\t\t\tfree(a->str[i]);",
+	"\t\t}",
+	"\t}",
+	"\tfree(a->str);",
+	"\tfree(a->num);",
+	"\ta->num = NULL;",
+	"\ta->str = NULL;",
+	"\ta->dim1 = 1;",
+	"\ta->dim2 = 1;",
+	"}",
+	"",
+	"BAS void basDim(basArray *a, const char *name, long dim1, long dim2, int string) {",
+	"\tlong d1 = dim1 < 1 ? 1 : dim1;",
+	"\tlong d2 = dim2 < 1 ? 1 : dim2;",
+	"\tdouble *num = NULL;",
+	"\tchar **str = NULL;",
+	"\tif (string) {",
+	"\t\tstr = calloc(d1 * d2, sizeof(char *));",
+	"\t} else {",
+	"\t\tnum = calloc(d1 * d2, sizeof(double));",
+	"\t}",
+	"\tif (num == NULL && str == NULL) {",
+	"\t\tbasError(\"couldn't dimension variable: %s(%li, %li)\", name, dim1, dim2);",
+	"\t}",
+	"\tbasClear(a);",
+	"\ta->num = num;",
+	"\ta->str = str;",
+	"\ta->dim1 = d1;",
+	"\ta->dim2 = d2;",
+	"}",
+	"",
+	"BAS long basIndex(basArray *a, long d1, long d2) {",
+	"\td1--;",
+	"\td2--;",
+	"\tif (d1 < 0 || d2 < 0 || d1 >= a->dim1 || d2 >= a->dim2) {",
+	"\t\tbasError(\"dimensions out of bounds\");",
+	"\t}",
+	"\treturn(d2 * a->dim1 + d1);",
+	"}",
+	"",
+	"BAS double basNumAt(basArray *a, long d1, long d2) {",
+	"\tlong i = basIndex(a, d1, d2);",
+	"\treturn(a->num != NULL ? a->num[i] : 0);",
+	"}",
+	"",
+	"BAS double *basNumRef(basArray *a, long d1, long d2) {",
+	"\tlong i = basIndex(a, d1, d2);",
+	"\tif (a->num == NULL) {",
+	"\t\tbasDim(a, \"\", 1, 1, 0);",
+	"\t}",
+	"\treturn(&a->num[i]);",
+	"}",
+	"",
+	"BAS char *basStrAt(basArray *a, long d1, long d2) {",
+	"\tlong i = basIndex(a, d1, d2);",
+	"\treturn(a->str != NULL ? a->str[i] : NULL);",
+	"}",
+	"",
+	"BAS char **basStrRef(basArray *a, long d1, long d2) {",
+	"\tlong i = basIndex(a, d1, d2);",
+	"\tif (a->str == NULL) {",
+	"\t\tbasDim(a, \"\", 1, 1, 1);",
+	"\t}",
+	"\treturn(&a->str[i]);",
+	"}",
+	"",
+	"BAS basFrame *basPush(long var, void *resume) {",
+	"\tbasFrame *f;",
+	"\tlong max;",
+	"\tif (basStackLen == basStackMax) {",
+	"\t\tif (basStackMax == BAS_STACK_MAX) {",
+	"\t\t\tbasError(\"too many nested GOSUBs and FOR loops\");",
+	"\t\t}",
+	"\t\tmax = basStackMax ? basStackMax << 1 : BAS_STACK_DEF;",
+	"\t\tif ((f = realloc(basStack, sizeof(basFrame) * max)) == NULL) {",
+	"\t\t\tbasError(\"unable to allocate memory\");",
+	"\t\t}",
+	"\t\tbasStack = f;",
+	"\t\tbasStackMax = max;",
+	"\t}",
+	"\tf = &basStack[basStackLen++];",
+	"\tf->var = var;",
+	"\tf->resume = resume;",
+	"\treturn(f);",
+	"}",
+	"",
+	"/* The search for a loop stops at the innermost GOSUB. */",
+	"BAS long basFindFor(long var) {",
+	"\tlong i;",
+	"\tfor (i = basStackLen - 1; i >= 0 && basStack[i].var != -1; i--) {",
+	"\t\tif (basStack[i].var == var) {",
+	"\t\t\treturn(i);",
+	"\t\t}",
+	"\t}",
+	"\treturn(-1);",
+	"}",
+	"",
+	"BAS void basFor(long var, long dim1, long dim2, double limit, double step, void *resume) {",
+	"\tbasFrame *f;",
+	"\tlong i;",
+	"\tif ((i = basFindFor(var)) >= 0) {",
+	"\t\tbasStackLen = i;",
+	"\t}",
+	"\tf = basPush(var, resume);",
+	"\tf->dim1 = dim1;",
+	"\tf->dim2 = dim2;",
+	"\tf->limit = limit;",
+	"\tf->step = step;",
+	"}",
+	"",
+	"BAS basFrame *basNext(long var) {",
+	"\tlong i;",
+	"\tif ((i = basFindFor(var)) < 0) {",
+	"\t\tbasError(\"NEXT without FOR\");",
+	"\t}",
+	"\tbasStackLen = i + 1;",
+	"\treturn(&basStack[i]);",
+	"}",
+	"",
+	"BAS void basPop(void) {",
+	"\tif (basStackLen > 0) {",
+	"\t\tbasStackLen--;",
+	"\t}",
+	"}",
+	"",
+	"BAS void *basReturn(void) {",
+	"\twhile (basStackLen > 0 && basStack[basStackLen - 1].var != -1) {",
+	"\t\tbasStackLen--;",
+	"\t}",
+	"\tif (basStackLen == 0) {",
+	"\t\tbasError(\"RETURN without GOSUB\");",
+	"\t}",
+	"\treturn(basStack[--basStackLen].resume);",
+	"}",
+	"",
+	"/* DATA items are kept in line order; a line's items are only added once. */",
+	"BAS long basDataFind(long line) {",
+	"\tlong lo = 0;",
+	"\tlong hi = basDataLen;",
+	"\tlong mid;",
+	"\twhile (lo < hi) {",
+	"\t\tmid = lo + ((hi - lo) >> 1);",
+	"\t\tif (basData[mid].line < line) {",
+	"\t\t\tlo = mid + 1;",
+	"\t\t} else {",
+	"\t\t\thi = mid;",
+	"\t\t}",
+	"\t}",
+	"\treturn(lo);",
+	"}",
+	"",
+	"BAS void basDataAdd(long line, const char *const *items, long n) {",
+	"\tbasDatum *d;",
+	"\tlong i = basDataFind(line);",
+	"\tlong max;",
+	"\tlong j;",
+	"\tif (i < basDataLen && basData[i].line == line) {",
+	"\t\treturn;",
+	"\t}",
+	"\tif (basDataLen + n > basDataMax) {",
+	"\t\tmax = basDataMax ? basDataMax : 64;",
+	"\t\twhile (basDataLen + n > max) {",
+	"\t\t\tmax <<= 1;",
+	"\t\t}",
+	"\t\tif ((d = realloc(basData, sizeof(basDatum) * max)) == NULL) {",
+	"\t\t\tbasError(\"memory allocation error\");",
+	"\t\t}",
+	"\t\tbasData = d;",
+	"\t\tbasDataMax = max;",
+	"\t}",
+	"\tmemmove(&basData[i + n], &basData[i], sizeof(basDatum) * (basDataLen - i));",
+	"\tfor (j = 0; j < n; j++) {",
+	"\t\tbasData[i + j].line = line;",
+	"\t\tbasData[i + j].s = items[j];",
+	"\t\tbasData[i + j].n = strtod(items[j], NULL);",
+	"\t}",
+	"\tbasDataLen += n;",
+	"\tif (basDataPos > i) {",
+	"\t\tbasDataPos += n;",
+	"\t}",
+	"}",
+	"",
+	"BAS void basDataClear(void) {",
+	"\tbasDataLen = 0;",
+	"\tbasDataPos = 0;",
+	"}",
+	"",
+	"BAS int basReadN(double *d) {",
+	"\tif (basDataPos >= basDataLen) {",
+	"\t\treturn(1);",
+	"\t}",
+	"\t*d = basData[basDataPos++].n;",
+	"\treturn(0);",
+	"}",
+	"",
+	"BAS const char *basReadS(void) {",
+	"\tif (basDataPos >= basDataLen) {",
+	"\t\treturn(NULL);",
+	"\t}",
+	"\treturn(basData[basDataPos++].s);",
+	"}",
+	"",
+	"BAS void basRestore(long line) {",
+	"\tbasDataPos = line == -1 ? 0 : basDataFind(line);",
+	"}",
+	"",
+	"BAS void basDefineArgs(basArray *a) {",
+	"\tint i;",
+	"\tbasDim(a, \"arg$\", basArgc, 1, 1);",
+	"\tfor (i = 0; i < basArgc; i++) {",
+	"\t\tbasSet(basStrRef(a, i + 1, 1), basArgv[i]);",
+	"\t}",
+	"}",
+	"",
+	"BAS char *basInput(void) {",
+	"\tstatic char *l = NULL;",
+	"\tstatic size_t len = 0;",
+	"\tssize_t n;",
+	"\tfflush(stdout);",
+	"\tif ((n = getline(&l, &len, stdin)) < 0) {",
+	"\t\treturn(NULL);",
+	"\t}",
+	"\tif (n > 0 && l[n - 1] == '\\n') {",
+	"\t\tl[n - 1] = 0;",
+	"\t}",
+	"\treturn(l);",
+	"}",
+	"",
+	"BAS void basPrintN(double d) {",
+	"\tchar b[BAS_NUMERIC_LEN];",
+	"\tfputs(basFormat(d, b), stdout);",
+	"}",
+	"",
+	"BAS void basPrintS(const char *s) {",
+	"\tif (s != NULL) {",
+	"\t\tfputs(s, stdout);",
+	"\t}",
+	"}",
+	"",
+	"BAS void basCls(void) {",
+	"\tfflush(stdout);",
+	"\tif (system(\"clear\")) {",
+	"\t}",
+	"}",
+	NULL
+};
+
+
+/*
+ * LOCAL FUNCTIONS
+ */
+
+static void emitCall(const char *f, symbolType *e, int string);
+static void emitElement(symbolType *id);
+static int emitHasEffects(symbolType *e);
+static void emitNumber(double d);
+static void emitPair(const char *open, symbolType *l, int ls, const char *sep, symbolType *r, int rs, const char *close);
+static void emitValue(symbolType *e);
+static emitVariableType *emitVariable(symbolType *id);
+static void emitVariableName(emitVariableType *v);
+
+
+void emitBegin(void) {
+	if (emitVariables != NULL) {
+		free(emitVariables);
+	}
+	emitVariables = NULL;
+	emitVariablesLen = 0;
+	emitTempNext = 0;
+}
+
+
+static void emitCall(const char *f, symbolType *e, int string) {
+	ioPrintf("%s(", f);
+	emitExpression(e, string);
+	ioWrite(")", 1);
+}
+
+
+void emitClear(const char *indent) {
+	emitVariableType *v;
+	for (v = emitVariables; v < emitVariables + emitVariablesLen; v++) {
+		if (v->name == NULL) {
+			continue;
+		}
+		ioPrintf("%s%s", indent, v->array ? "basClear(&" : v->string ? "basSet(&" : "");
+		emitVariableName(v);
+		ioPrintf("%s;\n", v->array ? ")" : v->string ? ", NULL)" : " = 0");
+	}
+	ioPrintf("%sbasDataClear();\n", indent);
+}
+
+
+int emitCreate(void) {
+	if ((interpCurrent->emitState = calloc(1, sizeof(emitStateType))) == NULL) {
+		return(1);
+	}
+	return(0);
+}
+
+
+void emitDeclarations(const char *indent) {
+	emitVariableType *v;
+	for (v = emitVariables; v < emitVariables + emitVariablesLen; v++) {
+		if (v->name == NULL) {
+			continue;
+		}
+		ioPrintf("%s%s", indent, v->array ? "basArray " : v->string ? "char *" : "double ");
+		emitVariableName(v);
+		ioPrintf(" = %s;\n", v->array ? "{1, 1, NULL, NULL}" : v->string ? "NULL" : "0");
+	}
+}
+
+
+/*
+ * ARG$ is always an array, since it is dimensioned to hold the arguments.
+ */
+void emitDefineArgs(const char *indent) {
+	emitVariableType *v;
+	for (v = emitVariables; v < emitVariables + emitVariablesLen; v++) {
+		if (v->name == NULL) {
+			continue;
+		}
+		if (!strcmp(v->name, "argc")) {
+			ioPrintf("%s%s", indent, v->array ? "*basNumRef(&" : "");
+			emitVariableName(v);
+			ioPrintf("%s = basArgc;\n", v->array ? ", 1, 1)" : "");
+		} else if (!strcmp(v->name, "arg$")) {
+			ioPrintf("%sbasDefineArgs(&", indent);
+			emitVariableName(v);
+			ioPrintf(");\n");
+		}
+	}
+}
+
+
+/*
+ * An element whose subscripts both have effects has the first evaluated
+ * before the second, as the interpreter does.
+ */
+void emitDestroy(void) {
+	if (interpCurrent->emitState == NULL) {
+		return;
+	}
+	if (emitVariables != NULL) {
+		free(emitVariables);
+	}
+	free(interpCurrent->emitState);
+	interpCurrent->emitState = NULL;
+}
+
+
+static void emitElement(symbolType *id) {
+	emitVariableType *v = emitVariable(id);
+	const char *f = v->string ? "basStrAt(&" : "basNumAt(&";
+	unsigned long int t;
+	if (id->l == NULL) {
+		ioPrintf("%s", f);
+		emitVariableName(v);
+		ioPrintf(", 1, 1)");
+	} else if (id->r == NULL) {
+		ioPrintf("%s", f);
+		emitVariableName(v);
+		ioPrintf(", (long)");
+		emitCall("", id->l, 0);
+		ioPrintf(", 1)");
+	} else if (emitHasEffects(id->l) && emitHasEffects(id->r)) {
+		t = emitTempNext++;
+		ioPrintf("({ double _t%lu = ", t);
+		emitExpression(id->l, 0);
+		ioPrintf("; %s", f);
+		emitVariableName(v);
+		ioPrintf(", (long)_t%lu, (long)", t);
+		emitCall("", id->r, 0);
+		ioPrintf("); })");
+	} else {
+		ioPrintf("%s", f);
+		emitVariableName(v);
+		ioPrintf(", (long)");
+		emitCall("", id->l, 0);
+		ioPrintf(", (long)");
+		emitCall("", id->r, 0);
+		ioWrite(")", 1);
+	}
+}
+
+
+void emitExpression(symbolType *e, int string) {
+	int s = emitIsString(e);
+	if (string && !s) {
+		emitCall("basStr", e, 0);
+	} else if (!string && s) {
+		emitCall("basVal", e, 1);
+	} else {
+		emitValue(e);
+	}
+}
+
+
+/*
+ * Return whether evaluating e can do anything besides produce a value: RND
+ * moves the random sequence and a subscript can be out of bounds. C leaves
+ * the order of operands unspecified, so where two of them both have effects
+ * they are sequenced explicitly.
+ */
+static int emitHasEffects(symbolType *e) {
+	if (e == NULL) {
+		return(0);
+	}
+	if (e->id == kwRND || (e->id == kwIdentifier && e->l != NULL)) {
+		return(1);
+	}
+	return(emitHasEffects(e->l) || emitHasEffects(e->r));
+}
+
+
+void emitIndices(symbolType *id, const char *indent) {
+	if (!emitIsArray(id)) {
+		return;
+	}
+	ioPrintf("%slong d1 = ", indent);
+	if (id->l != NULL) {
+		ioPrintf("(long)");
+		emitCall("", id->l, 0);
+	} else {
+		ioWrite("1", 1);
+	}
+	ioPrintf(";\n%slong d2 = ", indent);
+	if (id->r != NULL) {
+		ioPrintf("(long)");
+		emitCall("", id->r, 0);
+	} else {
+		ioWrite("1", 1);
+	}
+	ioPrintf(";\n");
+}
+
+
+int emitIsArray(symbolType *id) {
+	return(emitVariable(id)->array);
+}
+
+
+int emitIsString(symbolType *e) {
+	switch (e->id) {
+		case kwString:
+		case kwCHR:
+		case kwSTR:
+			return(1);
+		case kwIdentifier:
+			return(strchr(e->value, '$') != NULL);
+		case kwSubExpression:
+			return(emitIsString(e->r));
+		default:
+			return(0);
+	}
+}
+
+
+void emitName(symbolType *id) {
+	emitVariableName(emitVariable(id));
+}
+
+
+int emitNoteExpression(symbolType *e) {
+	if (e == NULL) {
+		return(0);
+	}
+	if (e->id == kwIdentifier && emitNoteVariable(e, e->l != NULL)) {
+		return(1);
+	}
+	return(emitNoteExpression(e->l) || emitNoteExpression(e->r));
+}
+
+
+int emitNoteVariable(symbolType *id, int array) {
+	emitVariableType *v;
+	long int max;
+	if (id->slot >= emitVariablesLen) {
+		max = emitVariablesLen ? emitVariablesLen : EMIT_VARIABLES_LEN_DEF;
+		while (id->slot >= max) {
+			max <<= 1;
+		}
+		if ((v = realloc(emitVariables, sizeof(emitVariableType) * max)) == NULL) {
+			utilError("couldn't allocate memory");
+			return(1);
+		}
+		memset(&v[emitVariablesLen], 0, sizeof(emitVariableType) * (max - emitVariablesLen));
+		emitVariables = v;
+		emitVariablesLen = max;
+	}
+	v = &emitVariables[id->slot];
+	v->name = id->value;
+	v->string = strchr(id->value, '$') != NULL;
+	v->array |= array || !strcmp(id->value, "arg$");
+	return(0);
+}
+
+
+/*
+ * Numbers are written with enough digits to read back exactly, and always
+ * as double constants, so that C doesn't do integer arithmetic with them.
+ */
+static void emitNumber(double d) {
+	char b[32];
+	if (isinf(d)) {
+		ioPrintf("%sHUGE_VAL", d < 0 ? "-" : "");
+		return;
+	}
+	if (isnan(d)) {
+		ioPrintf("NAN");
+		return;
+	}
+	snprintf(b, sizeof(b), "%.17g", d);
+	ioPrintf("%s%s", b, strpbrk(b, ".e") == NULL ? ".0" : "");
+}
+
+
+static void emitPair(const char *open, symbolType *l, int ls, const char *sep, symbolType *r, int rs, const char *close) {
+	unsigned long int t;
+	if (emitHasEffects(l) && emitHasEffects(r)) {
+		t = emitTempNext++;
+		ioPrintf("({ %s_t%lu = ", ls ? "const char *" : "double ", t);
+		emitExpression(l, ls);
+		ioPrintf("; %s_t%lu%s", open, t, sep);
+		emitExpression(r, rs);
+		ioPrintf("%s; })", close);
+		return;
+	}
+	ioPrintf("%s", open);
+	emitExpression(l, ls);
+	ioPrintf("%s", sep);
+	emitExpression(r, rs);
+	ioPrintf("%s", close);
+}
+
+
+void emitRef(symbolType *id, int pointer) {
+	emitVariableType *v = emitVariable(id);
+	if (v->array) {
+		ioPrintf("%s", v->string ? "basStrRef(&" : pointer ? "basNumRef(&" : "*basNumRef(&");
+		emitVariableName(v);
+		ioPrintf(", d1, d2)");
+		return;
+	}
+	if (v->string || pointer) {
+		ioWrite("&", 1);
+	}
+	emitVariableName(v);
+}
+
+
+void emitRuntime(unsigned long int temps) {
+	const char **l;
+	for (l = emitRuntimeHead; *l != NULL; l++) {
+		ioPrintf("%s\n", *l);
+	}
+	ioPrintf("#define BAS_TEMPS %lu\n", temps);
+	for (l = emitRuntimeBody; *l != NULL; l++) {
+		ioPrintf("%s\n", *l);
+	}
+}
+
+
+/*
+ * Anything but printable ASCII is written as an octal escape, as is ?, so
+ * that the literal can't contain a trigraph.
+ */
+void emitString(const char *s) {
+	const unsigned char *p;
+	ioWrite("\"", 1);
+	for (p = (const unsigned char *)s; *p; p++) {
+		if (*p == '"' || *p == '\\') {
+			ioPrintf("\\%c", *p);
+		} else if (*p < ' ' || *p > '~' || *p == '?') {
+			ioPrintf("\\%03o", *p);
+		} else {
+			ioWrite((const char *)p, 1);
+		}
+	}
+	ioWrite("\"", 1);
+}
+
+
+unsigned long int emitTemps(symbolType *e) {
+	if (e == NULL) {
+		return(0);
+	}
+	return((e->id == kwCHR || e->id == kwSTR) + emitTemps(e->l) + emitTemps(e->r));
+}
+
+
+/*
+ * Write e as C of its own type, double or char *. Operators are written
+ * the way the expression compiler runs them, so comparisons go through a
+ * three way compare and AND and OR evaluate both operands.
+ */
+static void emitValue(symbolType *e) {
+	const char *cmp = NULL;
+	int s;
+	switch (e->id) {
+		case kwNumeric:
+			emitNumber(strtod(e->value, NULL));
+			return;
+		case kwString:
+			emitString(e->value);
+			return;
+		case kwIdentifier:
+			if (emitIsArray(e)) {
+				emitElement(e);
+			} else {
+				emitName(e);
+			}
+			return;
+		case kwSubExpression:
+			emitCall("", e->r, emitIsString(e->r));
+			return;
+		case kwOpAdd:
+			emitPair("(", e->l, 0, " + ", e->r, 0, ")");
+			return;
+		case kwOpSub:
+			emitPair("(", e->l, 0, " - ", e->r, 0, ")");
+			return;
+		case kwOpMul:
+			emitPair("(", e->l, 0, " * ", e->r, 0, ")");
+			return;
+		case kwOpDiv:
+			emitPair("(", e->l, 0, " / ", e->r, 0, ")");
+			return;
+		case kwOpExp:
+			emitPair("pow(", e->l, 0, ", ", e->r, 0, ")");
+			return;
+		case kwLogicalLT:
+			cmp = ") < 0)";
+			break;
+		case kwLogicalLTE:
+			cmp = ") <= 0)";
+			break;
+		case kwLogicalEQ:
+			cmp = ") == 0)";
+			break;
+		case kwLogicalNE:
+			cmp = ") != 0)";
+			break;
+		case kwLogicalGT:
+			cmp = ") > 0)";
+			break;
+		case kwLogicalGTE:
+			cmp = ") >= 0)";
+			break;
+		case kwOR:
+			emitPair("basOr(", e->l, 0, ", ", e->r, 0, ")");
+			return;
+		case kwAND:
+			emitPair("basAnd(", e->l, 0, ", ", e->r, 0, ")");
+			return;
+		case kwSignPlus:
+			emitCall("", e->r, 0);
+			return;
+		case kwSignMinus:
+			emitCall("(0 - ", e->r, 0);
+			ioWrite(")", 1);
+			return;
+		case kwNOT:
+			emitCall("(double)!", e->r, 0);
+			return;
+		case kwABS:
+			emitCall("fabs", e->l, 0);
+			return;
+		case kwASC:
+			s = emitIsString(e->l);
+			emitCall(s ? "basAscS" : "basAscN", e->l, s);
+			return;
+		case kwATN:
+			emitCall("atan", e->l, 0);
+			return;
+		case kwCLOG:
+			emitCall("log10", e->l, 0);
+			return;
+		case kwCOS:
+			emitCall("cos", e->l, 0);
+			return;
+		case kwEXP:
+			emitCall("exp", e->l, 0);
+			return;
+		case kwINT:
+			emitCall("trunc", e->l, 0);
+			return;
+		case kwLEN:
+			s = emitIsString(e->l);
+			emitCall(s ? "basLenS" : "basLenN", e->l, s);
+			return;
+		case kwLOG:
+			emitCall("log", e->l, 0);
+			return;
+		case kwRND:
+			if (emitHasEffects(e->l)) {
+				emitCall("((void)", e->l, 0);
+				ioPrintf(", basRnd())");
+			} else {
+				ioPrintf("basRnd()");
+			}
+			return;
+		case kwSGN:
+			emitCall("basSgn", e->l, 0);
+			return;
+		case kwSIN:
+			emitCall("sin", e->l, 0);
+			return;
+		case kwSQR:
+			emitCall("sqrt", e->l, 0);
+			return;
+		case kwVAL:
+			emitCall("", e->l, 0);
+			return;
+		case kwCHR:
+			emitCall("basChr", e->l, 0);
+			return;
+		case kwSTR:
+			emitCall("basStr", e->l, 0);
+			return;
+		default:
+			ioPrintf("0");
+			return;
+	}
+	s = emitIsString(e->l) && emitIsString(e->r);
+	emitPair(s ? "(double)(basCmpS(" : "(double)(basCmpN(", e->l, s, ", ", e->r, s, cmp);
+}
+
+
+static emitVariableType *emitVariable(symbolType *id) {
+	return(&emitVariables[id->slot]);
+}
+
+
+/*
+ * Plain variables are n_ or s_ and the BASIC name, arrays na_ or sa_, with
+ * any $ in the name made a _.
+ */
+static void emitVariableName(emitVariableType *v) {
+	const char *p;
+	ioPrintf("%s%s_", v->string ? "s" : "n", v->array ? "a" : "");
+	for (p = v->name; *p; p++) {
+		ioWrite(*p == '$' ? "_" : p, 1);
+	}
+}
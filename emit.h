@@ -0,0 +1,190 @@
+/*
+ * emit.h
+ *
+ * C source generator for --emit-c. The program module walks the lines and
+ * statements of a program and writes their control flow; this module writes
+ * the rest: the runtime the generated program is built on, its variables
+ * and the C for each expression. Everything is written with the io module,
+ * to wherever its output currently goes.
+ *
+ * The generated C uses two GNU extensions, labels as values and statement
+ * expressions, so it needs gcc or clang.
+ */
+
+#ifndef EMIT_H
+#define EMIT_H
+
+
+#include "scan.h"
+
+
+/*
+ * GLOBAL FUNCTIONS
+ */
+
+
+/*
+ * emitBegin
+ *
+ * Forget the variables noted for the last translation.
+ */
+extern void emitBegin(void);
+
+
+/*
+ * emitClear
+ *
+ * Write statements, indented by indent, that clear every variable as CLR
+ * does.
+ */
+extern void emitClear(const char *indent);
+
+
+/*
+ * emitDefineArgs
+ *
+ * Write statements, indented by indent, that set ARGC and ARG$ from the
+ * command line, if the program uses them.
+ */
+extern void emitDefineArgs(const char *indent);
+
+
+/*
+ * emitDestroy
+ *
+ * Free what the current interpreter noted for its last translation.
+ */
+extern void emitDestroy(void);
+
+
+/*
+ * emitCreate
+ *
+ * Set up the current interpreter to translate programs.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int emitCreate(void);
+
+
+/*
+ * emitDeclarations
+ *
+ * Write the declarations of the variables noted, one per line, indented by
+ * indent.
+ */
+extern void emitDeclarations(const char *indent);
+
+
+/*
+ * emitExpression
+ *
+ * Write expression e as a C expression of type char * when string is
+ * non-zero, and of type double otherwise, converting it if it is of the
+ * other type.
+ */
+extern void emitExpression(symbolType *e, int string);
+
+
+/*
+ * emitIndices
+ *
+ * Write declarations, indented by indent, of d1 and d2 holding the
+ * subscripts of variable id, for emitRef. Nothing is written for a plain
+ * variable.
+ */
+extern void emitIndices(symbolType *id, const char *indent);
+
+
+/*
+ * emitIsArray
+ *
+ * Return whether variable id is kept as an array.
+ */
+extern int emitIsArray(symbolType *id);
+
+
+/*
+ * emitIsString
+ *
+ * Return whether expression e has a string value.
+ */
+extern int emitIsString(symbolType *e);
+
+
+/*
+ * emitName
+ *
+ * Write the C name of variable id.
+ */
+extern void emitName(symbolType *id);
+
+
+/*
+ * emitNoteExpression
+ *
+ * Note the variables used in expression e, and in assignment or variable e,
+ * so that they get declared. A subscripted variable is noted as an array.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int emitNoteExpression(symbolType *e);
+
+
+/*
+ * emitNoteVariable
+ *
+ * Note variable id, as an array if array is non-zero, without its
+ * subscripts.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int emitNoteVariable(symbolType *id, int array);
+
+
+/*
+ * emitRef
+ *
+ * Write an lvalue for the element of variable id selected by the d1 and d2
+ * of emitIndices. A numeric element is written as a double, or a pointer to
+ * one if pointer is non-zero; a string element is always written as a
+ * pointer to its char *.
+ */
+extern void emitRef(symbolType *id, int pointer);
+
+
+/*
+ * emitRuntime
+ *
+ * Write the includes, types and functions the generated program uses.
+ * temps is the most strings CHR$ and STR$ make in one statement.
+ */
+extern void emitRuntime(unsigned long int temps);
+
+
+/*
+ * emitString
+ *
+ * Write s as a C string literal.
+ */
+extern void emitString(const char *s);
+
+
+/*
+ * emitTemps
+ *
+ * Return the number of strings CHR$ and STR$ make in expression e.
+ */
+extern unsigned long int emitTemps(symbolType *e);
+
+
+#endif /* EMIT_H */
@@ -0,0 +1,85 @@
+/*
+ * interp.c
+ */
+
+#include <stdlib.h>
+
+#include "emit.h"
+#include "interp.h"
+#include "io.h"
+#include "jit.h"
+#include "prof.h"
+#include "prog.h"
+#include "scan.h"
+#include "value.h"
+#include "var.h"
+
+
+/*
+ * GLOBAL DATA
+ */
+
+__thread interpType *interpCurrent = NULL;
+
+
+/*
+ * The program goes first, since deleting its lines releases strings and
+ * compiled code, and the output last, so that it is flushed once nothing
+ * else can write to it.
+ */
+void interpFree(interpType *ip) {
+	interpType *prev;
+	if (ip == NULL) {
+		return;
+	}
+	prev = interpSwitch(ip);
+	profDestroy();
+	progDestroy();
+	jitDestroy();
+	emitDestroy();
+	scanDestroy();
+	varDestroy();
+	ioDestroy();
+	valueDestroy();
+	free(ip);
+	interpSwitch(prev != ip ? prev : NULL);
+}
+
+
+int interpInit(void) {
+	int rc;
+	rc = scanInit();
+	rc |= progInit();
+	return(rc);
+}
+
+
+interpType *interpNew(void) {
+	interpType *ip;
+	interpType *prev;
+	int rc;
+	if ((ip = calloc(1, sizeof(interpType))) == NULL) {
+		return(NULL);
+	}
+	prev = interpSwitch(ip);
+	rc = valueCreate();
+	rc |= ioCreate();
+	rc |= varCreate();
+	rc |= scanCreate();
+	rc |= emitCreate();
+	rc |= jitCreate();
+	rc |= progCreate();
+	interpSwitch(prev);
+	if (rc) {
+		interpFree(ip);
+		return(NULL);
+	}
+	return(ip);
+}
+
+
+interpType *interpSwitch(interpType *ip) {
+	interpType *prev = interpCurrent;
+	interpCurrent = ip;
+	return(prev);
+}
@@ -0,0 +1,99 @@
+/*
+ * interp.h
+ *
+ * Interpreter contexts. Everything one interpreter knows, its program, its
+ * variables and DATA, its control stack, its input files and output buffer
+ * and its scanner, lives in an interpType, so that any number of programs
+ * can be loaded and run in one process. Each module keeps its part private
+ * and reaches it through interpCurrent, which is per thread: a thread makes
+ * an interpreter current with interpSwitch before calling into the parse,
+ * prog, var or io modules, and an interpreter can move between threads as
+ * long as only one thread uses it at a time.
+ *
+ * The keyword tables, the random number generator, the JIT switch and the
+ * profiling switch and report are shared by every interpreter in the
+ * process.
+ */
+
+#ifndef INTERP_H
+#define INTERP_H
+
+
+/*
+ * GLOBAL DATA TYPES
+ */
+
+typedef struct interpType {
+	struct emitStateType *emitState;
+	struct ioStateType *ioState;
+	struct jitStateType *jitState;
+	struct profStateType *profState;
+	struct progStateType *progState;
+	struct scanStateType *scanState;
+	struct valueStateType *valueState;
+	struct varStateType *varState;
+	int errors;
+	int quiet;
+} interpType;
+
+
+/*
+ * GLOBAL DATA
+ */
+
+/*
+ * The interpreter the calling thread is working with.
+ */
+extern __thread interpType *interpCurrent;
+
+
+/*
+ * GLOBAL FUNCTIONS
+ */
+
+
+/*
+ * interpFree
+ *
+ * Flush the output of interpreter ip and free it, with its program and
+ * variables. If ip is current, no interpreter is current afterwards.
+ */
+extern void interpFree(interpType *ip);
+
+
+/*
+ * interpInit
+ *
+ * Set up what interpreters share. Must be called once, before the first
+ * interpNew.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int interpInit(void);
+
+
+/*
+ * interpNew
+ *
+ * Create an interpreter with no program, reading from stdin and writing to
+ * stdout. The current interpreter is unchanged.
+ *
+ * Returns the new interpreter, or NULL if it couldn't be allocated.
+ */
+extern interpType *interpNew(void);
+
+
+/*
+ * interpSwitch
+ *
+ * Make ip the calling thread's current interpreter.
+ *
+ * Returns the interpreter that was current before.
+ */
+extern interpType *interpSwitch(interpType *ip);
+
+
+#endif /* INTERP_H */
@@ -3,13 +3,16 @@
  */
 
 #include <fcntl.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "interp.h"
 #include "io.h"
 #include "util.h"
 
@@ -18,7 +21,9 @@
  * LOCAL CONSTANTS
  */
 
-#define MAX_BUFFER_LEN 1024
+#define MAX_BUFFER_LEN 65536
+#define OUTPUT_BUFFER_LEN 65536
+#define IO_LINE_LEN_DEF 128
 
 
 /*
@@ -30,88 +35,176 @@ typedef struct ioType {
 	char *buffer;
 	char *ptr;
 	unsigned long int len;
+	unsigned long int mapLen;
 	int fh;
 	char peek;
 } ioType;
 
+/*
+ * The input files and output buffer of one interpreter.
+ */
+typedef struct ioStateType {
+	ioType *fileStack;
+	ioType *stdinInput;
+	char *inputLine;
+	unsigned long int inputLineMax;
+	char *outBuffer;
+	unsigned long int outLen;
+	unsigned long int outMax;
+	int outFh;
+} ioStateType;
+
 
 /*
  * LOCAL DATA
+ *
+ * These name the state of the current interpreter.
  */
 
-static ioType *fileStack = NULL;
+#define fileStack (interpCurrent->ioState->fileStack)
+#define stdinInput (interpCurrent->ioState->stdinInput)
+#define inputLine (interpCurrent->ioState->inputLine)
+#define inputLineMax (interpCurrent->ioState->inputLineMax)
 
-static int fileHandle = -1;
-static char *buffer = NULL;
-static char *buffPtr = NULL;
-static int buffLen = 0;
+#define outBuffer (interpCurrent->ioState->outBuffer)
+#define outLen (interpCurrent->ioState->outLen)
+#define outMax (interpCurrent->ioState->outMax)
+#define outFh (interpCurrent->ioState->outFh)
 
 
 /*
  * LOCAL FUNCTIONS
  */
 
-static void ioExit(void);
+static int ioFill(ioType *iop);
+static ioType *ioNewInput(int fh, char *buffer, unsigned long int mapLen);
+static int ioReserve(unsigned long int len);
+static void ioRelease(ioType *iop);
+static int ioWriteAll(int fh, const char *s, unsigned long int len);
 
 
 int ioCloseInput(void) {
+	ioType *iop;
 	if (fileStack) {
-		ioType *iop = fileStack->next;
-		if (fileStack->buffer != NULL) {
-			free(fileStack->buffer);
-		}
-		if (fileStack->fh > 1) {
-			close(fileStack->fh);
-		}
-		free(fileStack);
+		iop = fileStack->next;
+		ioRelease(fileStack);
 		fileStack = iop;
 	}
 	return(0);
 }
 
 
-static void ioExit(void) {
-	ioType *iop = fileStack;
+int ioCloseOutput(void) {
+	int rc;
+	if (outFh == 1) {
+		return(0);
+	}
+	rc = ioFlush();
+	if (close(outFh)) {
+		rc = 1;
+	}
+	outFh = 1;
+	return(rc);
+}
+
+
+int ioCreate(void) {
+	if ((interpCurrent->ioState = calloc(1, sizeof(ioStateType))) == NULL) {
+		return(1);
+	}
+	outFh = 1;
+	return(0);
+}
+
+
+void ioDestroy(void) {
+	ioType *iop;
 	ioType *ion;
+	if (interpCurrent->ioState == NULL) {
+		return;
+	}
+	iop = fileStack;
+	ioCloseOutput();
+	ioFlush();
+	if (outBuffer != NULL) {
+		free(outBuffer);
+	}
+	outBuffer = NULL;
+	outMax = 0;
 	while (iop) {
 		ion = iop->next;
-		if (iop->fh > 1) {
-			close(iop->fh);
-		}
-		if (iop->buffer != NULL) {
-			free(iop->buffer);
-		}
-		free(iop);
+		ioRelease(iop);
 		iop = ion;
 	}
-	fileStack = NULL;
+	if (stdinInput != NULL) {
+		ioRelease(stdinInput);
+	}
+	if (inputLine != NULL) {
+		free(inputLine);
+	}
+	free(interpCurrent->ioState);
+	interpCurrent->ioState = NULL;
 }
 
 
-int ioInit(void) {
-	atexit(ioExit);
+/*
+ * Refill the buffer of the current input. A mapped file is already entirely
+ * in memory, so running out of it is the end of the file. Pending output is
+ * flushed before blocking on stdin, so prompts are seen before the read.
+ *
+ * Returns 0 when more input was read, 1 at the end of the file.
+ */
+static int ioFill(ioType *iop) {
+	ssize_t len;
+	if (iop->mapLen > 0) {
+		return(1);
+	}
+	if (iop->fh == 0) {
+		ioFlush();
+	}
+	if ((len = read(iop->fh, iop->buffer, MAX_BUFFER_LEN)) <= 0) {
+		return(1);
+	}
+	iop->ptr = iop->buffer;
+	iop->len = len;
 	return(0);
 }
 
 
+int ioFlush(void) {
+	int rc = 0;
+	if (outLen > 0) {
+		rc = ioWriteAll(outFh, outBuffer, outLen);
+		outLen = 0;
+	}
+	return(rc);
+}
+
+
+static ioType *ioNewInput(int fh, char *buffer, unsigned long int mapLen) {
+	ioType *iop;
+	if ((iop = malloc(sizeof(ioType))) == NULL) {
+		return(NULL);
+	}
+	iop->next = NULL;
+	iop->buffer = buffer;
+	iop->ptr = buffer;
+	iop->len = mapLen;
+	iop->mapLen = mapLen;
+	iop->fh = fh;
+	iop->peek = IO_EOF;
+	return(iop);
+}
+
+
 char ioNext(void) {
-	unsigned long int len;
 	if (fileStack == NULL) {
 		return(IO_EOF);
 	}
 	if (fileStack->len == 0) {
-		fileStack->len = read(fileStack->fh, fileStack->buffer, MAX_BUFFER_LEN);
-		if (fileStack->len < 0) {
-			return(IO_EOF);
-		} else if (fileStack->len == 0) {
+		if (ioFill(fileStack)) {
 			ioCloseInput();
-			if (fileStack != NULL) {
-				return(ioPeek());
-			} else {
-				return(IO_EOF);
-			}
-		} else {
-			fileStack->ptr = fileStack->buffer;
+			return(ioPeek());
 		}
 	}
 	fileStack->peek = *fileStack->ptr++;
@@ -120,9 +213,15 @@ char ioNext(void) {
 }
 
 
+/*
+ * Regular files are mapped whole, so the scanner reads straight out of the
+ * mapping. Anything else, including stdin, is read in large chunks.
+ */
 int ioOpenInput(char *fn) {
-	ioType *iop = NULL;
+	ioType *iop;
 	char *buffer = NULL;
+	unsigned long int mapLen = 0;
+	struct stat st;
 	int fh = -1;
 	if (fn == NULL) {
 		fn = "stdin";
@@ -130,26 +229,33 @@ int ioOpenInput(char *fn) {
 	} else if ((fh = open(fn, O_RDONLY)) < 0) {
 		goto err;
 	}
-	if ((buffer = malloc(MAX_BUFFER_LEN)) == NULL) {
-		goto err;
+	if (fh > 1 && fstat(fh, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		if ((buffer = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fh, 0)) != MAP_FAILED) {
+			mapLen = st.st_size;
+			close(fh);
+			fh = -1;
+		} else {
+			buffer = NULL;
+		}
 	}
-	if ((iop = malloc(sizeof(ioType))) == NULL) {
+	if (buffer == NULL) {
+		if ((buffer = malloc(MAX_BUFFER_LEN)) == NULL) {
+			goto err;
+		}
+	}
+	if ((iop = ioNewInput(fh, buffer, mapLen)) == NULL) {
 		goto err;
 	}
 	iop->next = fileStack;
-	iop->buffer = buffer;
-	iop->ptr = buffer;
-	iop->len = 0;
-	iop->fh = fh;
-	iop->peek = IO_EOF;
 	fileStack = iop;
 	return(0);
 err:
-	if (iop != NULL) {
-		free(iop);
-	}
 	if (buffer != NULL) {
-		free(buffer);
+		if (mapLen > 0) {
+			munmap(buffer, mapLen);
+		} else {
+			free(buffer);
+		}
 	}
 	if (fh > 1) {
 		close(fh);
@@ -158,9 +264,170 @@ err:
 }
 
 
+int ioOpenOutput(char *fn) {
+	int fh;
+	if ((fh = open(fn, O_WRONLY | O_TRUNC | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) == -1) {
+		return(1);
+	}
+	ioCloseOutput();
+	ioFlush();
+	outFh = fh;
+	return(0);
+}
+
+
 char ioPeek(void) {
 	if (fileStack == NULL) {
 		return(IO_EOF);
 	}
 	return(fileStack->peek);
 }
+
+
+int ioPrintf(const char *fmt, ...) {
+	va_list vl;
+	int rc;
+	va_start(vl, fmt);
+	rc = ioVPrintf(fmt, vl);
+	va_end(vl);
+	return(rc);
+}
+
+
+/*
+ * Lines are taken from the stdin entry of the input stack when there is one,
+ * picking up after the character the scanner is looking at, so that input
+ * already buffered for the interpreter isn't lost. Otherwise stdin gets a
+ * reader of its own, kept for the next INPUT.
+ */
+char *ioReadLine(void) {
+	ioType *iop;
+	char *l;
+	unsigned long int len = 0;
+	unsigned long int max;
+	int eof = 0;
+	for (iop = fileStack; iop != NULL && iop->fh != 0; iop = iop->next);
+	if (iop == NULL) {
+		if (stdinInput == NULL) {
+			if ((l = malloc(MAX_BUFFER_LEN)) == NULL) {
+				return(NULL);
+			}
+			if ((stdinInput = ioNewInput(0, l, 0)) == NULL) {
+				free(l);
+				return(NULL);
+			}
+		}
+		iop = stdinInput;
+	}
+	while (1) {
+		if (iop->len == 0 && ioFill(iop)) {
+			eof = 1;
+			break;
+		}
+		if (len + 1 >= inputLineMax) {
+			max = inputLineMax ? inputLineMax << 1 : IO_LINE_LEN_DEF;
+			if ((l = realloc(inputLine, max)) == NULL) {
+				return(NULL);
+			}
+			inputLine = l;
+			inputLineMax = max;
+		}
+		iop->len--;
+		if (*iop->ptr == '\n') {
+			iop->ptr++;
+			break;
+		}
+		inputLine[len++] = *iop->ptr++;
+	}
+	if (eof && len == 0) {
+		return(NULL);
+	}
+	inputLine[len] = 0;
+	return(inputLine);
+}
+
+
+static void ioRelease(ioType *iop) {
+	if (iop->buffer != NULL) {
+		if (iop->mapLen > 0) {
+			munmap(iop->buffer, iop->mapLen);
+		} else {
+			free(iop->buffer);
+		}
+	}
+	if (iop->fh > 1) {
+		close(iop->fh);
+	}
+	free(iop);
+}
+
+
+/*
+ * Make room for len more characters of output, flushing the buffer if it is
+ * too full and growing it if len alone won't fit.
+ *
+ * Returns 0 when there is room, 1 if the buffer couldn't be grown.
+ */
+static int ioReserve(unsigned long int len) {
+	unsigned long int max;
+	char *b;
+	if (outLen + len <= outMax) {
+		return(0);
+	}
+	ioFlush();
+	if (len <= outMax) {
+		return(0);
+	}
+	max = outMax ? outMax : OUTPUT_BUFFER_LEN;
+	while (max < len) {
+		max <<= 1;
+	}
+	if ((b = realloc(outBuffer, max)) == NULL) {
+		return(1);
+	}
+	outBuffer = b;
+	outMax = max;
+	return(0);
+}
+
+
+int ioVPrintf(const char *fmt, va_list vl) {
+	va_list vc;
+	int len;
+	va_copy(vc, vl);
+	len = vsnprintf(NULL, 0, fmt, vc);
+	va_end(vc);
+	if (len < 0 || ioReserve(len + 1)) {
+		return(1);
+	}
+	vsnprintf(outBuffer + outLen, len + 1, fmt, vl);
+	outLen += len;
+	return(0);
+}
+
+
+int ioWrite(const char *s, unsigned long int len) {
+	if (len == 0) {
+		return(0);
+	}
+	if (ioReserve(len)) {
+		ioFlush();
+		return(ioWriteAll(outFh, s, len));
+	}
+	memcpy(outBuffer + outLen, s, len);
+	outLen += len;
+	return(0);
+}
+
+
+static int ioWriteAll(int fh, const char *s, unsigned long int len) {
+	ssize_t n;
+	while (len > 0) {
+		if ((n = write(fh, s, len)) < 0) {
+			return(1);
+		}
+		s += n;
+		len -= n;
+	}
+	return(0);
+}
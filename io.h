@@ -1,9 +1,12 @@
 /*
  * io.h
  *
- * Disk I/O module. As far as output, routines exist to create a new file (which
- * will truncate an existing file) or appending lines to a file. No open file 
- * handle is maintained for output.
+ * Disk I/O module. All output goes through a single buffered sink, which
+ * writes to stdout unless a file has been opened for output. The buffer is
+ * flushed when it fills, when input is read from stdin, when the output file
+ * is closed and when the interpreter is freed, so a program that prints a
+ * lot makes few system calls. Anything that writes to the terminal by other
+ * means should call ioFlush first.
  *
  * For input, a stack of open files is maintained. Each time a new file is 
  * opened, the currently open file is preserved. The new file is opened and the
@@ -11,12 +14,17 @@
  * the previously opened file again becomes the current one and input is taken
  * from it. When a file is preserved, it's file pointer and current buffer are
  * maintained and resumed when it again becomes active.
+ *
+ * Each interpreter has its own input stack and output buffer.
  */
 
 #ifndef IO_H
 #define IO_H
 
 
+#include <stdarg.h>
+
+
 /*
  * GLOBAL CONSTANTS
  */
@@ -44,16 +52,53 @@ extern int ioCloseInput(void);
 
 
 /*
- * ioInit
+ * ioCloseOutput
+ *
+ * Flush and close the file opened by ioOpenOutput, and send output to stdout
+ * again. Does nothing if output is already going to stdout.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int ioCloseOutput(void);
+
+
+/*
+ * ioCreate
+ *
+ * Set up the input and output of the current interpreter, which starts out
+ * with no input and writing to stdout.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int ioCreate(void);
+
+
+/*
+ * ioDestroy
  *
- * Initialize the module.
+ * Flush and close the output of the current interpreter, close its input
+ * files and free them.
+ */
+extern void ioDestroy(void);
+
+
+/*
+ * ioFlush
+ *
+ * Write any buffered output.
  *
- * Returns 
+ * Returns
  *
  *	0 = success
  *	1 = error
  */
-extern int ioInit(void);
+extern int ioFlush(void);
 
 
 /*
@@ -83,6 +128,20 @@ extern char ioNext(void);
 extern int ioOpenInput(char *f);
 
 
+/*
+ * ioOpenOutput
+ *
+ * Create the file f, truncating it if it exists, and send output to it until
+ * ioCloseOutput is called. Output buffered for stdout is flushed first.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int ioOpenOutput(char *f);
+
+
 /*
  * ioPeek
  *
@@ -97,4 +156,47 @@ extern int ioOpenInput(char *f);
 extern char ioPeek(void);
 
 
+/*
+ * ioPrintf, ioVPrintf
+ *
+ * Format output as printf does and append it to the output buffer.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int ioPrintf(const char *fmt, ...);
+
+extern int ioVPrintf(const char *fmt, va_list vl);
+
+
+/*
+ * ioReadLine
+ *
+ * Read a line from stdin, through the same buffer the interpreter reads
+ * commands from, so the two don't take input from each other. The newline
+ * is dropped.
+ *
+ * Returns
+ *
+ *	NULL = end of file or error
+ *	otherwise, the line, which is overwritten by the next call
+ */
+extern char *ioReadLine(void);
+
+
+/*
+ * ioWrite
+ *
+ * Append len characters from s to the output buffer.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int ioWrite(const char *s, unsigned long int len);
+
+
 #endif /* IO_H */
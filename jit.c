@@ -0,0 +1,882 @@
+/*
+ * jit.c
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "code.h"
+#include "interp.h"
+#include "jit.h"
+#include "util.h"
+#include "var.h"
+
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define JIT_CHUNK_LEN (256 * 1024)
+#define JIT_BUF_LEN_DEF 4096
+#define JIT_LIST_LEN_DEF 64
+#define JIT_PERF_MAP_LEN 64
+
+/* Register numbers, as used in instruction encodings. */
+#define RAX 0
+#define RCX 1
+#define RDI 7
+#define XMM0 0
+#define XMM1 1
+#define XMM2 2
+#define R12 12
+
+/* Condition codes of Jcc and SETcc. */
+#define CC_A 0x07
+#define CC_NZ 0x05
+#define CC_P 0x0a
+#define CC_Z 0x04
+#define CC_ALWAYS -1
+
+
+/*
+ * LOCAL DATA TYPES
+ */
+
+typedef struct jitFixupType {
+	unsigned long int pos;
+	unsigned long int label;
+} jitFixupType;
+
+typedef struct jitLoopType {
+	unsigned long int n;
+	unsigned long int top;
+} jitLoopType;
+
+/*
+ * The code for a region as it is built. The frame addressed through rbx
+ * holds the expression stack (exprLen entries), then a pointer to each
+ * plain variable in slots, then the limit and step of each FOR.
+ */
+typedef struct jitBufType {
+	unsigned char *code;
+	unsigned long int len;
+	unsigned long int max;
+	unsigned long int *labels;
+	unsigned long int numLabels;
+	unsigned long int maxLabels;
+	jitFixupType *fixups;
+	unsigned long int numFixups;
+	unsigned long int maxFixups;
+	long int *slots;
+	unsigned long int numSlots;
+	unsigned long int maxSlots;
+	unsigned long int exprLen;
+	unsigned long int numLoops;
+	unsigned long int errLabel;
+	unsigned long int exitLabel;
+	int failed;
+} jitBufType;
+
+/*
+ * The executable chunks holding the code compiled for one interpreter.
+ */
+typedef struct jitStateType {
+	unsigned char *chunk;
+	unsigned long int chunkLen;
+	unsigned long int chunkUsed;
+	unsigned char **chunks;
+	unsigned long int *chunkLens;
+	unsigned long int numChunks;
+} jitStateType;
+
+
+/*
+ * GLOBAL DATA
+ */
+
+int jitEnabled = 1;
+
+
+/*
+ * LOCAL DATA
+ *
+ * The chunks belong to the current interpreter; the perf map is shared.
+ */
+
+#define jitChunk (interpCurrent->jitState->chunk)
+#define jitChunkLen (interpCurrent->jitState->chunkLen)
+#define jitChunkUsed (interpCurrent->jitState->chunkUsed)
+#define jitChunks (interpCurrent->jitState->chunks)
+#define jitChunkLens (interpCurrent->jitState->chunkLens)
+#define jitNumChunks (interpCurrent->jitState->numChunks)
+
+static FILE *jitPerfMap = NULL;
+static pthread_once_t jitPerfMapOnce = PTHREAD_ONCE_INIT;
+
+
+/*
+ * LOCAL FUNCTIONS
+ */
+
+static double jitAnd(double a, double b);
+static double *jitArrayRef(long int slot, double d1, double d2);
+static void jitBind(jitBufType *b, unsigned long int label);
+static void jitCall(jitBufType *b, void (*fn)(void));
+static void jitEmit(jitBufType *b, int n, ...);
+static void jitEmitArrayRef(jitBufType *b, long int slot, unsigned long int k);
+static void jitEmitExpression(jitBufType *b, const codeType *c, unsigned long int base);
+static void jitEmitImm(jitBufType *b, int reg, unsigned long int imm);
+static void jitEmitMov(jitBufType *b, int op, int reg, unsigned long int k);
+static void jitEmitNumeric(jitBufType *b, double d, unsigned long int k);
+static void jitEmitSSE(jitBufType *b, int prefix, int op, int reg, unsigned long int k);
+static void jitEmitUnary(jitBufType *b, void (*fn)(void), unsigned long int k);
+static int jitGrow(void **p, unsigned long int *max, unsigned long int len, size_t size);
+static void jitJump(jitBufType *b, int cc, unsigned long int label);
+static unsigned long int jitLabel(jitBufType *b);
+static void jitLong(jitBufType *b, unsigned long int l);
+static double jitNot(double a);
+static void jitNoteCode(jitBufType *b, const codeType *c, unsigned long int base);
+static void jitNoteSlot(jitBufType *b, long int slot);
+static double jitOr(double a, double b);
+static void *jitPlace(jitBufType *b);
+static void jitPerfMapAdd(void *code, unsigned long int len, long int lineNum);
+static void jitPerfMapOpen(void);
+static double jitRnd(double a);
+static double *jitScalarRef(long int slot);
+static double jitSgn(double a);
+static unsigned long int jitSlotOffset(jitBufType *b, long int slot);
+
+
+static double jitAnd(double a, double b) {
+	return(a && b);
+}
+
+
+/*
+ * The address of an element of a numeric array, or NULL after reporting an
+ * error. The subscripts are truncated the way the interpreter does it.
+ */
+static double *jitArrayRef(long int slot, double d1, double d2) {
+	varRefType r;
+	if (varRef(slot, d1, d2, &r)) {
+		return(NULL);
+	}
+	return(r.num);
+}
+
+
+static void jitBind(jitBufType *b, unsigned long int label) {
+	b->labels[label] = b->len;
+}
+
+
+static void jitCall(jitBufType *b, void (*fn)(void)) {
+	jitEmitImm(b, RAX, (unsigned long int)fn);
+	jitEmit(b, 2, 0xff, 0xd0);
+}
+
+
+jitFunc *jitCompile(const jitRegionType *r) {
+	jitBufType b;
+	jitStatementType *s;
+	jitLoopType *loops = NULL;
+	jitLoopType *l;
+	unsigned long int *lines = NULL;
+	unsigned long int numLoops = 0;
+	unsigned long int frame;
+	unsigned long int line = 0;
+	unsigned long int i;
+	unsigned long int taken;
+	unsigned long int neg;
+	unsigned long int done;
+	void *code = NULL;
+	memset(&b, 0, sizeof(b));
+	for (i = 0; i < r->numStatements; i++) {
+		s = &r->statements[i];
+		jitNoteCode(&b, s->value, 0);
+		jitNoteCode(&b, s->index1, 1);
+		jitNoteCode(&b, s->index2, 2);
+		jitNoteCode(&b, s->limit, 1);
+		jitNoteCode(&b, s->step, 2);
+		if ((s->kind == jitAssign && s->index1 == NULL) || s->kind == jitFor || s->kind == jitNext) {
+			jitNoteSlot(&b, s->slot);
+		}
+		if (s->kind == jitFor) {
+			b.numLoops++;
+		}
+	}
+	if (b.exprLen < 3) {
+		b.exprLen = 3;
+	}
+	if (b.failed) {
+		goto err;
+	}
+	if ((loops = malloc(sizeof(jitLoopType) * (b.numLoops + 1))) == NULL) {
+		goto err;
+	}
+	if ((lines = malloc(sizeof(unsigned long int) * (r->numLines + 1))) == NULL) {
+		goto err;
+	}
+	for (i = 0; i <= r->numLines; i++) {
+		lines[i] = jitLabel(&b);
+	}
+	b.errLabel = jitLabel(&b);
+	b.exitLabel = jitLabel(&b);
+
+	/*
+	 * Four registers are pushed after the return address, so a frame of an
+	 * odd number of 8 byte entries leaves the stack aligned for calls.
+	 */
+	frame = b.exprLen + b.numSlots + b.numLoops * 2;
+	frame = (frame | 1) * 8;
+	jitEmit(&b, 7, 0x55, 0x48, 0x89, 0xe5, 0x53, 0x41, 0x54);
+	jitEmit(&b, 2, 0x41, 0x55);
+	jitEmit(&b, 3, 0x48, 0x81, 0xec);
+	jitLong(&b, frame);
+	jitEmit(&b, 6, 0x48, 0x89, 0xe3, 0x45, 0x31, 0xed);
+	for (i = 0; i < b.numSlots; i++) {
+		jitEmitImm(&b, RDI, b.slots[i]);
+		jitCall(&b, (void (*)(void))jitScalarRef);
+		jitEmit(&b, 3, 0x48, 0x85, 0xc0);
+		jitJump(&b, CC_Z, b.errLabel);
+		jitEmitMov(&b, 0x89, RAX, b.exprLen + i);
+	}
+
+	for (i = 0; i < r->numStatements; i++) {
+		s = &r->statements[i];
+		while (line <= s->line) {
+			jitBind(&b, lines[line++]);
+		}
+		jitEmit(&b, 3, 0x49, 0xff, 0xc5);
+		switch (s->kind) {
+			case jitAssign:
+				jitEmitExpression(&b, s->value, 0);
+				if (s->index1 != NULL) {
+					jitEmitExpression(&b, s->index1, 1);
+					if (s->index2 != NULL) {
+						jitEmitExpression(&b, s->index2, 2);
+					} else {
+						jitEmitNumeric(&b, 1, 2);
+					}
+					jitEmitArrayRef(&b, s->slot, 1);
+				} else {
+					jitEmitMov(&b, 0x8b, RAX, jitSlotOffset(&b, s->slot));
+				}
+				jitEmitMov(&b, 0x8b, RCX, 0);
+				jitEmit(&b, 3, 0x48, 0x89, 0x08);
+				break;
+			case jitFor:
+				l = &loops[numLoops];
+				l->n = b.exprLen + b.numSlots + numLoops * 2;
+				numLoops++;
+				jitEmitExpression(&b, s->value, 0);
+				jitEmitExpression(&b, s->limit, 1);
+				if (s->step != NULL) {
+					jitEmitExpression(&b, s->step, 2);
+				} else {
+					jitEmitNumeric(&b, 1, 2);
+				}
+				jitEmitMov(&b, 0x8b, RAX, 1);
+				jitEmitMov(&b, 0x89, RAX, l->n);
+				jitEmitMov(&b, 0x8b, RAX, 2);
+				jitEmitMov(&b, 0x89, RAX, l->n + 1);
+				jitEmitMov(&b, 0x8b, RAX, jitSlotOffset(&b, s->slot));
+				jitEmitMov(&b, 0x8b, RCX, 0);
+				jitEmit(&b, 3, 0x48, 0x89, 0x08);
+				jitEmitImm(&b, RDI, s->slot);
+				jitCall(&b, (void (*)(void))r->forEnter);
+				l->top = jitLabel(&b);
+				jitBind(&b, l->top);
+				break;
+			case jitGoto:
+				jitEmitImm(&b, R12, s->jump);
+				jitJump(&b, CC_ALWAYS, b.exitLabel);
+				break;
+			case jitIf:
+				jitEmitExpression(&b, s->value, 0);
+				jitEmitSSE(&b, 0xf2, 0x10, XMM0, 0);
+				jitEmit(&b, 8, 0x66, 0x0f, 0xef, 0xc9, 0x66, 0x0f, 0x2e, 0xc1);
+				taken = jitLabel(&b);
+				jitJump(&b, CC_P, taken);
+				jitJump(&b, CC_NZ, taken);
+				jitJump(&b, CC_ALWAYS, lines[s->line + 1]);
+				jitBind(&b, taken);
+				if (s->jump != 0) {
+					jitEmitImm(&b, R12, s->jump);
+					jitJump(&b, CC_ALWAYS, b.exitLabel);
+				}
+				break;
+			case jitNext:
+				if (numLoops == 0) {
+					goto err;
+				}
+				l = &loops[--numLoops];
+				neg = jitLabel(&b);
+				done = jitLabel(&b);
+				/* d = var + step; exit when step < 0 ? d < limit : d > limit */
+				jitEmitMov(&b, 0x8b, RAX, jitSlotOffset(&b, s->slot));
+				jitEmit(&b, 4, 0xf2, 0x0f, 0x10, 0x00);
+				jitEmitSSE(&b, 0xf2, 0x58, XMM0, l->n + 1);
+				jitEmit(&b, 4, 0xf2, 0x0f, 0x11, 0x00);
+				jitEmitSSE(&b, 0xf2, 0x10, XMM2, l->n + 1);
+				jitEmit(&b, 8, 0x66, 0x0f, 0xef, 0xdb, 0x66, 0x0f, 0x2e, 0xda);
+				jitJump(&b, CC_A, neg);
+				jitEmitSSE(&b, 0x66, 0x2e, XMM0, l->n);
+				jitJump(&b, CC_A, done);
+				jitJump(&b, CC_ALWAYS, l->top);
+				jitBind(&b, neg);
+				jitEmitSSE(&b, 0xf2, 0x10, XMM1, l->n);
+				jitEmit(&b, 4, 0x66, 0x0f, 0x2e, 0xc8);
+				jitJump(&b, CC_A, done);
+				jitJump(&b, CC_ALWAYS, l->top);
+				jitBind(&b, done);
+				break;
+			case jitRem:
+				break;
+		}
+	}
+	if (numLoops != 0) {
+		goto err;
+	}
+	while (line <= r->numLines) {
+		jitBind(&b, lines[line++]);
+	}
+	jitEmit(&b, 3, 0x45, 0x31, 0xe4);
+	jitBind(&b, b.exitLabel);
+	jitEmitImm(&b, RCX, (unsigned long int)r->counter);
+	jitEmit(&b, 6, 0x4c, 0x01, 0x29, 0x4c, 0x89, 0xe0);
+	jitEmit(&b, 3, 0x48, 0x81, 0xc4);
+	jitLong(&b, frame);
+	jitEmit(&b, 7, 0x41, 0x5d, 0x41, 0x5c, 0x5b, 0x5d, 0xc3);
+	jitBind(&b, b.errLabel);
+	jitEmit(&b, 7, 0x49, 0xc7, 0xc4, 0xff, 0xff, 0xff, 0xff);
+	jitJump(&b, CC_ALWAYS, b.exitLabel);
+	if (b.failed) {
+		goto err;
+	}
+	if ((code = jitPlace(&b)) != NULL) {
+		jitPerfMapAdd(code, b.len, r->lineNum);
+	}
+err:
+	free(b.code);
+	free(b.labels);
+	free(b.fixups);
+	free(b.slots);
+	free(loops);
+	free(lines);
+	return((jitFunc *)code);
+}
+
+
+int jitCreate(void) {
+	if ((interpCurrent->jitState = calloc(1, sizeof(jitStateType))) == NULL) {
+		return(1);
+	}
+	return(0);
+}
+
+
+void jitDestroy(void) {
+	unsigned long int i;
+	if (interpCurrent->jitState == NULL) {
+		return;
+	}
+	for (i = 0; i < jitNumChunks; i++) {
+		munmap(jitChunks[i], jitChunkLens[i]);
+	}
+	free(jitChunks);
+	free(jitChunkLens);
+	free(interpCurrent->jitState);
+	interpCurrent->jitState = NULL;
+}
+
+
+static void jitEmit(jitBufType *b, int n, ...) {
+	va_list ap;
+	int i;
+	if (jitGrow((void **)&b->code, &b->max, b->len + n, 1)) {
+		b->failed = 1;
+		return;
+	}
+	va_start(ap, n);
+	for (i = 0; i < n; i++) {
+		b->code[b->len++] = va_arg(ap, int);
+	}
+	va_end(ap);
+}
+
+
+/*
+ * Replace the subscripts in frame entries k and k + 1 with the address of
+ * the element they select, in rax.
+ */
+static void jitEmitArrayRef(jitBufType *b, long int slot, unsigned long int k) {
+	jitEmitSSE(b, 0xf2, 0x10, XMM0, k);
+	jitEmitSSE(b, 0xf2, 0x10, XMM1, k + 1);
+	jitEmitImm(b, RDI, slot);
+	jitCall(b, (void (*)(void))jitArrayRef);
+	jitEmit(b, 3, 0x48, 0x85, 0xc0);
+	jitJump(b, CC_Z, b->errLabel);
+}
+
+
+/*
+ * Evaluate c into frame entry base, using the entries above it for the
+ * stack.
+ */
+static void jitEmitExpression(jitBufType *b, const codeType *c, unsigned long int base) {
+	const codeOpType *o;
+	unsigned long int k = base;
+	for (o = c->ops; o->op != opEnd; o++) {
+		switch (o->op) {
+			case opPushNumeric:
+				jitEmitNumeric(b, o->arg.n, k++);
+				break;
+			case opLoad:
+				jitEmitMov(b, 0x8b, RAX, jitSlotOffset(b, o->arg.slot));
+				jitEmit(b, 3, 0x48, 0x8b, 0x00);
+				jitEmitMov(b, 0x89, RAX, k++);
+				break;
+			case opLoadArray:
+				k--;
+				jitEmitArrayRef(b, o->arg.slot, k - 1);
+				jitEmit(b, 3, 0x48, 0x8b, 0x00);
+				jitEmitMov(b, 0x89, RAX, k - 1);
+				break;
+			case opAdd:
+			case opSub:
+			case opMul:
+			case opDiv:
+				k--;
+				jitEmitSSE(b, 0xf2, 0x10, XMM0, k - 1);
+				jitEmitSSE(b, 0xf2, o->op == opAdd ? 0x58 : o->op == opSub ? 0x5c : o->op == opMul ? 0x59 : 0x5e, XMM0, k);
+				jitEmitSSE(b, 0xf2, 0x11, XMM0, k - 1);
+				break;
+			case opPow:
+			case opAnd:
+			case opOr:
+				k--;
+				jitEmitSSE(b, 0xf2, 0x10, XMM0, k - 1);
+				jitEmitSSE(b, 0xf2, 0x10, XMM1, k);
+				jitCall(b, o->op == opPow ? (void (*)(void))pow : o->op == opAnd ? (void (*)(void))jitAnd : (void (*)(void))jitOr);
+				jitEmitSSE(b, 0xf2, 0x11, XMM0, k - 1);
+				break;
+			case opLT:
+			case opLTE:
+			case opEQ:
+			case opNE:
+			case opGT:
+			case opGTE:
+				/*
+				 * al = a > b and cl = a < b, both false when either is
+				 * NaN, which is how the interpreter compares.
+				 */
+				k--;
+				jitEmitSSE(b, 0xf2, 0x10, XMM0, k - 1);
+				jitEmitSSE(b, 0xf2, 0x10, XMM1, k);
+				jitEmit(b, 10, 0x66, 0x0f, 0x2e, 0xc1, 0x0f, 0x97, 0xc0, 0x66, 0x0f, 0x2e);
+				jitEmit(b, 4, 0xc8, 0x0f, 0x97, 0xc1);
+				switch (o->op) {
+					case opLT:
+						jitEmit(b, 2, 0x88, 0xc8);
+						break;
+					case opLTE:
+						jitEmit(b, 2, 0x34, 0x01);
+						break;
+					case opEQ:
+						jitEmit(b, 4, 0x08, 0xc8, 0x34, 0x01);
+						break;
+					case opNE:
+						jitEmit(b, 2, 0x08, 0xc8);
+						break;
+					case opGTE:
+						jitEmit(b, 4, 0x88, 0xc8, 0x34, 0x01);
+						break;
+					default:
+						break;
+				}
+				jitEmit(b, 7, 0x0f, 0xb6, 0xc0, 0xf2, 0x0f, 0x2a, 0xc0);
+				jitEmitSSE(b, 0xf2, 0x11, XMM0, k - 1);
+				break;
+			case opPlus:
+			case opVal:
+				break;
+			case opMinus:
+				jitEmit(b, 4, 0x66, 0x0f, 0xef, 0xc0);
+				jitEmitSSE(b, 0xf2, 0x5c, XMM0, k - 1);
+				jitEmitSSE(b, 0xf2, 0x11, XMM0, k - 1);
+				break;
+			case opSqr:
+				jitEmitSSE(b, 0xf2, 0x51, XMM0, k - 1);
+				jitEmitSSE(b, 0xf2, 0x11, XMM0, k - 1);
+				break;
+			case opAbs:
+				jitEmitUnary(b, (void (*)(void))fabs, k - 1);
+				break;
+			case opAtn:
+				jitEmitUnary(b, (void (*)(void))atan, k - 1);
+				break;
+			case opClog:
+				jitEmitUnary(b, (void (*)(void))log10, k - 1);
+				break;
+			case opCos:
+				jitEmitUnary(b, (void (*)(void))cos, k - 1);
+				break;
+			case opExp:
+				jitEmitUnary(b, (void (*)(void))exp, k - 1);
+				break;
+			case opInt:
+				jitEmitUnary(b, (void (*)(void))trunc, k - 1);
+				break;
+			case opLog:
+				jitEmitUnary(b, (void (*)(void))log, k - 1);
+				break;
+			case opRnd:
+				jitEmitUnary(b, (void (*)(void))jitRnd, k - 1);
+				break;
+			case opSgn:
+				jitEmitUnary(b, (void (*)(void))jitSgn, k - 1);
+				break;
+			case opSin:
+				jitEmitUnary(b, (void (*)(void))sin, k - 1);
+				break;
+			case opNot:
+				jitEmitUnary(b, (void (*)(void))jitNot, k - 1);
+				break;
+			default:
+				b->failed = 1;
+				return;
+		}
+	}
+}
+
+
+/*
+ * mov reg, imm64
+ */
+static void jitEmitImm(jitBufType *b, int reg, unsigned long int imm) {
+	int i;
+	jitEmit(b, 2, 0x48 | (reg >= 8), 0xb8 + (reg & 7));
+	for (i = 0; i < 8; i++) {
+		jitEmit(b, 1, (int)(imm >> (i * 8)) & 0xff);
+	}
+}
+
+
+/*
+ * mov reg, [rbx + 8k] (op 0x8b) or mov [rbx + 8k], reg (op 0x89), for reg
+ * below 8.
+ */
+static void jitEmitMov(jitBufType *b, int op, int reg, unsigned long int k) {
+	jitEmit(b, 3, 0x48, op, 0x83 | reg << 3);
+	jitLong(b, k * 8);
+}
+
+
+static void jitEmitNumeric(jitBufType *b, double d, unsigned long int k) {
+	unsigned long int imm;
+	memcpy(&imm, &d, sizeof(imm));
+	jitEmitImm(b, RAX, imm);
+	jitEmitMov(b, 0x89, RAX, k);
+}
+
+
+/*
+ * An SSE2 instruction prefix 0f op on xmm register reg and frame entry k,
+ * such as movsd (f2 0f 10) or ucomisd (66 0f 2e).
+ */
+static void jitEmitSSE(jitBufType *b, int prefix, int op, int reg, unsigned long int k) {
+	jitEmit(b, 4, prefix, 0x0f, op, 0x83 | reg << 3);
+	jitLong(b, k * 8);
+}
+
+
+/*
+ * Replace frame entry k with fn applied to it.
+ */
+static void jitEmitUnary(jitBufType *b, void (*fn)(void), unsigned long int k) {
+	jitEmitSSE(b, 0xf2, 0x10, XMM0, k);
+	jitCall(b, fn);
+	jitEmitSSE(b, 0xf2, 0x11, XMM0, k);
+}
+
+
+/*
+ * Make room for len elements of size bytes at *p, which holds *max.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+static int jitGrow(void **p, unsigned long int *max, unsigned long int len, size_t size) {
+	unsigned long int m = *max;
+	void *n;
+	if (len <= m) {
+		return(0);
+	}
+	while (m < len) {
+		m = m ? m << 1 : (size == 1 ? JIT_BUF_LEN_DEF : JIT_LIST_LEN_DEF);
+	}
+	if ((n = realloc(*p, m * size)) == NULL) {
+		return(1);
+	}
+	*p = n;
+	*max = m;
+	return(0);
+}
+
+
+/*
+ * Jump to label on condition cc, or always for CC_ALWAYS. The offset is
+ * filled in by jitPlace.
+ */
+static void jitJump(jitBufType *b, int cc, unsigned long int label) {
+	if (cc == CC_ALWAYS) {
+		jitEmit(b, 1, 0xe9);
+	} else {
+		jitEmit(b, 2, 0x0f, 0x80 | cc);
+	}
+	if (jitGrow((void **)&b->fixups, &b->maxFixups, b->numFixups + 1, sizeof(jitFixupType))) {
+		b->failed = 1;
+		return;
+	}
+	b->fixups[b->numFixups].pos = b->len;
+	b->fixups[b->numFixups].label = label;
+	b->numFixups++;
+	jitLong(b, 0);
+}
+
+
+static unsigned long int jitLabel(jitBufType *b) {
+	if (jitGrow((void **)&b->labels, &b->maxLabels, b->numLabels + 1, sizeof(unsigned long int))) {
+		b->failed = 1;
+		return(0);
+	}
+	b->labels[b->numLabels] = 0;
+	return(b->numLabels++);
+}
+
+
+static void jitLong(jitBufType *b, unsigned long int l) {
+	jitEmit(b, 4, (int)(l & 0xff), (int)(l >> 8 & 0xff), (int)(l >> 16 & 0xff), (int)(l >> 24 & 0xff));
+}
+
+
+static double jitNot(double a) {
+	return(!a);
+}
+
+
+/*
+ * Make room in the frame for expression c evaluated at base, and for the
+ * variables it reads.
+ */
+static void jitNoteCode(jitBufType *b, const codeType *c, unsigned long int base) {
+	unsigned long int i;
+	if (c == NULL) {
+		return;
+	}
+	if (base + c->depth + 1 > b->exprLen) {
+		b->exprLen = base + c->depth + 1;
+	}
+	for (i = 0; i < c->len; i++) {
+		if (c->ops[i].op == opLoad) {
+			jitNoteSlot(b, c->ops[i].arg.slot);
+		}
+	}
+}
+
+
+static void jitNoteSlot(jitBufType *b, long int slot) {
+	unsigned long int i;
+	for (i = 0; i < b->numSlots; i++) {
+		if (b->slots[i] == slot) {
+			return;
+		}
+	}
+	if (jitGrow((void **)&b->slots, &b->maxSlots, b->numSlots + 1, sizeof(long int))) {
+		b->failed = 1;
+		return;
+	}
+	b->slots[b->numSlots++] = slot;
+}
+
+
+static double jitOr(double a, double b) {
+	return(a || b);
+}
+
+
+/*
+ * Copy the finished code into executable memory. Chunks are only writable
+ * while code is being copied in.
+ *
+ * Returns
+ *
+ *	NULL = error
+ *	otherwise, the code
+ */
+static void *jitPlace(jitBufType *b) {
+	unsigned long int page = sysconf(_SC_PAGESIZE);
+	unsigned long int len;
+	unsigned long int i;
+	unsigned char *p;
+	void *n;
+	int rel;
+	for (i = 0; i < b->numFixups; i++) {
+		rel = (long int)b->labels[b->fixups[i].label] - (long int)(b->fixups[i].pos + 4);
+		memcpy(&b->code[b->fixups[i].pos], &rel, sizeof(rel));
+	}
+	if (jitChunk == NULL || jitChunkUsed + b->len > jitChunkLen) {
+		len = b->len > JIT_CHUNK_LEN ? (b->len + page - 1) / page * page : JIT_CHUNK_LEN;
+		if ((n = realloc(jitChunks, sizeof(unsigned char *) * (jitNumChunks + 1))) == NULL) {
+			return(NULL);
+		}
+		jitChunks = n;
+		if ((n = realloc(jitChunkLens, sizeof(unsigned long int) * (jitNumChunks + 1))) == NULL) {
+			return(NULL);
+		}
+		jitChunkLens = n;
+		if ((p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED) {
+			return(NULL);
+		}
+		jitChunks[jitNumChunks] = p;
+		jitChunkLens[jitNumChunks++] = len;
+		jitChunk = p;
+		jitChunkLen = len;
+		jitChunkUsed = 0;
+	} else if (mprotect(jitChunk, jitChunkLen, PROT_READ | PROT_WRITE)) {
+		return(NULL);
+	}
+	p = jitChunk + jitChunkUsed;
+	memcpy(p, b->code, b->len);
+	jitChunkUsed = (jitChunkUsed + b->len + 15) & ~15UL;
+	if (mprotect(jitChunk, jitChunkLen, PROT_READ | PROT_EXEC)) {
+		return(NULL);
+	}
+	return(p);
+}
+
+
+/*
+ * Add a compiled region to /tmp/perf-<pid>.map, which perf reads to name
+ * code that doesn't belong to any file. Every interpreter in the process
+ * writes to the same map.
+ */
+static void jitPerfMapAdd(void *code, unsigned long int len, long int lineNum) {
+	pthread_once(&jitPerfMapOnce, jitPerfMapOpen);
+	if (jitPerfMap == NULL) {
+		return;
+	}
+	fprintf(jitPerfMap, "%lx %lx abasic:line_%ld\n", (unsigned long int)code, len, lineNum);
+	fflush(jitPerfMap);
+}
+
+
+static void jitPerfMapOpen(void) {
+	char fn[JIT_PERF_MAP_LEN];
+	snprintf(fn, sizeof(fn), "/tmp/perf-%d.map", (int)getpid());
+	jitPerfMap = fopen(fn, "w");
+}
+
+
+/*
+ * The first chunk is kept to be filled again from the start, and the rest
+ * are unmapped.
+ */
+void jitReset(void) {
+	unsigned long int i;
+	for (i = 1; i < jitNumChunks; i++) {
+		munmap(jitChunks[i], jitChunkLens[i]);
+	}
+	if (jitNumChunks > 0) {
+		jitNumChunks = 1;
+		jitChunk = jitChunks[0];
+		jitChunkLen = jitChunkLens[0];
+	}
+	jitChunkUsed = 0;
+}
+
+
+static double jitRnd(double a) {
+	return((double)rand() / (double)RAND_MAX);
+}
+
+
+static double *jitScalarRef(long int slot) {
+	return(jitArrayRef(slot, 1, 1));
+}
+
+
+static double jitSgn(double a) {
+	return((a > 0) - (a < 0));
+}
+
+
+static unsigned long int jitSlotOffset(jitBufType *b, long int slot) {
+	unsigned long int i;
+	for (i = 0; i < b->numSlots && b->slots[i] != slot; i++);
+	return(b->exprLen + i);
+}
+
+
+int jitSupports(const codeType *c) {
+	unsigned long int i;
+	for (i = 0; i < c->len; i++) {
+		switch (c->ops[i].op) {
+			case opPushString:
+			case opAsc:
+			case opLen:
+			case opChr:
+			case opStr:
+				return(0);
+			case opLoad:
+			case opLoadArray:
+				if (!varIsNumeric(c->ops[i].arg.slot)) {
+					return(0);
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return(1);
+}
+
+
+#else
+
+
+int jitEnabled = 0;
+
+
+jitFunc *jitCompile(const jitRegionType *r) {
+	return(NULL);
+}
+
+
+int jitCreate(void) {
+	return(0);
+}
+
+
+void jitDestroy(void) {
+}
+
+
+int jitSupports(const codeType *c) {
+	return(0);
+}
+
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * jit.h
+ *
+ * Native code generator for hot program lines. The program module describes
+ * a run of lines as a flat list of simple numeric statements, and this
+ * module turns the list into x86-64 machine code, one template per
+ * statement and per expression operation, in memory mapped executable. The
+ * code works on the variables directly and only calls back into C for array
+ * elements, the math library and the few things it doesn't inline. Anything
+ * it can't compile is left to the interpreter.
+ *
+ * Every compiled region is listed in /tmp/perf-<pid>.map, so that perf can
+ * put names to the addresses.
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+
+#include "code.h"
+
+
+/*
+ * GLOBAL DATA TYPES
+ */
+
+typedef enum {
+	jitAssign,
+	jitFor,
+	jitGoto,
+	jitIf,
+	jitNext,
+	jitRem
+} jitStatementKind;
+
+/*
+ * One statement of a region, in the order the statements appear. line is
+ * the position in the region of the line holding the statement.
+ *
+ *	jitAssign	slot(index1, index2) = value; index1 is NULL for a plain
+ *			variable and index2 is NULL for a single subscript
+ *	jitFor		FOR slot = value TO limit STEP step; step may be NULL
+ *	jitGoto		leave the region, returning jump
+ *	jitIf		IF value THEN; when value is 0 carry on with the next
+ *			line, otherwise return jump, or carry on with the next
+ *			statement when jump is 0
+ *	jitNext		NEXT slot, for the latest open jitFor
+ *	jitRem		nothing
+ */
+typedef struct jitStatementType {
+	jitStatementKind kind;
+	unsigned long int line;
+	long int slot;
+	codeType *value;
+	codeType *index1;
+	codeType *index2;
+	codeType *limit;
+	codeType *step;
+	long int jump;
+} jitStatementType;
+
+/*
+ * A run of numLines lines starting at line lineNum. The compiled function
+ * adds the number of statements it runs to *counter, and calls forEnter
+ * with the slot of the variable when a FOR starts, so that the caller can
+ * drop any loop the FOR replaces.
+ */
+typedef struct jitRegionType {
+	jitStatementType *statements;
+	unsigned long int numStatements;
+	unsigned long int numLines;
+	long int lineNum;
+	unsigned long int *counter;
+	void (*forEnter)(long int slot);
+} jitRegionType;
+
+/*
+ * A compiled region returns -1 after an error has been reported, 0 to carry
+ * on with the line after the region, or the jump of the statement that left
+ * it.
+ */
+typedef long int (jitFunc)(void);
+
+
+/*
+ * GLOBAL DATA
+ */
+
+extern int jitEnabled;
+
+
+/*
+ * GLOBAL FUNCTIONS
+ */
+
+
+/*
+ * jitCompile
+ *
+ * Compile region r. Its expressions must all pass jitSupports.
+ *
+ * Returns
+ *
+ *	NULL = the region couldn't be compiled
+ *	otherwise, the compiled function
+ */
+extern jitFunc *jitCompile(const jitRegionType *r);
+
+
+/*
+ * jitCreate
+ *
+ * Set up the current interpreter to hold compiled code.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int jitCreate(void);
+
+
+/*
+ * jitDestroy
+ *
+ * Release the code compiled for the current interpreter.
+ */
+extern void jitDestroy(void);
+
+
+/*
+ * jitReset
+ *
+ * Throw away all the code compiled for the current interpreter, so that the
+ * memory it took is used again. None of it may run afterwards.
+ */
+extern void jitReset(void);
+
+
+/*
+ * jitSupports
+ *
+ * Return whether expression c can be compiled: it has to be numeric
+ * throughout, with no string variables or string functions.
+ */
+extern int jitSupports(const codeType *c);
+
+
+#endif /* JIT_H */
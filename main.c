@@ -6,25 +6,96 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <time.h>
 
+#include "interp.h"
 #include "io.h"
+#include "jit.h"
 #include "parse.h"
+#include "prof.h"
 #include "prog.h"
 #include "scan.h"
 #include "util.h"
+#include "value.h"
 #include "var.h"
 
 
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define PROFILE_FILE_DEF "abasic.prof"
+
+
+/*
+ * LOCAL DATA
+ */
+
+static struct timespec startTime;
+
+
 /*
  * LOCAL FUNCTIONS
  */
 
+static int batch(int ac, char **av);
+static int emit(char *fn, char *out);
 static int init(void);
+static void quit(void);
+static void stats(void);
 
 
+/*
+ * abasic [--no-jit] [--profile[=file]] [program.bas [arguments...]]
+ * abasic --emit-c[=file.c] program.bas
+ *
+ * Profiling times each statement in the interpreter, so it turns the JIT
+ * off as well.
+ */
 int main(int ac, char **av) {
+	char *emitFile = NULL;
+	int emitC = 0;
+	int i;
+	if (init()) {
+		fprintf(stderr, "abasic: unable to allocate memory\n");
+		return(1);
+	}
+	if (getenv("ABASIC_STATS") != NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &startTime);
+		atexit(stats);
+	}
+	for (i = 1; i < ac && !strncmp(av[i], "--", 2); i++) {
+		if (!strcmp(av[i], "--no-jit")) {
+			jitEnabled = 0;
+		} else if (!strcmp(av[i], "--emit-c")) {
+			emitC = 1;
+		} else if (!strncmp(av[i], "--emit-c=", 9)) {
+			emitC = 1;
+			emitFile = av[i] + 9;
+		} else if (!strcmp(av[i], "--profile")) {
+			profInit(PROFILE_FILE_DEF);
+		} else if (!strncmp(av[i], "--profile=", 10)) {
+			profInit(av[i] + 10);
+		} else {
+			fprintf(stderr, "abasic: unknown option [%s]\n", av[i]);
+			return(2);
+		}
+	}
+	if (profEnabled) {
+		jitEnabled = 0;
+	}
+	if (emitC) {
+		if (i == ac) {
+			fprintf(stderr, "abasic: --emit-c needs a program\n");
+			return(2);
+		}
+		return(emit(av[i], emitFile));
+	}
+	if (i < ac) {
+		return(batch(ac - i, av + i));
+	}
 	utilReady();
-	init();
 	ioOpenInput(NULL);
 	ioNext();
 	parseProgram();
@@ -32,10 +103,99 @@ int main(int ac, char **av) {
 }
 
 
+/*
+ * Load the program in file av[0] and run it, without the banner or ready
+ * prompts. The file may be source text or an image written by CSAVE. The
+ * remaining arguments are available to the program as ARG$ and ARGC.
+ *
+ * Returns
+ *
+ *	0 = the program loaded and ran without errors
+ *	1 = an error was reported
+ *	2 = the file couldn't be opened
+ */
+static int batch(int ac, char **av) {
+	utilQuiet = 1;
+	if (progIsImage(av[0])) {
+		progLoadImage(av[0]);
+	} else if (ioOpenInput(av[0])) {
+		fprintf(stderr, "abasic: couldn't open [%s]\n", av[0]);
+		return(2);
+	} else {
+		ioNext();
+		parseProgram();
+	}
+	if (utilErrors) {
+		return(1);
+	}
+	progSetArgs(ac - 1, av + 1);
+	return(progRun());
+}
+
+
+/*
+ * Load the program in file fn, as batch does, and translate it to C in file
+ * out, or on stdout if out is NULL.
+ *
+ * Returns
+ *
+ *	0 = the program was translated
+ *	1 = an error was reported
+ *	2 = the file couldn't be opened
+ */
+static int emit(char *fn, char *out) {
+	utilQuiet = 1;
+	if (progIsImage(fn)) {
+		progLoadImage(fn);
+	} else if (ioOpenInput(fn)) {
+		fprintf(stderr, "abasic: couldn't open [%s]\n", fn);
+		return(2);
+	} else {
+		ioNext();
+		parseProgram();
+	}
+	if (utilErrors) {
+		return(1);
+	}
+	return(progEmitC(out));
+}
+
+
+/*
+ * Make the interpreter everything runs in, and free it at exit so that its
+ * output is flushed.
+ */
 static int init(void) {
-	int rc;
-	rc = ioInit();
-	rc |= progInit();
-	rc |= scanInit();
-	return(rc);
+	interpType *ip;
+	if (interpInit() || (ip = interpNew()) == NULL) {
+		return(1);
+	}
+	interpSwitch(ip);
+	atexit(quit);
+	return(0);
+}
+
+
+static void quit(void) {
+	interpFree(interpCurrent);
+}
+
+
+/*
+ * Report the number of statements executed, the elapsed time and the peak
+ * resident set size on stderr, so that they don't mix with program output.
+ */
+static void stats(void) {
+	struct rusage ru;
+	struct timespec t;
+	double elapsed;
+	unsigned long int n = progStatementCount();
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	elapsed = (t.tv_sec - startTime.tv_sec) + (t.tv_nsec - startTime.tv_nsec) / 1e9;
+	getrusage(RUSAGE_SELF, &ru);
+	ioFlush();
+	fprintf(stderr, "statements %lu\n", n);
+	fprintf(stderr, "seconds %.3f\n", elapsed);
+	fprintf(stderr, "statements/s %.0f\n", elapsed > 0 ? n / elapsed : 0);
+	fprintf(stderr, "maxrss %ld\n", ru.ru_maxrss);
 }
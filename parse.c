@@ -29,10 +29,13 @@ static symbolType *aexp(void);
 static symbolType *sexp(void);
 
 static symbolType *parseAssignment(void);
+static symbolType *parseIdentifier(char *name);
 static int insAssignment(progLineType *p);
+static int insCLOAD(progLineType *pl);
 static int insCLR(progLineType *pl);
 static int insCLS(progLineType *pl);
 static int insCONT(progLineType *pl);
+static int insCSAVE(progLineType *pl);
 static int insDATA(progLineType *pl);
 static int insDIM(progLineType *pl);
 static int insEND(progLineType *pl);
@@ -84,11 +87,6 @@ static symbolType *aexp(void) {
 	}
 	return(p);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -126,11 +124,6 @@ static symbolType *term1(void) {
 		return(p);
 	}
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -156,11 +149,6 @@ static symbolType *term2(void) {
 	}
 	return(p);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -186,11 +174,6 @@ static symbolType *term3(void) {
 	}
 	return(p);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -216,11 +199,6 @@ static symbolType *term4(void) {
 	}
 	return(p);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -246,11 +224,6 @@ static symbolType *factor1(void) {
 	}
 	return(p);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -275,11 +248,6 @@ static symbolType *factor2(void) {
 	}
 	return(p);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -305,7 +273,7 @@ static symbolType *factor3(void) {
 			scanNext();
 			break;
 		case kwIdentifier:
-			if ((p = scanNewSymbol(kwIdentifier, s->value)) == NULL) {
+			if ((p = parseIdentifier(s->value)) == NULL) {
 				goto err;
 			}
 			scanNext();
@@ -337,7 +305,7 @@ static symbolType *factor3(void) {
 					goto err;
 				}
 				p->id = s->id;
-				if ((p->l = scanNewSymbol(kwIdentifier, p->value)) == NULL) {
+				if ((p->l = parseIdentifier(p->value)) == NULL) {
 					goto err;
 				}
 				p->value = NULL;
@@ -435,9 +403,6 @@ static symbolType *factor3(void) {
 	}
 	return(p);
 err:
-	if (p != NULL) {
-		progDeleteExpression(p);
-	}
 	return(NULL);
 }
 
@@ -453,7 +418,7 @@ static symbolType *sexp(void) {
 		scanNext();
 	} else if (s->id == kwIdentifier) {
 		if (strchr(s->value, '$') != NULL) {
-			if ((n = scanNewSymbol(kwIdentifier, s->value)) == NULL) {
+			if ((n = parseIdentifier(s->value)) == NULL) {
 				goto err;
 			}
 			scanNext();
@@ -528,9 +493,6 @@ static symbolType *sexp(void) {
 	}
 	return(n);
 err:
-	if (n != NULL) {
-		free(n);
-	}
 	return(NULL);
 }
 
@@ -541,7 +503,7 @@ static symbolType *parseAssignment(void) {
 	symbolType *e = NULL;
 	symbolType *a = NULL;
 	s = scanPeek();
-	if ((i = scanNewSymbol(kwIdentifier, s->value)) == NULL) {
+	if ((i = parseIdentifier(s->value)) == NULL) {
 		goto err;
 	}
 	scanNext();
@@ -593,20 +555,30 @@ static symbolType *parseAssignment(void) {
 	a->r = e;
 	return(a);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} else {
-		if (i != NULL) {
-			progDeleteExpression(i);
-		}
-		if (e != NULL) {
-			progDeleteExpression(e);
-		}
-	}
 	return(NULL);
 }
 
 
+/*
+ * Variables are bound to their slot in the variable table here, so the
+ * running program never looks a name up.
+ */
+static symbolType *parseIdentifier(char *name) {
+	symbolType *s;
+	if (name == NULL || name[0] == 0) {
+		utilError("expecting identifier");
+		return(NULL);
+	}
+	if ((s = scanNewSymbol(kwIdentifier, name)) == NULL) {
+		return(NULL);
+	}
+	if ((s->slot = varLookup(name)) < 0) {
+		return(NULL);
+	}
+	return(s);
+}
+
+
 static int insAssignment(progLineType *pl) {
 	symbolType *a = NULL;
 	if ((a = parseAssignment()) == NULL) {
@@ -626,6 +598,24 @@ static int insBYE(progLineType *pl) {
 	return(progAppendInstruction(pl, kwBYE, NULL));
 }
 
+
+static int insCLOAD(progLineType *pl) {
+	symbolType *s = NULL;
+	scanNext();
+	if ((s = sexp()) == NULL) {
+		utilError("expecting string expression");
+		goto err;
+	}
+	if (progAppendInstruction(pl, kwCLOAD, s)) {
+		goto err;
+	}
+	scanNext();
+	return(0);
+err:
+	return(1);
+}
+
+
 static int insCLR(progLineType *pl) {
 	scanNext();
 	return(progAppendInstruction(pl, kwCLR, NULL));
@@ -644,6 +634,23 @@ static int insCONT(progLineType *pl) {
 }
 
 
+static int insCSAVE(progLineType *pl) {
+	symbolType *s = NULL;
+	scanNext();
+	if ((s = sexp()) == NULL) {
+		utilError("expecting string expression");
+		goto err;
+	}
+	if (progAppendInstruction(pl, kwCSAVE, s)) {
+		goto err;
+	}
+	scanNext();
+	return(0);
+err:
+	return(1);
+}
+
+
 static int insDATA(progLineType *pl) {
 	symbolType *s = NULL;
 	char **t = NULL;
@@ -685,7 +692,7 @@ static int insDIM(progLineType *pl) {
 	while (1) {
 		scanNext();
 		s = scanPeek();
-		if ((id = scanNewSymbol(kwIdentifier, s->value)) == NULL) {
+		if ((id = parseIdentifier(s->value)) == NULL) {
 			goto err;
 		}
 		scanNext();
@@ -743,23 +750,8 @@ static int insDIM(progLineType *pl) {
 	return(0);
 err:
 	if (a != NULL) {
-		while (numDims) {
-			numDims--;
-			progDeleteExpression(a[numDims]->l);
-			progDeleteExpression(a[numDims]->r);
-			free(a[numDims]);
-		}
 		free(a);
 	}
-	if (id != NULL) {
-		progDeleteExpression(id);
-	}
-	if (e1 != NULL) {
-		progDeleteExpression(e1);
-	}
-	if (e2 != NULL) {
-		progDeleteExpression(e2);
-	}
 	return(1);
 }
 
@@ -805,15 +797,6 @@ static int insFOR(progLineType *pl) {
 	scanNext();
 	return(0);
 err:
-	if (assign != NULL) {
-		progDeleteExpression(assign);
-	}
-	if (to != NULL) {
-		progDeleteExpression(to);
-	}
-	if (step != NULL) {
-		progDeleteExpression(step);
-	}
 	return(1);
 }
 
@@ -830,9 +813,6 @@ static int insGOSUB(progLineType *pl) {
 	}
 	return(0);
 err:
-	if (s != NULL) {
-		progDeleteExpression(s);
-	}
 	return(1);
 }
 
@@ -849,9 +829,6 @@ static int insGOTO(progLineType *pl) {
 	}
 	return(0);
 err:
-	if (s != NULL) {
-		progDeleteExpression(s);
-	}
 	return(1);
 }
 
@@ -863,6 +840,7 @@ static int insIF(progLineType *pl) {
 	progLineType ip;
 	int iIsExp = 1;
 	memset(&ip, 0, sizeof(progLineType));
+	ip.arena = pl->arena;
 	scanNext();
 	if ((e = aexp()) == NULL) {
 		utilError("expecting arithmetic expression");
@@ -896,13 +874,8 @@ err:
 	if (i) {
 		if (!iIsExp) {
 			progDeleteInstructions(i);
-		} else {
-			progDeleteExpression(i);
 		}
 	}
-	if (e) {
-		progDeleteExpression(e);
-	}
 	return(1);
 }
 
@@ -926,7 +899,7 @@ static int insINPUT(progLineType *pl) {
 			utilError("expecting identifier");
 			goto err;
 		}
-		if ((id = scanNewSymbol(kwIdentifier, s->value)) == NULL) {
+		if ((id = parseIdentifier(s->value)) == NULL) {
 			goto err;
 		}
 		scanNext();
@@ -991,23 +964,8 @@ static int insINPUT(progLineType *pl) {
 	return(0);
 err:
 	if (a != NULL) {
-		while (numVars) {
-			numVars--;
-			progDeleteExpression(a[numVars]->l);
-			progDeleteExpression(a[numVars]->r);
-			free(a[numVars]);
-		}
 		free(a);
 	}
-	if (id != NULL) {
-		progDeleteExpression(id);
-	}
-	if (e1 != NULL) {
-		progDeleteExpression(e1);
-	}
-	if (e2 != NULL) {
-		progDeleteExpression(e2);
-	}
 	return(1);
 }
 
@@ -1024,9 +982,6 @@ static int insLET(progLineType *pl) {
 	scanNext();
 	return(0);
 err:
-	if (a != NULL) {
-		progDeleteExpression(a);
-	} 
 	return(1);
 }
 
@@ -1055,12 +1010,6 @@ static int insLIST(progLineType *pl) {
 	}
 	return(0);
 err:
-	if (l1 != NULL) {
-		progDeleteExpression(l1);
-	}
-	if (l2 != NULL) {
-		progDeleteExpression(l2);
-	}
 	return(1);
 }
 
@@ -1078,9 +1027,6 @@ static int insLOAD(progLineType *pl) {
 	scanNext();
 	return(0);
 err:
-	if (s != NULL) {
-		progDeleteExpression(s);
-	}
 	return(1);
 }
 
@@ -1100,7 +1046,7 @@ static int insNEXT(progLineType *pl) {
 		utilError("expecting identifier");
 		goto err;
 	}
-	if ((v = scanNewSymbol(kwIdentifier, s->value)) == NULL) {
+	if ((v = parseIdentifier(s->value)) == NULL) {
 		goto err;
 	}
 	if (progAppendInstruction(pl, kwNEXT, v)) {
@@ -1109,9 +1055,6 @@ static int insNEXT(progLineType *pl) {
 	scanNext();
 	return(0);
 err:
-	if (v != NULL) {
-		progDeleteExpression(v);
-	}
 	return(1);
 }
 
@@ -1171,17 +1114,7 @@ static int insON(progLineType *pl) {
 	}
 	return(0);
 err:
-	if (i != NULL) {
-		progDeleteExpression(i);
-	}
-	if (v != NULL) {
-		progDeleteExpression(v);
-	}
 	if (t != NULL) {
-		while (numTargets) {
-			numTargets--;
-			progDeleteExpression(t[numTargets]);
-		}
 		free(t);
 	}
 	return(1);
@@ -1245,10 +1178,6 @@ static int insPRINT(progLineType *pl) {
 	return(0);
 err:
 	if (a != NULL) {
-		while (numExps) {
-			numExps--;
-			progDeleteExpression(a[numExps]);
-		}
 		free(a);
 	}
 	return(1);
@@ -1274,7 +1203,7 @@ static int insREAD(progLineType *pl) {
 			utilError("expecting identifier");
 			goto err;
 		}
-		if ((id = scanNewSymbol(kwIdentifier, s->value)) == NULL) {
+		if ((id = parseIdentifier(s->value)) == NULL) {
 			goto err;
 		}
 		scanNext();
@@ -1334,23 +1263,8 @@ static int insREAD(progLineType *pl) {
 	return(0);
 err:
 	if (a != NULL) {
-		while (numVars) {
-			numVars--;
-			progDeleteExpression(a[numVars]->l);
-			progDeleteExpression(a[numVars]->r);
-			free(a[numVars]);
-		}
 		free(a);
 	}
-	if (id != NULL) {
-		progDeleteExpression(id);
-	}
-	if (e1 != NULL) {
-		progDeleteExpression(e1);
-	}
-	if (e2 != NULL) {
-		progDeleteExpression(e2);
-	}
 	return(1);
 }
 
@@ -1383,9 +1297,6 @@ static int insRESTORE(progLineType *pl) {
 	scanNext();
 	return(0);
 err:
-	if (e != NULL) {
-		progDeleteExpression(e);
-	}
 	scanNext();
 	return(1);
 }
@@ -1416,9 +1327,6 @@ static int insSAVE(progLineType *pl) {
 	scanNext();
 	return(0);
 err:
-	if (s != NULL) {
-		progDeleteExpression(s);
-	}
 	return(1);
 }
 
@@ -1450,6 +1358,9 @@ static int statement(progLineType *pl) {
 	symbolType *s = scanPeek();
 	int rc = 0;
     switch (s->id) {
+		case kwCLOAD:
+			rc = insCLOAD(pl);
+			break;
         case kwCLR:
             rc = insCLR(pl);
             break;
@@ -1459,6 +1370,9 @@ static int statement(progLineType *pl) {
 		case kwCONT:
 			rc = insCONT(pl);
 			break;
+		case kwCSAVE:
+			rc = insCSAVE(pl);
+			break;
         case kwDATA:
             rc = insDATA(pl);
             break;
@@ -1571,6 +1485,7 @@ static void deferredStatement(void) {
 		utilError("couldn't allocate memory");
 		return;
 	}
+	scanSetArena(pl->arena);
 	if (compoundStatement(pl)) {
 		progDeleteLine(pl);
 	}
@@ -1582,12 +1497,15 @@ static void immediateStatement(void) {
 	progLineType pl;
 	memset(&pl, 0, sizeof(progLineType));
 	pl.lineNum = -1;
-	if (compoundStatement(&pl)) {
-		progDeleteInstructions(pl.firstInstruction);
+	if ((pl.arena = arenaNew()) == NULL) {
 		goto err;
 	}
-	progExecuteLine(&pl);
+	scanSetArena(pl.arena);
+	if (compoundStatement(&pl) == 0) {
+		progExecuteLine(&pl);
+	}
 	progDeleteInstructions(pl.firstInstruction);
+	arenaFree(pl.arena);
 err:
 	utilReady();
 	scanConsumeEol();
@@ -0,0 +1,355 @@
+/*
+ * prof.c
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "interp.h"
+#include "io.h"
+#include "prof.h"
+#include "scan.h"
+#include "util.h"
+
+
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define PROF_HASH_LEN_DEF 256
+#define PROF_KEYWORDS (kwSubExpression + 1)
+#define PROF_REPORT_LEN 20
+
+
+/*
+ * LOCAL DATA TYPES
+ */
+
+typedef struct profEntryType {
+	long int lineNum;
+	keywords keyword;
+	unsigned long int hits;
+	double time;
+} profEntryType;
+
+/*
+ * Figures by line, in a hash table on the line number, and by statement
+ * type. A line's hits are the times it was started, from its first
+ * statement, while its time covers every statement run on it; free slots in
+ * the table have a negative line number. Each interpreter counts into its own, without locking, and adds
+ * them to the process totals when it is freed.
+ */
+typedef struct profStateType {
+	profEntryType *lines;
+	unsigned long int linesLen;
+	unsigned long int linesMax;
+	profEntryType keywords[PROF_KEYWORDS];
+} profStateType;
+
+
+/*
+ * LOCAL DATA
+ */
+
+int profEnabled = 0;
+
+static char *profFile = NULL;
+static profStateType profTotal;
+static pthread_mutex_t profLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*
+ * LOCAL FUNCTIONS
+ */
+
+static int profAdd(profStateType *p, long int lineNum, unsigned long int hits, double t);
+static int profCompareLine(const void *a, const void *b);
+static int profCompareName(const void *a, const void *b);
+static int profCompareTime(const void *a, const void *b);
+static void profExit(void);
+static unsigned long int profGather(profEntryType **lines, profEntryType **keywords);
+static const char *profName(keywords k);
+static int profRehash(profStateType *p, unsigned long int len);
+static void profReport(profEntryType *e, unsigned long int n, const char *title, int byLine);
+static void profStateInit(profStateType *p);
+
+
+/*
+ * Charge hits executions taking t seconds to line lineNum in p.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+static int profAdd(profStateType *p, long int lineNum, unsigned long int hits, double t) {
+	profEntryType *e;
+	unsigned long int h;
+	if (p->linesLen * 2 >= p->linesMax) {
+		if (profRehash(p, p->linesMax ? p->linesMax << 1 : PROF_HASH_LEN_DEF)) {
+			return(1);
+		}
+	}
+	h = (unsigned long int)lineNum * 2654435761UL & (p->linesMax - 1);
+	while ((e = &p->lines[h])->lineNum >= 0 && e->lineNum != lineNum) {
+		h = (h + 1) & (p->linesMax - 1);
+	}
+	if (e->lineNum < 0) {
+		e->lineNum = lineNum;
+		p->linesLen++;
+	}
+	e->hits += hits;
+	e->time += t;
+	return(0);
+}
+
+
+double profClock(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return(t.tv_sec + t.tv_nsec / 1e9);
+}
+
+
+static int profCompareLine(const void *a, const void *b) {
+	long int l1 = ((const profEntryType *)a)->lineNum;
+	long int l2 = ((const profEntryType *)b)->lineNum;
+	return((l1 > l2) - (l1 < l2));
+}
+
+
+static int profCompareName(const void *a, const void *b) {
+	return(strcmp(profName(((const profEntryType *)a)->keyword), profName(((const profEntryType *)b)->keyword)));
+}
+
+
+static int profCompareTime(const void *a, const void *b) {
+	double t1 = ((const profEntryType *)a)->time;
+	double t2 = ((const profEntryType *)b)->time;
+	return((t1 < t2) - (t1 > t2));
+}
+
+
+void profDestroy(void) {
+	profStateType *p = interpCurrent->profState;
+	unsigned long int i;
+	if (p == NULL) {
+		return;
+	}
+	pthread_mutex_lock(&profLock);
+	for (i = 0; i < p->linesMax; i++) {
+		if (p->lines[i].lineNum >= 0) {
+			profAdd(&profTotal, p->lines[i].lineNum, p->lines[i].hits, p->lines[i].time);
+		}
+	}
+	for (i = 0; i < PROF_KEYWORDS; i++) {
+		profTotal.keywords[i].hits += p->keywords[i].hits;
+		profTotal.keywords[i].time += p->keywords[i].time;
+	}
+	pthread_mutex_unlock(&profLock);
+	if (p->lines != NULL) {
+		free(p->lines);
+	}
+	free(p);
+	interpCurrent->profState = NULL;
+}
+
+
+/*
+ * Write the report to stderr and the raw figures to the profile file. The
+ * interpreter still current at exit hasn't been freed yet, so its output is
+ * flushed, to come before the report, and its figures are added to the
+ * totals first.
+ */
+static void profExit(void) {
+	profEntryType *lines = NULL;
+	profEntryType *keywords = NULL;
+	unsigned long int n;
+	unsigned long int i;
+	FILE *f;
+	if (interpCurrent != NULL) {
+		ioFlush();
+		profDestroy();
+	}
+	pthread_mutex_lock(&profLock);
+	n = profGather(&lines, &keywords);
+	if (lines == NULL || keywords == NULL) {
+		goto err;
+	}
+	if ((f = fopen(profFile, "w")) == NULL) {
+		fprintf(stderr, "abasic: couldn't create profile [%s]\n", profFile);
+	} else {
+		qsort(lines, profTotal.linesLen, sizeof(profEntryType), profCompareLine);
+		qsort(keywords, n, sizeof(profEntryType), profCompareName);
+		for (i = 0; i < profTotal.linesLen; i++) {
+			fprintf(f, "line\t%li\t%lu\t%.9f\n", lines[i].lineNum, lines[i].hits, lines[i].time);
+		}
+		for (i = 0; i < n; i++) {
+			fprintf(f, "statement\t%s\t%lu\t%.9f\n", profName(keywords[i].keyword), keywords[i].hits, keywords[i].time);
+		}
+		fclose(f);
+	}
+	qsort(lines, profTotal.linesLen, sizeof(profEntryType), profCompareTime);
+	qsort(keywords, n, sizeof(profEntryType), profCompareTime);
+	profReport(lines, profTotal.linesLen, "line", 1);
+	profReport(keywords, n, "statement", 0);
+err:
+	if (lines != NULL) {
+		free(lines);
+	}
+	if (keywords != NULL) {
+		free(keywords);
+	}
+	if (profTotal.lines != NULL) {
+		free(profTotal.lines);
+	}
+	if (profFile != NULL) {
+		free(profFile);
+	}
+	profStateInit(&profTotal);
+	profFile = NULL;
+	pthread_mutex_unlock(&profLock);
+}
+
+
+/*
+ * Copy the used line and statement entries of the totals into new arrays,
+ * which the caller sorts and frees.
+ *
+ * Returns the number of statement entries.
+ */
+static unsigned long int profGather(profEntryType **lines, profEntryType **keywords) {
+	unsigned long int i;
+	unsigned long int n = 0;
+	*lines = malloc(sizeof(profEntryType) * (profTotal.linesLen + 1));
+	*keywords = malloc(sizeof(profEntryType) * PROF_KEYWORDS);
+	if (*lines == NULL || *keywords == NULL) {
+		return(0);
+	}
+	for (i = 0; i < profTotal.linesMax; i++) {
+		if (profTotal.lines[i].lineNum >= 0) {
+			(*lines)[n++] = profTotal.lines[i];
+		}
+	}
+	n = 0;
+	for (i = 0; i < PROF_KEYWORDS; i++) {
+		if (profTotal.keywords[i].hits > 0) {
+			(*keywords)[n++] = profTotal.keywords[i];
+		}
+	}
+	return(n);
+}
+
+
+int profInit(const char *fn) {
+	if ((profFile = strdup(fn)) == NULL) {
+		utilError("couldn't allocate memory");
+		return(1);
+	}
+	profStateInit(&profTotal);
+	atexit(profExit);
+	profEnabled = 1;
+	return(0);
+}
+
+
+static const char *profName(keywords k) {
+	const char *s;
+	if (k == kwAssignment) {
+		return("(assignment)");
+	}
+	if ((s = scanGetKeyword(k)) == NULL) {
+		return("(unknown)");
+	}
+	return(s);
+}
+
+
+/*
+ * The figures of an interpreter are made the first time it records one.
+ */
+void profRecord(long int lineNum, keywords k, int start, double t) {
+	profStateType *p = interpCurrent->profState;
+	if (lineNum < 0) {
+		return;
+	}
+	if (p == NULL) {
+		if ((p = malloc(sizeof(profStateType))) == NULL) {
+			return;
+		}
+		profStateInit(p);
+		interpCurrent->profState = p;
+	}
+	if (k < PROF_KEYWORDS) {
+		p->keywords[k].hits++;
+		p->keywords[k].time += t;
+	}
+	profAdd(p, lineNum, start != 0, t);
+}
+
+
+static int profRehash(profStateType *p, unsigned long int len) {
+	profEntryType *lines;
+	unsigned long int h;
+	unsigned long int i;
+	if ((lines = calloc(len, sizeof(profEntryType))) == NULL) {
+		utilError("couldn't allocate memory");
+		return(1);
+	}
+	for (i = 0; i < len; i++) {
+		lines[i].lineNum = -1;
+	}
+	for (i = 0; i < p->linesMax; i++) {
+		if (p->lines[i].lineNum >= 0) {
+			h = (unsigned long int)p->lines[i].lineNum * 2654435761UL & (len - 1);
+			while (lines[h].lineNum >= 0) {
+				h = (h + 1) & (len - 1);
+			}
+			lines[h] = p->lines[i];
+		}
+	}
+	if (p->lines != NULL) {
+		free(p->lines);
+	}
+	p->lines = lines;
+	p->linesMax = len;
+	return(0);
+}
+
+
+/*
+ * Print the first PROF_REPORT_LEN entries of e, which is sorted by time.
+ */
+static void profReport(profEntryType *e, unsigned long int n, const char *title, int byLine) {
+	unsigned long int i;
+	double total = 0;
+	for (i = 0; i < n; i++) {
+		total += e[i].time;
+	}
+	fprintf(stderr, "\n%-12s %12s %12s %7s\n", title, "hits", "seconds", "%");
+	for (i = 0; i < n && i < PROF_REPORT_LEN; i++) {
+		if (byLine) {
+			fprintf(stderr, "%-12li", e[i].lineNum);
+		} else {
+			fprintf(stderr, "%-12s", profName(e[i].keyword));
+		}
+		fprintf(stderr, " %12lu %12.6f %7.2f\n", e[i].hits, e[i].time, total > 0 ? 100 * e[i].time / total : 0);
+	}
+}
+
+
+static void profStateInit(profStateType *p) {
+	keywords k;
+	p->lines = NULL;
+	p->linesLen = 0;
+	p->linesMax = 0;
+	for (k = 0; k < PROF_KEYWORDS; k++) {
+		p->keywords[k].lineNum = -1;
+		p->keywords[k].keyword = k;
+		p->keywords[k].hits = 0;
+		p->keywords[k].time = 0;
+	}
+}
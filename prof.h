@@ -0,0 +1,73 @@
+/*
+ * prof.h
+ *
+ * Execution profiler. When profiling is on, the statement loop times every
+ * statement it runs and charges the time to the program line it belongs to
+ * and to its statement type. At exit a report sorted by time is written to
+ * stderr, and the raw figures are written to a file sorted by line number
+ * and statement name, so that the files from two runs can be diffed.
+ *
+ * Each interpreter counts for itself, and its figures are added to the
+ * report when it is freed.
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+
+#include "scan.h"
+
+
+/*
+ * GLOBAL DATA
+ */
+
+extern int profEnabled;
+
+
+/*
+ * GLOBAL FUNCTIONS
+ */
+
+
+/*
+ * profClock
+ *
+ * Return a monotonic time in seconds, for timing a statement.
+ */
+extern double profClock(void);
+
+
+/*
+ * profDestroy
+ *
+ * Add the figures of the current interpreter to the report and free them.
+ */
+extern void profDestroy(void);
+
+
+/*
+ * profInit
+ *
+ * Turn profiling on. The report file is written to fn at exit.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int profInit(const char *fn);
+
+
+/*
+ * profRecord
+ *
+ * Charge one execution of a statement of type k taking t seconds to line
+ * lineNum, counting a hit on the line as well when start is set because the
+ * statement was the first on the line. Statements typed in immediate mode (a
+ * negative lineNum) are ignored.
+ */
+extern void profRecord(long int lineNum, keywords k, int start, double t);
+
+
+#endif /* PROF_H */
@@ -4,31 +4,71 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
 
-#include "container.h"
+#include "code.h"
+#include "emit.h"
+#include "interp.h"
 #include "io.h"
+#include "jit.h"
+#include "prof.h"
 #include "prog.h"
 #include "scan.h"
 #include "util.h"
+#include "value.h"
 #include "var.h"
 
 
+/*
+ * CONSTANTS
+ */
+
+#define CONTROL_STACK_LEN_DEF 64
+#define CONTROL_STACK_LEN_MAX 1048576
+#define IMAGE_MAGIC "abasic\032"
+#define IMAGE_VERSION 1
+#define IMAGE_ORDER 0x01020304UL
+#define IMAGE_NULL ((unsigned long int)-1)
+#define IMAGE_DEPTH_MAX 4096
+#define JIT_REGION_LINES 32
+#define JIT_REGION_STATEMENTS 256
+#define JIT_THRESHOLD 64
+
+
 /*
  * DATA TYPES
  */
 
+typedef struct targetType {
+	progLineType *line;
+	unsigned long int generation;
+} targetType;
+
+/*
+ * An operand of a fused instruction: a numeric constant, or a plain numeric
+ * variable when slot isn't -1.
+ */
+typedef struct operandType {
+	long int slot;
+	double n;
+} operandType;
+
 typedef struct assignmentType {
 	instructionType ins;
 	symbolType *assignment;
+	operandType a;
+	operandType b;
+	keywords op;
 } assignmentType;
 
 typedef struct byeType {
@@ -66,6 +106,33 @@ typedef struct endType {
 	instructionType ins;
 } endType;
 
+/*
+ * The start of a program image. keywords is the number of keyword ids, so an
+ * image saved by a build with a different keyword list isn't misread.
+ */
+typedef struct imageHeaderType {
+	char magic[8];
+	unsigned long int version;
+	unsigned long int order;
+	unsigned long int keywords;
+} imageHeaderType;
+
+/*
+ * A frame on the control stack, pushed by GOSUB or FOR (kind) at instruction
+ * ins of line. RETURN continues after ins; NEXT loops back to just after it.
+ * The rest is only used by FOR frames.
+ */
+typedef struct controlFrameType {
+	keywords kind;
+	progLineType *line;
+	instructionType *ins;
+	long int slot;
+	long int dim1;
+	long int dim2;
+	double limit;
+	double step;
+} controlFrameType;
+
 typedef struct forType {
 	instructionType ins;
 	symbolType *startPoint;
@@ -76,11 +143,13 @@ typedef struct forType {
 typedef struct gosubType {
 	instructionType ins;
 	symbolType *targetLine;
+	targetType target;
 } gosubType;
 
 typedef struct gotoType {
 	instructionType ins;
 	symbolType *targetLine;
+	targetType target;
 } gotoType;
 
 typedef struct ifType {
@@ -88,6 +157,9 @@ typedef struct ifType {
 	symbolType *expression;
 	void *gotoOrInstructions;
 	char isGoto;
+	targetType target;
+	operandType l;
+	operandType r;
 } ifType;
 
 typedef struct inputType {
@@ -119,14 +191,62 @@ typedef struct newType {
 typedef struct nextType {
 	instructionType ins;
 	symbolType *iteratorVar;
+	instructionType *forIns;
 } nextType;
 
+/*
+ * A translation by progEmitC. labels has an entry for each line, by its
+ * position in progIndex, and one more for the end of the program, set when
+ * something jumps there; dispatch is set when a jump has a computed target,
+ * which needs every line labelled.
+ * data holds the DATA statements with items, whose items are written out
+ * as arrays named by position. temps is the most CHR$ and STR$ strings of
+ * any statement, and resume numbers the labels GOSUB and FOR return to.
+ */
+typedef struct progEmitType {
+	unsigned char *labels;
+	int dispatch;
+	int run;
+	unsigned long int temps;
+	unsigned long int resume;
+	instructionType **data;
+	unsigned long int numData;
+} progEmitType;
+
+/*
+ * Native code for the lines from the line holding it up to last. jumps
+ * holds the GOTO and IF instructions the code can leave by, indexed by the
+ * value it returns less one. All of it is dropped, and the memory it used
+ * reused, once the program has been edited since it was made (progJitEdits
+ * differs from progEdits).
+ */
+typedef struct progNativeType {
+	jitFunc *func;
+	progLineType *last;
+	instructionType **jumps;
+} progNativeType;
+
+/*
+ * A region being described for jitCompile.
+ */
+typedef struct progJitType {
+	jitStatementType *statements;
+	unsigned long int numStatements;
+	instructionType **jumps;
+	unsigned long int numJumps;
+} progJitType;
+
+/*
+ * targets holds the line each entry of targetList jumps to, once known, so
+ * ON selects its line with an index rather than a search.
+ */
 typedef struct onType {
 	instructionType ins;
 	symbolType *expression;
 	symbolType *instruction;
 	symbolType **targetList;
 	unsigned long int numTargets;
+	targetType *targets;
 } onType;
 
 typedef struct popType {
@@ -147,6 +267,8 @@ typedef struct readType {
 	instructionType ins;
 	symbolType **varList;
 	unsigned long int numVars;
+	operandType dim1;
+	operandType dim2;
 } readType;
 
 typedef struct remType {
@@ -179,21 +301,64 @@ typedef struct stopType {
 typedef struct trapType {
 	instructionType ins;
 	symbolType *targetLine;
+	targetType target;
 } trapType;
 
+/*
+ * The program of one interpreter, with its line index, control stack and
+ * where it is running.
+ */
+typedef struct progStateType {
+	controlFrameType *controlStack;
+	long int controlStackLen;
+	long int controlStackMax;
+	progLineType *lines;
+	progLineType **index;
+	unsigned long int indexLen;
+	unsigned long int indexMax;
+	unsigned long int generation;
+	unsigned long int edits;
+	unsigned long int jitEdits;
+	progLineType *current;
+	progLineType *trap;
+	progLineType *stop;
+	unsigned long int statements;
+	int argc;
+	char **argv;
+	const char *imagePos;
+	const char *imageEnd;
+	unsigned long int imageDepth;
+} progStateType;
+
 
 /*
  * LOCAL DATA
+ *
+ * Apart from memErr and imageErr, these name the state of the current interpreter.
  */
 
-static stackType(1024) callStack;
-static stackType(1024) forLineStack;
-static stackType(1024) forInstructionStack;
-
-static progLineType *prog = NULL;
-static progLineType *progCurrent = NULL;
-static progLineType *progTrap = NULL;
-static progLineType *progStop = NULL;
+#define controlStack (interpCurrent->progState->controlStack)
+#define controlStackLen (interpCurrent->progState->controlStackLen)
+#define controlStackMax (interpCurrent->progState->controlStackMax)
+
+#define prog (interpCurrent->progState->lines)
+#define progIndex (interpCurrent->progState->index)
+#define progIndexLen (interpCurrent->progState->indexLen)
+#define progIndexMax (interpCurrent->progState->indexMax)
+#define progGeneration (interpCurrent->progState->generation)
+#define progEdits (interpCurrent->progState->edits)
+#define progJitEdits (interpCurrent->progState->jitEdits)
+#define progCurrent (interpCurrent->progState->current)
+#define progTrap (interpCurrent->progState->trap)
+#define progStop (interpCurrent->progState->stop)
+#define progStatements (interpCurrent->progState->statements)
+#define progArgc (interpCurrent->progState->argc)
+#define progArgv (interpCurrent->progState->argv)
+#define imagePos (interpCurrent->progState->imagePos)
+#define imageEnd (interpCurrent->progState->imageEnd)
+#define imageDepth (interpCurrent->progState->imageDepth)
+
+static char *imageErr = "corrupt image";
 static char *memErr = "unable to allocate memory";
 
 
@@ -201,13 +366,31 @@ static char *memErr = "unable to allocate memory";
  * LOCAL FUNCTIONS
  */
 
-static void progCleanupNumeric(char *s);
+static void progBindTarget(symbolType *e, targetType *t);
+static void progContinueAfter(progLineType *p, instructionType *i);
+static long int progControlFindFOR(long int slot);
+static controlFrameType *progControlPush(keywords kind);
+static void progDefineArgs(void);
+static void progEmitComment(long int lineNum, const char *s);
+static void progEmitData(progEmitType *e, progLineType *p, instructionType *i);
+static void progEmitGoto(symbolType *t, const char *indent);
+static void progEmitInstructions(progEmitType *e, progLineType *p, instructionType *i);
+static void progEmitMark(progEmitType *e, symbolType *t);
+static void progEmitNext(progLineType *p);
+static int progEmitNote(progEmitType *e, progLineType *p, instructionType *i);
+static void progEmitParenthesised(symbolType *e);
+static void progEmitPRINT(printType *pp);
+static void progEmitStore(symbolType *id, const char *value, int string, const char *indent);
+static void progEmitTRAP(symbolType *t);
 static void progExecute(void);
 static void progExecuteAssignment(void *vp);
+static void progExecuteAssignmentFused(void *vp);
 static void progExecuteBYE(void *vp);
+static void progExecuteCLOAD(void *vp);
 static void progExecuteCLR(void *vp);
 static void progExecuteCLS(void *vp);
 static void progExecuteCONT(void *vp);
+static void progExecuteCSAVE(void *vp);
 static void progExecuteDATA(void *vp);
 static void progExecuteDIM(void *vp);
 static void progExecuteEND(void *vp);
@@ -215,16 +398,20 @@ static void progExecuteFOR(void *vp);
 static void progExecuteGOSUB(void *vp);
 static void progExecuteGOTO(void *vp);
 static void progExecuteIF(void *vp);
+static void progExecuteIFCompare(void *vp);
 static void progExecuteINPUT(void *vp);
 static void progExecuteLET(void *vp);
 static void progExecuteLIST(void *vp);
 static void progExecuteLOAD(void *vp);
+static int progExecuteNative(void);
 static void progExecuteNEW(void *vp);
 static void progExecuteNEXT(void *vp);
+static void progExecuteNEXTLocal(void *vp);
 static void progExecuteON(void *vp);
 static void progExecutePOP(void *vp);
 static void progExecutePRINT(void *vp);
 static void progExecuteREAD(void *vp);
+static void progExecuteREADNumeric(void *vp);
 static void progExecuteREM(void *vp);
 static void progExecuteRESTORE(void *vp);
 static void progExecuteRETURN(void *vp);
@@ -232,7 +419,7 @@ static void progExecuteRUN(void *vp);
 static void progExecuteSAVE(void *vp);
 static void progExecuteSTOP(void *vp);
 static void progExecuteTRAP(void *vp);
-static void progExit(void);
+static progLineType *progFindLine(long int l);
 static char *progFormatAssignment(void *vp);
 static char *progFormatDATA(void *vp);
 static char *progFormatDefault(void *vp);
@@ -253,52 +440,73 @@ static char *progFormatREM(void *vp);
 static char *progFormatRESTORE(void *vp);
 static char *progFormatSAVE(void *vp);
 static char *progFormatTRAP(void *vp);
-static void progFreeAssignment(void *vp);
 static void progFreeDATA(void *vp);
 static void progFreeDefault(void *vp);
 static void progFreeDIM(void *vp);
-static void progFreeFOR(void *vp);
-static void progFreeGOSUB(void *vp);
-static void progFreeGOTO(void *vp);
 static void progFreeIF(void *vp);
 static void progFreeINPUT(void *vp);
-static void progFreeLET(void *vp);
-static void progFreeLIST(void *vp);
-static void progFreeLOAD(void *vp);
-static void progFreeNEXT(void *vp);
 static void progFreeON(void *vp);
 static void progFreePRINT(void *vp);
 static void progFreeREAD(void *vp);
 static void progFreeREM(void *vp);
-static void progFreeRESTORE(void *vp);
-static void progFreeSAVE(void *vp);
-static void progFreeTRAP(void *vp);
-
-static int progList(int fh, long int start, long int end);
+static int progImageCheckSymbol(const symbolType *s);
+static int progImageCheckVariables(symbolType **a, unsigned long int n, int dim);
+static int progImageGetInstructions(progLineType *p);
+static int progImageGetLong(unsigned long int *l);
+static int progImageGetString(const char **s);
+static int progImageGetSymbol(arenaType *a, symbolType **s);
+static int progImageGetSymbols(arenaType *a, symbolType ***s, unsigned long int *n);
+static void progImagePutInstructions(instructionType *i);
+static void progImagePutLong(unsigned long int l);
+static void progImagePutString(const char *s);
+static void progImagePutSymbol(symbolType *s);
+static void progImagePutSymbols(symbolType **s, unsigned long int n);
+static unsigned long int progIndexFind(long int l);
+static int progIsScalar(symbolType *id);
+static int progJitAppend(progJitType *j, instructionType *i, unsigned long int line);
+static int progJitBalanced(const jitStatementType *s, unsigned long int n);
+static int progJitCode(symbolType *e, codeType **c);
+static progNativeType *progJitCompile(progLineType *p);
+static void progJitForEnter(long int slot);
+static void progJitFree(progLineType *p);
+static void progJitReset(void);
+static int progOperand(symbolType *e, arenaType *a, operandType *o);
+static double progOperandValue(operandType *o);
+static void progSpecialise(progLineType *p, instructionType *i);
+static int progList(long int start, long int end);
 static int progNew(void);
-static int isNumeric(char *s);
+static progLineType *progResolveTarget(symbolType *e, targetType *t);
+static int progCompileExpression(symbolType *e, arenaType *a);
+static int progCompileInstruction(instructionType *i, arenaType *a);
+static int progCompileLvalue(symbolType *id, arenaType *a);
+static int eval(symbolType *expr, valueType *r);
 static char *evalCode(symbolType *params);
+static char *evalFormat(const char *fmt, ...);
+static int evalIndices(symbolType *id, long *dim1, long *dim2);
+static int evalLvalue(symbolType *id, varRefType *r);
+static int evalNumeric(symbolType *expr, double *d);
+static char *evalString(symbolType *expr);
 static char *formatLine(instructionType *i);
-static char *eval(symbolType *params);
 
 
 int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 	instructionType *i = NULL;
+	unsigned long int j;
 	va_list vl;
 	va_start(vl, keyword);
 	switch (keyword) {
 		case kwAssignment:
-			if ((i = malloc(sizeof(assignmentType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(assignmentType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteAssignment;
 			i->formatFunc = progFormatAssignment;
-			i->freeFunc = progFreeAssignment;
+			i->freeFunc = progFreeDefault;
 			((assignmentType *)i)->assignment = va_arg(vl, symbolType *);
 			break;
 		case kwBYE:
-			if ((i = malloc(sizeof(byeType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(byeType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -306,8 +514,18 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->formatFunc = progFormatDefault;
 			i->freeFunc = progFreeDefault;
 			break;
+		case kwCLOAD:
+			if ((i = arenaAlloc(p->arena, sizeof(loadType))) == NULL) {
+				utilError(memErr);
+				goto err;
+			}
+			i->executeFunc = progExecuteCLOAD;
+			i->formatFunc = progFormatLOAD;
+			i->freeFunc = progFreeDefault;
+			((loadType *)i)->fileName = va_arg(vl, symbolType *);
+			break;
 		case kwCLR:
-			if ((i = malloc(sizeof(clrType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(clrType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -316,7 +534,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwCLS:
-			if ((i = malloc(sizeof(clsType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(clsType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -325,7 +543,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwCONT:
-			if ((i = malloc(sizeof(contType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(contType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -333,8 +551,18 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->formatFunc = progFormatDefault;
 			i->freeFunc = progFreeDefault;
 			break;
+		case kwCSAVE:
+			if ((i = arenaAlloc(p->arena, sizeof(saveType))) == NULL) {
+				utilError(memErr);
+				goto err;
+			}
+			i->executeFunc = progExecuteCSAVE;
+			i->formatFunc = progFormatSAVE;
+			i->freeFunc = progFreeDefault;
+			((saveType *)i)->fileName = va_arg(vl, symbolType *);
+			break;
 		case kwDATA:
-			if ((i = malloc(sizeof(dataType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(dataType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -344,7 +572,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((dataType *)i)->dataList = va_arg(vl, char **);
 			break;
 		case kwDIM:
-			if ((i = malloc(sizeof(dimType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(dimType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -355,7 +583,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((dimType *)i)->numElements = va_arg(vl, unsigned long int);
 			break;
 		case kwEND:
-			if ((i = malloc(sizeof(endType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(endType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -364,39 +592,41 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwFOR:
-			if ((i = malloc(sizeof(forType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(forType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteFOR;
 			i->formatFunc = progFormatFOR;
-			i->freeFunc = progFreeFOR;
+			i->freeFunc = progFreeDefault;
 			((forType *)i)->startPoint = va_arg(vl, symbolType *);
 			((forType *)i)->endPoint = va_arg(vl, symbolType *);
 			((forType *)i)->step = va_arg(vl, symbolType *);
 			break;
 		case kwGOSUB:
-			if ((i = malloc(sizeof(gosubType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(gosubType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteGOSUB;
 			i->formatFunc = progFormatGOSUB;
-			i->freeFunc = progFreeGOSUB;
+			i->freeFunc = progFreeDefault;
 			((gosubType *)i)->targetLine = va_arg(vl, symbolType *);
+			progBindTarget(((gosubType *)i)->targetLine, &((gosubType *)i)->target);
 			break;
 		case kwGOTO:
-			if ((i = malloc(sizeof(gotoType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(gotoType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteGOTO;
 			i->formatFunc = progFormatGOTO;
-			i->freeFunc = progFreeGOTO;
+			i->freeFunc = progFreeDefault;
 			((gotoType *)i)->targetLine = va_arg(vl, symbolType *);
+			progBindTarget(((gotoType *)i)->targetLine, &((gotoType *)i)->target);
 			break;
 		case kwIF:
-			if ((i = malloc(sizeof(ifType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(ifType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -406,9 +636,10 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((ifType *)i)->expression = va_arg(vl, symbolType *);
 			((ifType *)i)->gotoOrInstructions = va_arg(vl, void *);
 			((ifType *)i)->isGoto = va_arg(vl, int);
+			progBindTarget(((ifType *)i)->isGoto ? ((ifType *)i)->gotoOrInstructions : NULL, &((ifType *)i)->target);
 			break;
 		case kwINPUT:
-			if ((i = malloc(sizeof(inputType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(inputType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -419,38 +650,38 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((inputType *)i)->numVars = va_arg(vl, unsigned long int);
 			break;
 		case kwLET:
-			if ((i = malloc(sizeof(letType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(letType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteLET;
 			i->formatFunc = progFormatLET;
-			i->freeFunc = progFreeLET;
+			i->freeFunc = progFreeDefault;
 			((letType *)i)->assignment = va_arg(vl, symbolType *);
 			break;
 		case kwLIST:
-			if ((i = malloc(sizeof(listType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(listType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteLIST;
 			i->formatFunc = progFormatLIST;
-			i->freeFunc = progFreeLIST;
+			i->freeFunc = progFreeDefault;
 			((listType *)i)->startLine = va_arg(vl, symbolType *);
 			((listType *)i)->endLine = va_arg(vl, symbolType *);
 			break;
 		case kwLOAD:
-			if ((i = malloc(sizeof(loadType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(loadType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteLOAD;
 			i->formatFunc = progFormatLOAD;
-			i->freeFunc = progFreeLOAD;
+			i->freeFunc = progFreeDefault;
 			((loadType *)i)->fileName = va_arg(vl, symbolType *);
 			break;
 		case kwNEW:
-			if ((i = malloc(sizeof(newType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(newType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -459,17 +690,17 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwNEXT:
-			if ((i = malloc(sizeof(nextType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(nextType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteNEXT;
 			i->formatFunc = progFormatNEXT;
-			i->freeFunc = progFreeNEXT;
+			i->freeFunc = progFreeDefault;
 			((nextType *)i)->iteratorVar = va_arg(vl, symbolType *);
 			break;
 		case kwON:
-			if ((i = malloc(sizeof(onType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(onType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -480,9 +711,16 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((onType *)i)->instruction = va_arg(vl, symbolType *);
 			((onType *)i)->targetList = va_arg(vl, symbolType **);
 			((onType *)i)->numTargets = va_arg(vl, unsigned long int);
+			if ((((onType *)i)->targets = arenaAlloc(p->arena, sizeof(targetType) * ((onType *)i)->numTargets)) == NULL) {
+				utilError(memErr);
+				goto err;
+			}
+			for (j = 0; j < ((onType *)i)->numTargets; j++) {
+				progBindTarget(((onType *)i)->targetList[j], &((onType *)i)->targets[j]);
+			}
 			break;
 		case kwPOP:
-			if ((i = malloc(sizeof(popType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(popType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -491,7 +729,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwPRINT:
-			if ((i = malloc(sizeof(printType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(printType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -502,7 +740,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((printType *)i)->numExpressions = va_arg(vl, unsigned long int);
 			break;
 		case kwREAD:
-			if ((i = malloc(sizeof(readType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(readType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -513,7 +751,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((readType *)i)->numVars = va_arg(vl, unsigned long int);
 			break;
 		case kwREM:
-			if ((i = malloc(sizeof(remType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(remType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -523,17 +761,17 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			((remType *)i)->remark = va_arg(vl, char *);
 			break;
 		case kwRESTORE:
-			if ((i = malloc(sizeof(restoreType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(restoreType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteRESTORE;
 			i->formatFunc = progFormatRESTORE;
-			i->freeFunc = progFreeRESTORE;
+			i->freeFunc = progFreeDefault;
 			((restoreType *)i)->targetLine = va_arg(vl, symbolType *);
 			break;
 		case kwRETURN:
-			if ((i = malloc(sizeof(returnType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(returnType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -542,7 +780,7 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwRUN:
-			if ((i = malloc(sizeof(runType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(runType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -551,17 +789,17 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwSAVE:
-			if ((i = malloc(sizeof(saveType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(saveType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteSAVE;
 			i->formatFunc = progFormatSAVE;
-			i->freeFunc = progFreeSAVE;
+			i->freeFunc = progFreeDefault;
 			((saveType *)i)->fileName = va_arg(vl, symbolType *);
 			break;
 		case kwSTOP:
-			if ((i = malloc(sizeof(stopType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(stopType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
@@ -570,14 +808,15 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 			i->freeFunc = progFreeDefault;
 			break;
 		case kwTRAP:
-			if ((i = malloc(sizeof(trapType))) == NULL) {
+			if ((i = arenaAlloc(p->arena, sizeof(trapType))) == NULL) {
 				utilError(memErr);
 				goto err;
 			}
 			i->executeFunc = progExecuteTRAP;
 			i->formatFunc = progFormatTRAP;
-			i->freeFunc = progFreeTRAP;
+			i->freeFunc = progFreeDefault;
 			((trapType *)i)->targetLine = va_arg(vl, symbolType *);
+			progBindTarget(((trapType *)i)->targetLine, &((trapType *)i)->target);
 			break;
 	}
 	va_end(vl);
@@ -587,6 +826,10 @@ int progAppendInstruction(progLineType *p, keywords keyword, ...) {
 	}
 	i->next = NULL;
 	i->keyword = keyword;
+	if (progCompileInstruction(i, p->arena)) {
+		goto err;
+	}
+	progSpecialise(p, i);
 	if (p->firstInstruction == NULL) {
 		p->firstInstruction = p->lastInstruction = i;
 	} else {
@@ -599,31 +842,113 @@ err:
 }
 
 
-static void progCleanupNumeric(char *s) {
-	char *p = NULL;
-	double d1 = strtod(s, &p);
-	double d2 = trunc(d1);
-	long long int i = d2;
-	if (*p != 0 || p == s) {
-		return;
+static int progCompileExpression(symbolType *e, arenaType *a) {
+	if (e == NULL || e->code != NULL) {
+		return(0);
 	}
-	if (d1 - d2 == 0) {
-		sprintf(s, "%i", i);
+	if ((e->code = codeCompile(e, a)) == NULL) {
+		return(1);
 	}
+	return(0);
 }
 
 
-void progDeleteExpression(symbolType *e) {
-	if (e == NULL) {
-		return;
-	}
-	if (e->l) {
-		progDeleteExpression(e->l);
+/*
+ * Lower every expression held by an instruction to code as it is built, so
+ * nothing is compiled while the program runs.
+ */
+static int progCompileInstruction(instructionType *i, arenaType *a) {
+	unsigned long int j;
+	int rc = 0;
+	switch (i->keyword) {
+		case kwAssignment:
+			rc = progCompileLvalue(((assignmentType *)i)->assignment->l, a);
+			rc |= progCompileExpression(((assignmentType *)i)->assignment->r, a);
+			break;
+		case kwDIM:
+			for (j = 0; j < ((dimType *)i)->numElements; j++) {
+				rc |= progCompileLvalue(((dimType *)i)->dimList[j], a);
+			}
+			break;
+		case kwFOR:
+			rc = progCompileLvalue(((forType *)i)->startPoint->l, a);
+			rc |= progCompileExpression(((forType *)i)->startPoint->r, a);
+			rc |= progCompileExpression(((forType *)i)->endPoint, a);
+			rc |= progCompileExpression(((forType *)i)->step, a);
+			break;
+		case kwGOSUB:
+			rc = progCompileExpression(((gosubType *)i)->targetLine, a);
+			break;
+		case kwGOTO:
+			rc = progCompileExpression(((gotoType *)i)->targetLine, a);
+			break;
+		case kwIF:
+			rc = progCompileExpression(((ifType *)i)->expression, a);
+			if (((ifType *)i)->isGoto) {
+				rc |= progCompileExpression(((ifType *)i)->gotoOrInstructions, a);
+			}
+			break;
+		case kwINPUT:
+			for (j = 0; j < ((inputType *)i)->numVars; j++) {
+				rc |= progCompileLvalue(((inputType *)i)->varList[j], a);
+			}
+			break;
+		case kwLET:
+			rc = progCompileLvalue(((letType *)i)->assignment->l, a);
+			rc |= progCompileExpression(((letType *)i)->assignment->r, a);
+			break;
+		case kwLIST:
+			rc = progCompileExpression(((listType *)i)->startLine, a);
+			rc |= progCompileExpression(((listType *)i)->endLine, a);
+			break;
+		case kwCLOAD:
+		case kwLOAD:
+			rc = progCompileExpression(((loadType *)i)->fileName, a);
+			break;
+		case kwON:
+			rc = progCompileExpression(((onType *)i)->expression, a);
+			for (j = 0; j < ((onType *)i)->numTargets; j++) {
+				rc |= progCompileExpression(((onType *)i)->targetList[j], a);
+			}
+			break;
+		case kwPRINT:
+			for (j = 0; j < ((printType *)i)->numExpressions; j++) {
+				if (((printType *)i)->expressionList[j]->id != kwComma && ((printType *)i)->expressionList[j]->id != kwSemicolon) {
+					rc |= progCompileExpression(((printType *)i)->expressionList[j], a);
+				}
+			}
+			break;
+		case kwREAD:
+			for (j = 0; j < ((readType *)i)->numVars; j++) {
+				rc |= progCompileLvalue(((readType *)i)->varList[j], a);
+			}
+			break;
+		case kwRESTORE:
+			rc = progCompileExpression(((restoreType *)i)->targetLine, a);
+			break;
+		case kwCSAVE:
+		case kwSAVE:
+			rc = progCompileExpression(((saveType *)i)->fileName, a);
+			break;
+		case kwTRAP:
+			rc = progCompileExpression(((trapType *)i)->targetLine, a);
+			break;
 	}
-	if (e->r) {
-		progDeleteExpression(e->r);
+	return(rc);
+}
+
+
+static int progCompileLvalue(symbolType *id, arenaType *a) {
+	return(progCompileExpression(id->l, a) | progCompileExpression(id->r, a));
+}
+
+
+int progCreate(void) {
+	if ((interpCurrent->progState = calloc(1, sizeof(progStateType))) == NULL) {
+		return(1);
 	}
-	free(e);
+	progGeneration = 1;
+	return(0);
 }
 
 
@@ -638,746 +963,1516 @@ void progDeleteInstructions(instructionType *i) {
 
 
 void progDeleteLine(progLineType *p) {
-	progLineType *cp = prog;
-	progLineType *np;
-	progDeleteInstructions(p->firstInstruction);
-	if (prog == p) {
-		prog = prog->next;
-	} else {
-		cp = prog;
-		while (cp->next && cp->next != p) {
-			cp = cp->next;
-		}
-		if (cp->next == p) {
-			cp->next = p->next;
+	unsigned long int i = progIndexFind(p->lineNum);
+	if (i < progIndexLen && progIndex[i] == p) {
+		if (i > 0) {
+			progIndex[i - 1]->next = p->next;
+		} else {
+			prog = p->next;
 		}
+		memmove(&progIndex[i], &progIndex[i + 1], sizeof(progLineType *) * (progIndexLen - i - 1));
+		progIndexLen--;
+		progGeneration++;
+		progEdits++;
 	}
+	progDeleteInstructions(p->firstInstruction);
+	progJitFree(p);
+	arenaFree(p->arena);
 	free(p);
 }
 
 
-static void progExecute(void) {
-	keywords keyword;
-	while (progCurrent && progCurrent->currentInstruction) {
-		keyword = progCurrent->currentInstruction->keyword;
-		progCurrent->currentInstruction->executeFunc(progCurrent->currentInstruction);
-		if (keyword == kwRUN || keyword == kwBYE || keyword == kwSTOP || keyword == kwEND) {
-			return;
-		}
-		if (keyword != kwGOTO && keyword != kwGOSUB && keyword != kwIF && keyword != kwRETURN && keyword != kwNEXT) {
-			if (progCurrent) {
-				if (progCurrent->currentInstruction && progCurrent->currentInstruction->next) {
-					progCurrent->currentInstruction = progCurrent->currentInstruction->next;
-				} else {
-					progCurrent = progCurrent->next;
-					if (progCurrent) {
-						progCurrent->currentInstruction = progCurrent->firstInstruction;
-					}
-				}
-			}
-		}
-	}
-}
-
-
-static void progExecuteAssignment(void *vp) {
-	assignmentType *ap = (assignmentType *)vp;
-	char *expression = NULL;
-	char *s1 = NULL;
-	char *s2 = NULL;
-	long dim1 = 1;
-	long dim2 = 1;
-	if ((expression = eval(ap->assignment->r)) == NULL) {
-		goto err;
-	}
-	if (ap->assignment->l->l != NULL) {
-		s1 = eval(ap->assignment->l->l);
-		dim1 = strtol(s1, NULL, 10);
-	}
-	if (ap->assignment->l->r != NULL) {
-		s2 = eval(ap->assignment->l->r);
-		dim2 = strtol(s2, NULL, 10);
-	}
-	if (varSetValue(ap->assignment->l->value, expression, dim1, dim2)) {
-		goto err;
-	}
-err:
-	if (s1 != NULL) {
-		free(s1);
+void progDestroy(void) {
+	if (interpCurrent->progState == NULL) {
+		return;
 	}
-	if (s2 != NULL) {
-		free(s2);
+	progNew();
+	if (controlStack != NULL) {
+		free(controlStack);
 	}
-	if (expression != NULL) {
-		free(expression);
+	if (progIndex != NULL) {
+		free(progIndex);
 	}
+	free(interpCurrent->progState);
+	interpCurrent->progState = NULL;
 }
 
 
-static void progExecuteBYE(void *vp) {
-}
-
-
-static void progExecuteCLR(void *vp) {
-	varClearAll();
-}
-
-
-static void progExecuteCLS(void *vp) {
-	system("clear");
+/*
+ * Point a constant jump target at its line when the line already exists.
+ * Anything else is left to progResolveTarget when the jump first runs.
+ */
+static void progBindTarget(symbolType *e, targetType *t) {
+	t->line = NULL;
+	t->generation = 0;
+	if (e != NULL && e->id == kwNumeric) {
+		if ((t->line = progFindLine(strtod(e->value, NULL))) != NULL) {
+			t->generation = progGeneration;
+		}
+	}
 }
 
 
-static void progExecuteCONT(void *vp) {
-	if (progStop != NULL) {
-		progCurrent = progStop;
+/*
+ * Carry on with the statement after instruction i of line p, or with the
+ * next line when i is the last statement.
+ */
+static void progContinueAfter(progLineType *p, instructionType *i) {
+	progCurrent = p;
+	if (i->next != NULL) {
+		progCurrent->currentInstruction = i->next;
+		return;
+	}
+	progCurrent = progCurrent->next;
+	if (progCurrent != NULL) {
 		progCurrent->currentInstruction = progCurrent->firstInstruction;
-		progStop = NULL;
 	}
 }
 
 
-static void progExecuteDATA(void *vp) {
-	long int lineNum = -1;
-	if (progCurrent != NULL) {
-		lineNum = progCurrent->lineNum;
+/*
+ * Return the position of the innermost FOR frame for the variable in slot,
+ * or -1 if there isn't one. The search stops at the innermost GOSUB, so a
+ * subroutine can't reach the loops of its caller.
+ */
+static long int progControlFindFOR(long int slot) {
+	long int i;
+	for (i = controlStackLen - 1; i >= 0 && controlStack[i].kind != kwGOSUB; i--) {
+		if (controlStack[i].slot == slot) {
+			return(i);
+		}
 	}
-	varAppendData(((dataType *)vp)->dataList, lineNum);
+	return(-1);
 }
 
 
-static void progExecuteDIM(void *vp) {
-	dimType *dt = (dimType *)vp;
-	unsigned long int i;
-	char *s1;
-	char *s2;
-	long d1;
-	long d2;
-	for (i = 0UL; i < dt->numElements; i++) {
-		d1 = 1L;
-		d2 = 1L;
-		if (dt->dimList[i]->l != NULL) {
-			if ((s1 = eval(dt->dimList[i]->l)) == NULL) {
-				utilError("couldn't dimension variable [%s]", dt->dimList[i]->value);
-				return;
-			}
-			d1 = strtol(s1, NULL, 10);
-		}
-		if (dt->dimList[i]->r != NULL) {
-			if ((s2 = eval(dt->dimList[i]->r)) == NULL) {
-				utilError("couldn't dimension variable [%s]", dt->dimList[i]->value);
-				return;
-			}
-			d2 = strtol(s2, NULL, 10);
+/*
+ * Push a frame of the given kind for the instruction running now, growing
+ * the stack as needed up to CONTROL_STACK_LEN_MAX frames.
+ *
+ * Returns the new frame, or NULL after reporting an error.
+ */
+static controlFrameType *progControlPush(keywords kind) {
+	controlFrameType *f;
+	long int max;
+	if (controlStackLen == controlStackMax) {
+		if (controlStackMax == CONTROL_STACK_LEN_MAX) {
+			utilError("too many nested GOSUBs and FOR loops");
+			return(NULL);
 		}
-		if (varDim(dt->dimList[i]->value, d1, d2)) {
-			utilError("couldn't dimension variable: %s(%i, %i)", dt->dimList[i]->value, d1, d2);
-			return;
+		max = controlStackMax ? controlStackMax << 1 : CONTROL_STACK_LEN_DEF;
+		if ((f = realloc(controlStack, sizeof(controlFrameType) * max)) == NULL) {
+			utilError(memErr);
+			return(NULL);
 		}
-	}
+		controlStack = f;
+		controlStackMax = max;
+	}
+	f = &controlStack[controlStackLen++];
+	f->kind = kind;
+	f->line = progCurrent;
+	f->ins = progCurrent->currentInstruction;
+	f->slot = -1;
+	return(f);
 }
 
 
-static void progExecuteEND(void *vp) {
+static void progDefineArgs(void) {
+	valueType v = {valNumeric, 0, NULL};
+	long int slot;
+	int i;
+	varSetNumeric(varLookup("argc"), progArgc, 1, 1);
+	slot = varLookup("arg$");
+	if (varDim(slot, progArgc, 1)) {
+		utilError(memErr);
+		return;
+	}
+	for (i = 0; i < progArgc; i++) {
+		if (valueSetString(&v, progArgv[i]) == 0) {
+			varSetValue(slot, &v, i + 1, 1);
+		}
+	}
+	valueClear(&v);
 }
 
 
-static void progExecuteFOR(void *vp) {
-	forType *fp = (forType *)vp;
-	char *expression = NULL;
-	long dim1 = 1;
-	long dim2 = 1;
+/*
+ * Write the program to file fn, or to stdout when fn is NULL, as a
+ * standalone C program that does what running it here would. Each line is
+ * a label, GOTO is a goto, and GOSUB and FOR push the address of the label
+ * after them on a stack for RETURN and NEXT to jump to. A computed target
+ * goes through a switch on the line number. Statements that work on the
+ * program itself, like LIST and SAVE, can't be translated.
+ */
+int progEmitC(const char *fn) {
+	progEmitType e;
+	progLineType *p;
+	instructionType *i;
+	unsigned long int j;
+	char **d;
 	char *s;
-	if ((expression = eval(fp->startPoint->r)) == NULL) {
+	int rc = 1;
+	memset(&e, 0, sizeof(progEmitType));
+	emitBegin();
+	if ((e.labels = calloc(progIndexLen + 1, 1)) == NULL) {
+		utilError(memErr);
 		goto err;
 	}
-	if (fp->startPoint->l->l != NULL) {
-		s = eval(fp->startPoint->l->l);
-		dim1 = strtol(s, NULL, 10);
-		free(s);
+	for (p = prog; p != NULL; p = p->next) {
+		if (progEmitNote(&e, p, p->firstInstruction)) {
+			goto err;
+		}
 	}
-	if (fp->startPoint->l->r != NULL) {
-		s = eval(fp->startPoint->l->r);
-		dim2 = strtol(s, NULL, 10);
-		free(s);
+	if (fn != NULL && ioOpenOutput((char *)fn)) {
+		utilError("unable to create output file [%s]", fn);
+		goto err;
 	}
-	varSetValue(fp->startPoint->l->value, expression, dim1, dim2);
-	stackPush(forLineStack, progCurrent);
-	stackPush(forInstructionStack, progCurrent->currentInstruction);
-err:
-	if (expression != NULL) {
-		free(expression);
+	ioPrintf("/*\n * Translated from BASIC by abasic --emit-c. Build with\n *\n *\tcc -O2 -o prog prog.c -lm\n */\n\n");
+	emitRuntime(e.temps + 1);
+	for (j = 0; j < e.numData; j++) {
+		ioPrintf("\nstatic const char *const basData%lu[] = {", j);
+		for (d = ((dataType *)e.data[j])->dataList; *d != NULL; d++) {
+			emitString(*d);
+			if (d[1] != NULL) {
+				ioWrite(", ", 2);
+			}
+		}
+		ioPrintf("};\n");
+	}
+	ioPrintf("\nint main(int argc, char **argv) {\n");
+	emitDeclarations("\t");
+	ioPrintf("\tsrand(time(NULL));\n\tbasArgc = argc - 1;\n\tbasArgv = argv + 1;\n");
+	if (e.run) {
+		ioPrintf("L_run:\n");
+	}
+	emitClear("\t");
+	emitDefineArgs("\t");
+	ioPrintf("\tbasStackLen = 0;\n");
+	for (p = prog; p != NULL; p = p->next) {
+		for (i = p->firstInstruction; i != NULL; i = i->next) {
+			if (i->keyword == kwDATA) {
+				progEmitData(&e, p, i);
+			}
+		}
 	}
-}
-
-
-static void progExecuteGOSUB(void *vp) {
-	gosubType *gp = (gosubType *)vp;
-	if (gp->targetLine == NULL) {
-		utilError("expected expression");
-		goto err;
+	for (p = prog, j = 0; p != NULL; p = p->next, j++) {
+		if (e.dispatch || e.labels[j]) {
+			ioPrintf("L%li:\n", p->lineNum);
+		}
+		if ((s = formatLine(p->firstInstruction)) != NULL) {
+			progEmitComment(p->lineNum, s);
+			free(s);
+		}
+		progEmitInstructions(&e, p, p->firstInstruction);
 	}
-	char *s = eval(gp->targetLine);
-	if (s == NULL) {
-		utilError("couldn't evaluate expression");
-		goto err;
+	if (e.labels[progIndexLen]) {
+		ioPrintf("L_end:\n");
 	}
-	unsigned long int l = strtol(s, NULL, 10);
-	free(s);
-	progLineType *p = prog;
-	while (p && p->lineNum != l) {
-		p = p->next;
+	ioPrintf("\treturn(0);\n");
+	if (e.dispatch) {
+		ioPrintf("L_dispatch:\n\tswitch (basLine) {\n");
+		for (p = prog; p != NULL; p = p->next) {
+			ioPrintf("\t\tcase %li:\n\t\t\tgoto L%li;\n", p->lineNum, p->lineNum);
+		}
+		ioPrintf("\t}\n\tbasError(\"line %%li not found\", basLine);\n\treturn(1);\n");
 	}
-	if (p && p->lineNum == l) {
-		stackPush(callStack, progCurrent->next);
-		progCurrent = p;
-		progCurrent->currentInstruction = progCurrent->firstInstruction;
-		return;
+	ioPrintf("}\n");
+	rc = 0;
+	if (fn != NULL && ioCloseOutput()) {
+		utilError("unable to write output file [%s]", fn);
+		rc = 1;
 	}
-	utilError("line %l not found", l);
 err:
-	return;
-}
-
-
-static void progExecuteGOTO(void *vp) {
-	gotoType *gp = (gotoType *)vp;
-	if (gp->targetLine == NULL) {
-		utilError("expected expression");
-		goto err;
-	}
-	char *s = eval(gp->targetLine);
-	if (s == NULL) {
-		utilError("couldn't evaluate expression");
-		goto err;
-	}
-	unsigned long int l = strtol(s, NULL, 10);
-	free(s);
-	progLineType *p = prog;
-	while (p && p->lineNum != l) {
-		p = p->next;
+	if (e.labels != NULL) {
+		free(e.labels);
 	}
-	if (p && p->lineNum == l) {
-		progCurrent = p;
-		progCurrent->currentInstruction = progCurrent->firstInstruction;
-		return;
+	if (e.data != NULL) {
+		free(e.data);
 	}
-	utilError("line %l not found", l);
-err:
-	return;
+	emitBegin();
+	return(rc);
 }
 
 
-static void progExecuteIF(void *vp) {
-	ifType *ip = (ifType *)vp;
-	char *e = NULL;
-	progLineType *p = prog;
-	long int i;
-	if ((e = eval(ip->expression)) == NULL) {
-		goto err;
+/*
+ * Write source line s of line lineNum as a comment, breaking up anything in
+ * it that would end the comment.
+ */
+static void progEmitComment(long int lineNum, const char *s) {
+	ioPrintf("\t/* %li ", lineNum);
+	for (; *s; s++) {
+		ioWrite(s, 1);
+		if (s[0] == '*' && s[1] == '/') {
+			ioWrite(" ", 1);
+		}
 	}
-	i = strtol(e, NULL, 10);
-	free(e);
-	e = NULL;
-	if (i == 1) {
-		if (ip->isGoto) {
-			if ((e = eval(ip->gotoOrInstructions)) == NULL) {
-				goto err;
-			}
-			i = strtol(e, NULL, 10);
-			free(e);
-			e = NULL;
-			while (p && p->lineNum != i) {
-				p = p->next;
-			}
-			if (p && p->lineNum == i) {
-				progCurrent = p;
-				progCurrent->currentInstruction = progCurrent->firstInstruction;
-				return;
-			} else {
-				utilError("goto target line %i not found", i);
-				goto err;
+	ioPrintf(" */\n");
+}
+
+
+/*
+ * Add the items of DATA statement i of line p to the DATA table.
+ */
+static void progEmitData(progEmitType *e, progLineType *p, instructionType *i) {
+	unsigned long int j;
+	unsigned long int n = 0;
+	for (j = 0; j < e->numData; j++) {
+		if (e->data[j] == i) {
+			while (((dataType *)i)->dataList[n] != NULL) {
+				n++;
 			}
-		} else {
-			progCurrent->currentInstruction = ip->gotoOrInstructions;
+			ioPrintf("\tbasDataAdd(%li, basData%lu, %lu);\n", p->lineNum, j, n);
 			return;
 		}
 	}
-	progCurrent = progCurrent->next;
-	if (progCurrent) {
-		progCurrent->currentInstruction = progCurrent->firstInstruction;
+}
+
+
+/*
+ * Jump to target line t. A computed target is looked up by L_dispatch.
+ */
+static void progEmitGoto(symbolType *t, const char *indent) {
+	long int l;
+	if (t->id != kwNumeric) {
+		ioPrintf("%sbasLine = (long)", indent);
+		progEmitParenthesised(t);
+		ioPrintf(";\n%sgoto L_dispatch;\n", indent);
+		return;
 	}
-err:
-	if (e != NULL) {
-		free(e);
+	l = strtod(t->value, NULL);
+	if (progFindLine(l) == NULL) {
+		ioPrintf("%sbasError(\"line %%li not found\", %liL);\n", indent, l);
+	} else {
+		ioPrintf("%sgoto L%li;\n", indent, l);
 	}
-	return;
 }
 
 
-static void progExecuteINPUT(void *vp) {
-	inputType *ip = (inputType *)vp;
-	char *l;
-	char *s = NULL;
-	char *t;
-	long int len, dim1, dim2;
-	unsigned long int i;
-	for (i = 0L; i < ip->numVars; i++) {
-		l = NULL;
-		len = 0L;
-		getline(&l, &len, stdin);
-		dim1 = 1;
-		dim2 = 1;
-		if (ip->varList[i]->l != NULL) {
-			s = eval(ip->varList[i]->l);
-			dim1 = strtol(s, NULL, 10);
-			free(s);
-			s = NULL;
-		}
-		if (ip->varList[i]->r != NULL) {
-			s = eval(ip->varList[i]->r);
-			dim2 = strtol(s, NULL, 10);
-			free(s);
-			s = NULL;
-		}
-		if ((t = strrchr(l, '\n')) != NULL) {
-			*t = 0;
-		}
-		if (varSetValue(ip->varList[i]->value, l, dim1, dim2)) {
-			goto err;
+/*
+ * Write the statements from i on, which belong to line p. The statements
+ * after IF THEN follow it in line, so that anything jumping back into them,
+ * like NEXT and RETURN, lands where the interpreter would.
+ */
+static void progEmitInstructions(progEmitType *e, progLineType *p, instructionType *i) {
+	symbolType *id;
+	unsigned long int j;
+	int s;
+	for (; i != NULL; i = i->next) {
+		switch (i->keyword) {
+			case kwAssignment:
+			case kwLET:
+				id = ((assignmentType *)i)->assignment->l;
+				s = emitIsString(id);
+				if (!emitIsArray(id)) {
+					ioPrintf("\t%s", s ? "basSet(" : "");
+					emitRef(id, 0);
+					ioPrintf("%s", s ? ", " : " = ");
+					emitExpression(((assignmentType *)i)->assignment->r, s);
+					ioPrintf("%s;\n", s ? ")" : "");
+					break;
+				}
+				ioPrintf("\t{\n\t\t%s = ", s ? "const char *t" : "double t");
+				emitExpression(((assignmentType *)i)->assignment->r, s);
+				ioPrintf(";\n");
+				progEmitStore(id, "t", s, "\t\t");
+				ioPrintf("\t}\n");
+				break;
+			case kwBYE:
+			case kwEND:
+			case kwSTOP:
+				ioPrintf("\tgoto L_end;\n");
+				break;
+			case kwCLR:
+				emitClear("\t");
+				break;
+			case kwCLS:
+				ioPrintf("\tbasCls();\n");
+				break;
+			case kwDATA:
+				progEmitData(e, p, i);
+				break;
+			case kwDIM:
+				for (j = 0; j < ((dimType *)i)->numElements; j++) {
+					id = ((dimType *)i)->dimList[j];
+					ioPrintf("\t{\n");
+					emitIndices(id, "\t\t");
+					ioPrintf("\t\tbasDim(&");
+					emitName(id);
+					ioPrintf(", ");
+					emitString(id->value);
+					ioPrintf(", d1, d2, %i);\n\t}\n", emitIsString(id));
+				}
+				break;
+			case kwFOR:
+				id = ((forType *)i)->startPoint->l;
+				ioPrintf("\t{\n\t\tdouble t = ");
+				emitExpression(((forType *)i)->startPoint->r, 0);
+				ioPrintf(";\n");
+				emitIndices(id, "\t\t");
+				ioPrintf("\t\tdouble limit = ");
+				emitExpression(((forType *)i)->endPoint, 0);
+				ioPrintf(";\n\t\tdouble step = ");
+				if (((forType *)i)->step != NULL) {
+					emitExpression(((forType *)i)->step, 0);
+				} else {
+					ioWrite("1", 1);
+				}
+				ioPrintf(";\n\t\t");
+				emitRef(id, 0);
+				ioPrintf(" = t;\n\t\tbasFor(%li, %s, limit, step, &&R%lu);\n\t}\nR%lu:\n", id->slot, emitIsArray(id) ? "d1, d2" : "1, 1", e->resume, e->resume);
+				e->resume++;
+				break;
+			case kwGOSUB:
+				ioPrintf("\tbasPush(-1, &&R%lu);\n", e->resume);
+				progEmitGoto(((gosubType *)i)->targetLine, "\t");
+				ioPrintf("R%lu:\n", e->resume++);
+				break;
+			case kwGOTO:
+				progEmitGoto(((gotoType *)i)->targetLine, "\t");
+				break;
+			case kwIF:
+				ioPrintf("\tif (%s", ((ifType *)i)->isGoto ? "" : "!");
+				progEmitParenthesised(((ifType *)i)->expression);
+				ioPrintf(") {\n");
+				if (((ifType *)i)->isGoto) {
+					progEmitGoto(((ifType *)i)->gotoOrInstructions, "\t\t");
+					ioPrintf("\t}\n");
+				} else {
+					ioPrintf("\t\t");
+					progEmitNext(p);
+					ioPrintf("\t}\n");
+					progEmitInstructions(e, p, ((ifType *)i)->gotoOrInstructions);
+				}
+				if (i->next != NULL) {
+					ioPrintf("\t");
+					progEmitNext(p);
+				}
+				return;
+			case kwINPUT:
+				if (((inputType *)i)->numVars == 0) {
+					ioPrintf("\tfflush(stdout);\n");
+					break;
+				}
+				ioPrintf("\tdo {\n\t\tchar *t;\n");
+				for (j = 0; j < ((inputType *)i)->numVars; j++) {
+					id = ((inputType *)i)->varList[j];
+					ioPrintf("\t\tif ((t = basInput()) == NULL) {\n\t\t\tbreak;\n\t\t}\n");
+					if (emitIsArray(id)) {
+						ioPrintf("\t\t{\n");
+						progEmitStore(id, "t", 1, "\t\t\t");
+						ioPrintf("\t\t}\n");
+					} else {
+						progEmitStore(id, "t", 1, "\t\t");
+					}
+				}
+				ioPrintf("\t} while (0);\n");
+				break;
+			case kwNEXT:
+				id = ((nextType *)i)->iteratorVar;
+				ioPrintf("\t{\n\t\tbasFrame *f = basNext(%li);\n", id->slot);
+				if (emitIsArray(id)) {
+					ioPrintf("\t\tlong d1 = f->dim1;\n\t\tlong d2 = f->dim2;\n");
+				}
+				ioPrintf("\t\tdouble d = ");
+				emitRef(id, 0);
+				ioPrintf(" += f->step;\n");
+				ioPrintf("\t\tif (f->step < 0 ? d < f->limit : d > f->limit) {\n\t\t\tbasStackLen--;\n\t\t} else {\n\t\t\tgoto *f->resume;\n\t\t}\n\t}\n");
+				break;
+			case kwON:
+				ioPrintf("\tswitch ((long)");
+				progEmitParenthesised(((onType *)i)->expression);
+				ioPrintf(") {\n");
+				for (j = 0; j < ((onType *)i)->numTargets; j++) {
+					ioPrintf("\t\tcase %lu:\n", j + 1);
+					if (((onType *)i)->instruction->id == kwGOSUB) {
+						ioPrintf("\t\t\tbasPush(-1, &&R%lu);\n", e->resume);
+					}
+					progEmitGoto(((onType *)i)->targetList[j], "\t\t\t");
+				}
+				ioPrintf("\t}\n");
+				if (((onType *)i)->instruction->id == kwGOSUB) {
+					ioPrintf("R%lu:\n", e->resume++);
+				}
+				break;
+			case kwPOP:
+				ioPrintf("\tbasPop();\n");
+				break;
+			case kwPRINT:
+				progEmitPRINT((printType *)i);
+				break;
+			case kwREAD:
+				ioPrintf("\tdo {\n");
+				for (j = 0; j < ((readType *)i)->numVars; j++) {
+					id = ((readType *)i)->varList[j];
+					if (!emitIsArray(id) && !emitIsString(id)) {
+						ioPrintf("\t\tif (basReadN(");
+						emitRef(id, 1);
+						ioPrintf(")) {\n\t\t\tbreak;\n\t\t}\n");
+						continue;
+					}
+					ioPrintf("\t\t{\n");
+					emitIndices(id, "\t\t\t");
+					if (emitIsString(id)) {
+						ioPrintf("\t\t\tchar **r = ");
+						emitRef(id, 1);
+						ioPrintf(";\n\t\t\tconst char *s = basReadS();\n\t\t\tif (s == NULL) {\n\t\t\t\tbreak;\n\t\t\t}\n\t\t\tbasSet(r, s);\n");
+					} else {
+						ioPrintf("\t\t\tif (basReadN(");
+						emitRef(id, 1);
+						ioPrintf(")) {\n\t\t\t\tbreak;\n\t\t\t}\n");
+					}
+					ioPrintf("\t\t}\n");
+				}
+				ioPrintf("\t} while (0);\n");
+				break;
+			case kwRESTORE:
+				ioPrintf("\tbasRestore(");
+				if (((restoreType *)i)->targetLine != NULL) {
+					ioPrintf("(long)");
+					progEmitParenthesised(((restoreType *)i)->targetLine);
+				} else {
+					ioPrintf("-1");
+				}
+				ioPrintf(");\n");
+				break;
+			case kwRETURN:
+				ioPrintf("\tgoto *basReturn();\n");
+				break;
+			case kwRUN:
+				ioPrintf("\tgoto L_run;\n");
+				break;
+			case kwTRAP:
+				progEmitTRAP(((trapType *)i)->targetLine);
+				break;
+			default:
+				break;
 		}
-		free(l);
-		l = NULL;
-	}
-err:
-	if (s != NULL) {
-		free(s);
 	}
-	if (l != NULL) {
-		free(l);
-	}
-	return;
 }
 
 
-static void progExecuteLET(void *vp) {
-	letType *lp = (letType *)vp;
-	char *expression = NULL;
-	char *s1 = NULL;
-	char *s2 = NULL;
-	long dim1 = 1;
-	long dim2 = 1;
-	if ((expression = eval(lp->assignment->r)) == NULL) {
-		goto err;
-	}
-	if (lp->assignment->l->l != NULL) {
-		s1 = eval(lp->assignment->l->l);
-		dim1 = strtol(s1, NULL, 10);
-	}
-	if (lp->assignment->l->r != NULL) {
-		s2 = eval(lp->assignment->l->r);
-		dim2 = strtol(s1, NULL, 10);
-	}
-	if (varSetValue(lp->assignment->l->value, expression, dim1, dim2)) {
-		goto err;
-	}
-err:
-	if (s1 != NULL) {
-		free(s1);
-	}
-	if (s2 != NULL) {
-		free(s2);
+/*
+ * Mark the line target t jumps to as needing a label.
+ */
+static void progEmitMark(progEmitType *e, symbolType *t) {
+	unsigned long int j;
+	long int l;
+	if (t->id != kwNumeric) {
+		e->dispatch = 1;
+		return;
 	}
-	if (expression != NULL) {
-		free(expression);
+	l = strtod(t->value, NULL);
+	j = progIndexFind(l);
+	if (j < progIndexLen && progIndex[j]->lineNum == l) {
+		e->labels[j] = 1;
 	}
 }
 
 
-void progExecuteLine(progLineType *p) {
-	progCurrent = p;
-	if (progCurrent) {
-		progCurrent->currentInstruction = progCurrent->firstInstruction;
+/*
+ * Continue with the line after p.
+ */
+static void progEmitNext(progLineType *p) {
+	if (p->next != NULL) {
+		ioPrintf("goto L%li;\n", p->next->lineNum);
+	} else {
+		ioPrintf("goto L_end;\n");
 	}
-	progExecute();
 }
 
 
-static void progExecuteLIST(void *vp) {
-	listType *lp = (listType *)vp;
-	char *s1 = eval(lp->startLine);
-	char *s2 = eval(lp->endLine);
-	int l1 = -1;
-	int l2 = -1;
-	if (s1 != NULL) {
-		l1 = strtol(s1, NULL, 10);
-		free(s1);
-	}
-	if (s2 != NULL) {
-		l2 = strtol(s2, NULL, 10);
-		free(s2);
+/*
+ * Note what the statements from i on, which belong to line p, need: their
+ * variables, the lines they jump to and their DATA. Statements that can't
+ * be translated are reported here, before any output is written.
+ */
+static int progEmitNote(progEmitType *e, progLineType *p, instructionType *i) {
+	instructionType **d;
+	symbolType **l = NULL;
+	symbolType *id;
+	unsigned long int n = 0;
+	unsigned long int t;
+	unsigned long int j;
+	for (; i != NULL; i = i->next) {
+		t = 1;
+		switch (i->keyword) {
+			case kwAssignment:
+			case kwLET:
+				t += emitTemps(((assignmentType *)i)->assignment);
+				if (emitNoteExpression(((assignmentType *)i)->assignment)) {
+					return(1);
+				}
+				break;
+			case kwDATA:
+				if (((dataType *)i)->dataList[0] == NULL) {
+					break;
+				}
+				if ((d = realloc(e->data, sizeof(instructionType *) * (e->numData + 1))) == NULL) {
+					utilError(memErr);
+					return(1);
+				}
+				e->data = d;
+				e->data[e->numData++] = i;
+				break;
+			case kwDIM:
+				l = ((dimType *)i)->dimList;
+				n = ((dimType *)i)->numElements;
+				for (j = 0; j < n; j++) {
+					if (emitNoteVariable(l[j], 1)) {
+						return(1);
+					}
+				}
+				break;
+			case kwFOR:
+				id = ((forType *)i)->startPoint->l;
+				if (strchr(id->value, '$') != NULL) {
+					utilError("line %li: FOR with string variable %s can't be translated", p->lineNum, id->value);
+					return(1);
+				}
+				t += emitTemps(((forType *)i)->startPoint) + emitTemps(((forType *)i)->endPoint) + emitTemps(((forType *)i)->step);
+				if (emitNoteExpression(((forType *)i)->startPoint) || emitNoteExpression(((forType *)i)->endPoint) || emitNoteExpression(((forType *)i)->step)) {
+					return(1);
+				}
+				break;
+			case kwGOSUB:
+			case kwGOTO:
+			case kwTRAP:
+				id = i->keyword == kwGOSUB ? ((gosubType *)i)->targetLine : i->keyword == kwGOTO ? ((gotoType *)i)->targetLine : ((trapType *)i)->targetLine;
+				t += emitTemps(id);
+				if (emitNoteExpression(id)) {
+					return(1);
+				}
+				if (i->keyword != kwTRAP) {
+					progEmitMark(e, id);
+				}
+				break;
+			case kwIF:
+				t += emitTemps(((ifType *)i)->expression);
+				if (emitNoteExpression(((ifType *)i)->expression)) {
+					return(1);
+				}
+				if (((ifType *)i)->isGoto) {
+					if (emitNoteExpression(((ifType *)i)->gotoOrInstructions)) {
+						return(1);
+					}
+					progEmitMark(e, ((ifType *)i)->gotoOrInstructions);
+				} else if (progEmitNote(e, p, ((ifType *)i)->gotoOrInstructions)) {
+					return(1);
+				}
+				if (!((ifType *)i)->isGoto || i->next != NULL) {
+					e->labels[p->next != NULL ? progIndexFind(p->next->lineNum) : progIndexLen] = 1;
+				}
+				break;
+			case kwINPUT:
+			case kwREAD:
+				l = i->keyword == kwINPUT ? ((inputType *)i)->varList : ((readType *)i)->varList;
+				n = i->keyword == kwINPUT ? ((inputType *)i)->numVars : ((readType *)i)->numVars;
+				break;
+			case kwNEXT:
+				id = ((nextType *)i)->iteratorVar;
+				if (strchr(id->value, '$') != NULL) {
+					utilError("line %li: NEXT with string variable %s can't be translated", p->lineNum, id->value);
+					return(1);
+				}
+				if (emitNoteVariable(id, 0)) {
+					return(1);
+				}
+				break;
+			case kwON:
+				t += emitTemps(((onType *)i)->expression);
+				if (emitNoteExpression(((onType *)i)->expression)) {
+					return(1);
+				}
+				l = ((onType *)i)->targetList;
+				n = ((onType *)i)->numTargets;
+				for (j = 0; j < n; j++) {
+					progEmitMark(e, l[j]);
+				}
+				break;
+			case kwPRINT:
+				l = ((printType *)i)->expressionList;
+				n = ((printType *)i)->numExpressions;
+				break;
+			case kwRESTORE:
+				t += emitTemps(((restoreType *)i)->targetLine);
+				if (emitNoteExpression(((restoreType *)i)->targetLine)) {
+					return(1);
+				}
+				break;
+			case kwRUN:
+				e->run = 1;
+				break;
+			case kwBYE:
+			case kwEND:
+			case kwSTOP:
+				e->labels[progIndexLen] = 1;
+				break;
+			case kwCLOAD:
+			case kwCSAVE:
+			case kwLIST:
+			case kwLOAD:
+			case kwNEW:
+			case kwSAVE:
+				utilError("line %li: %s can't be translated", p->lineNum, scanGetKeyword(i->keyword));
+				return(1);
+			default:
+				break;
+		}
+		for (j = 0; j < n; j++) {
+			t += emitTemps(l[j]);
+			if (emitNoteExpression(l[j])) {
+				return(1);
+			}
+		}
+		n = 0;
+		if (t > e->temps) {
+			e->temps = t;
+		}
 	}
-	progList(1, l1, l2);
+	return(0);
 }
 
 
-static void progExecuteLOAD(void *vp) {
-	loadType *lp = (loadType *)vp;
-	char *fn;
-	if ((fn = eval(lp->fileName)) != NULL) {
-		if (ioOpenInput(fn)) {
-			utilError("couldn't load file [%s]", fn);
+static void progEmitParenthesised(symbolType *e) {
+	ioWrite("(", 1);
+	emitExpression(e, 0);
+	ioWrite(")", 1);
+}
+
+
+static void progEmitPRINT(printType *pp) {
+	symbolType *e;
+	unsigned long int i;
+	int s;
+	for (i = 0; i < pp->numExpressions; i++) {
+		e = pp->expressionList[i];
+		if (e->id == kwComma) {
+			ioPrintf("\tputchar('\\t');\n");
+		} else if (e->id != kwSemicolon) {
+			s = emitIsString(e);
+			ioPrintf("\tbasPrint%s(", s ? "S" : "N");
+			emitExpression(e, s);
+			ioPrintf(");\n");
+			if (i + 1 == pp->numExpressions || (pp->expressionList[i + 1]->id != kwComma && pp->expressionList[i + 1]->id != kwSemicolon)) {
+				ioPrintf("\tputchar('\\n');\n");
+			}
 		}
-	} else {
-		utilError("filename required");
-		return;
 	}
-	free(fn);
+	if (pp->numExpressions == 0) {
+		ioPrintf("\tputchar('\\n');\n");
+	}
 }
 
 
-static void progExecuteNEW(void *vp) {
-	progNew();
+/*
+ * Store value, a char * if string is non-zero and a double otherwise, in
+ * variable id, converting it to the type of the variable.
+ */
+static void progEmitStore(symbolType *id, const char *value, int string, const char *indent) {
+	int s = emitIsString(id);
+	emitIndices(id, indent);
+	ioPrintf("%s%s", indent, s ? "basSet(" : "");
+	emitRef(id, 0);
+	ioPrintf("%s%s%s%s%s;\n", s ? ", " : " = ", s == string ? "" : s ? "basStr(" : "basVal(", value, s == string ? "" : ")", s ? ")" : "");
 }
 
 
-static void progExecuteNEXT(void *vp) {
-	nextType *np = (nextType *)vp;
-	instructionType *ip = stackPeek(forInstructionStack);
-	forType *fp = (forType *)ip;
-	char *s;
-	double i, j, k;
-	long dim1 = 1;
-	long dim2 = 1;
-	char d[128];
-	if (fp->startPoint->l->l != NULL) {
-		s = eval(fp->startPoint->l->l);
-		dim1 = strtol(s, NULL, 10);
-		free(s);
-	}
-	if (fp->startPoint->l->r != NULL) {
-		s = eval(fp->startPoint->l->r);
-		dim2 = strtol(s, NULL, 10);
-		free(s);
+/*
+ * TRAP only checks that its line exists, since errors always stop the
+ * program.
+ */
+static void progEmitTRAP(symbolType *t) {
+	progLineType *p;
+	long int l;
+	if (t->id == kwNumeric) {
+		l = strtod(t->value, NULL);
+		if (progFindLine(l) == NULL) {
+			ioPrintf("\tbasError(\"line %%li not found\", %liL);\n", l);
+		}
+		return;
 	}
-	s = varGetValue(fp->startPoint->l->value, dim1, dim2);
-	i = strtod(s, NULL);
-	free(s);
-	s = eval(fp->endPoint);
-	j = strtod(s, NULL);
-	free(s);
-	if (fp->step != NULL) {
-		s = eval(fp->step);
-		k = strtod(s, NULL);
-		free(s);
-	} else {
-		k = 1;
+	ioPrintf("\tbasLine = (long)");
+	progEmitParenthesised(t);
+	ioPrintf(";\n\tswitch (basLine) {\n");
+	for (p = prog; p != NULL; p = p->next) {
+		ioPrintf("\t\tcase %li:\n", p->lineNum);
 	}
-	i = i + k;
-	sprintf(d, "%lf", i);
-	varSetValue(fp->startPoint->l->value, d, dim1, dim2);
-	if (i > j) {
-		if (progCurrent->currentInstruction->next) {
-			progCurrent->currentInstruction = progCurrent->currentInstruction->next;
-		} else {
-			progCurrent->currentInstruction = progCurrent->firstInstruction;
-			progCurrent = progCurrent->next;
-			if (progCurrent != NULL) {
-				progCurrent->currentInstruction = progCurrent->firstInstruction;
+	ioPrintf("\t\t\tbreak;\n\t\tdefault:\n\t\t\tbasError(\"line %%li not found\", basLine);\n\t}\n");
+}
+
+
+/*
+ * Any error reported while a statement runs stops the program, rather than
+ * carrying on from a statement that didn't do its job.
+ */
+static void progExecute(void) {
+	keywords keyword;
+	long int lineNum;
+	double t;
+	int start;
+	int errors = utilErrors;
+	while (progCurrent && progCurrent->currentInstruction) {
+		if (jitEnabled && progCurrent->currentInstruction == progCurrent->firstInstruction && progCurrent->lineNum >= 0 && progExecuteNative()) {
+			if (utilErrors != errors) {
+				progCurrent = NULL;
+				return;
 			}
+			continue;
 		}
-		stackPop(forLineStack);
-		stackPop(forInstructionStack);
-		return;
-	} else {
-		progCurrent = stackPeek(forLineStack);
-		progCurrent->currentInstruction = stackPeek(forInstructionStack);
-		if (progCurrent->currentInstruction->next != NULL) {
-			progCurrent->currentInstruction = progCurrent->currentInstruction->next;
+		keyword = progCurrent->currentInstruction->keyword;
+		progStatements++;
+		if (profEnabled) {
+			lineNum = progCurrent->lineNum;
+			start = progCurrent->currentInstruction == progCurrent->firstInstruction;
+			t = profClock();
+			progCurrent->currentInstruction->executeFunc(progCurrent->currentInstruction);
+			profRecord(lineNum, keyword, start, profClock() - t);
 		} else {
-			progCurrent = progCurrent->next;
-			if (progCurrent != NULL) {
-				progCurrent->currentInstruction = progCurrent->firstInstruction;
+			progCurrent->currentInstruction->executeFunc(progCurrent->currentInstruction);
+		}
+		if (utilErrors != errors) {
+			progCurrent = NULL;
+			return;
+		}
+		if (keyword == kwRUN || keyword == kwBYE || keyword == kwSTOP || keyword == kwEND || keyword == kwCLOAD) {
+			return;
+		}
+		if (keyword != kwGOTO && keyword != kwGOSUB && keyword != kwIF && keyword != kwRETURN && keyword != kwNEXT && keyword != kwON) {
+			if (progCurrent) {
+				if (progCurrent->currentInstruction && progCurrent->currentInstruction->next) {
+					progCurrent->currentInstruction = progCurrent->currentInstruction->next;
+				} else {
+					progCurrent = progCurrent->next;
+					if (progCurrent) {
+						progCurrent->currentInstruction = progCurrent->firstInstruction;
+					}
+				}
 			}
 		}
 	}
-err:
-	return;
 }
 
 
-static void progExecuteON(void *vp) {
-	onType *op = (onType *)vp;
-	char *expression = eval(op->expression);
-	progLineType plt;
-	long int exp;
-	if (expression == NULL) {
+static void progExecuteAssignment(void *vp) {
+	assignmentType *ap = (assignmentType *)vp;
+	valueType v = {valNumeric, 0, NULL};
+	varRefType r;
+	if (eval(ap->assignment->r, &v)) {
 		goto err;
 	}
-	exp = strtol(expression, NULL, 10);
-	if (exp < 0 || exp > 255) {
+	if (evalLvalue(ap->assignment->l, &r)) {
 		goto err;
 	}
-	if (exp > 0) {
-		if (exp <= op->numTargets) {
-			plt.next = NULL;
-			plt.firstInstruction = plt.lastInstruction = plt.currentInstruction = NULL;
-			plt.lineNum = -1;
-			if (progAppendInstruction(&plt, op->instruction->id, op->targetList[exp - 1])) {
-				goto err;
-			}
-			plt.firstInstruction->executeFunc(plt.firstInstruction);
-		}
-	}
-	if (expression != NULL) {
-		free(expression);
-	}
-	return;
+	varRefSetValue(&r, &v);
 err:
-	if (expression != NULL) {
-		free(expression);
+	valueClear(&v);
+}
+
+
+/*
+ * X = a, or X = a <op> b, where X is a plain numeric variable and a and b
+ * are operands.
+ */
+static void progExecuteAssignmentFused(void *vp) {
+	assignmentType *ap = (assignmentType *)vp;
+	double d = progOperandValue(&ap->a);
+	switch (ap->op) {
+		case kwOpAdd:
+			d += progOperandValue(&ap->b);
+			break;
+		case kwOpSub:
+			d -= progOperandValue(&ap->b);
+			break;
+		case kwOpMul:
+			d *= progOperandValue(&ap->b);
+			break;
+		case kwOpDiv:
+			d /= progOperandValue(&ap->b);
+			break;
+		default:
+			break;
 	}
-	return;
+	varSetNumeric(ap->assignment->l->slot, d, 1, 1);
 }
 
 
-static void progExecutePOP(void *vp) {
-	stackPop(callStack);
+static void progExecuteBYE(void *vp) {
 }
 
 
-static void progExecutePRINT(void *vp) {
-	printType *pp = (printType *)vp;
-	char *expression = NULL;
-	unsigned long int i;
-	char *s = malloc(maxStringLen + 1);
-	char *t = s;
-	if (s == NULL) {
-		goto err;
+/*
+ * Replace the program with the image in a file written by CSAVE. Whatever
+ * was running stops, since its lines are gone.
+ */
+static void progExecuteCLOAD(void *vp) {
+	loadType *lp = (loadType *)vp;
+	char *fn;
+	if ((fn = evalString(lp->fileName)) == NULL) {
+		utilError("filename required");
+		return;
 	}
-	s[0] = 0;
-	for (i = 0; i < pp->numExpressions; i++) {
-		if (pp->expressionList[i]->id == kwComma) {
-			if (t > s) {
-				char *u = t - 1;
-				if (*u == '\n') {
-					t--;
-				}
-			}
-			*t++ = '\t';
-		} else if (pp->expressionList[i]->id == kwSemicolon) {
-			if (t > s) {
-				char *u = t - 1;
-				if (*u == '\n') {
-					t--;
-				}
-			}
-		}
-		else {
-			if ((expression = eval(pp->expressionList[i])) == NULL) {
-				goto err;
-			}
-			strcpy(t, expression);
-			t += strlen(expression);
-			free(expression);
-			expression = NULL;
-			*t++ = '\n';
-		}
+	progLoadImage(fn);
+	progCurrent = NULL;
+	free(fn);
+}
+
+
+static void progExecuteCLR(void *vp) {
+	varClearAll();
+}
+
+
+static void progExecuteCLS(void *vp) {
+	ioFlush();
+	system("clear");
+}
+
+
+static void progExecuteCONT(void *vp) {
+	if (progStop != NULL) {
+		progCurrent = progStop;
+		progCurrent->currentInstruction = progCurrent->firstInstruction;
+		progStop = NULL;
 	}
-	if (pp->numExpressions == 0) {
-		*t++ = '\n';
+}
+
+
+static void progExecuteCSAVE(void *vp) {
+	saveType *sp = (saveType *)vp;
+	char *fn = evalString(sp->fileName);
+	if (fn == NULL) {
+		utilError("file name required");
+		return;
 	}
-	*t = 0;
-	printf(s);
-	free(s);
-err:
-	if (expression != NULL) {
-		free(expression);
+	progSaveImage(fn);
+	free(fn);
+}
+
+
+static void progExecuteDATA(void *vp) {
+	long int lineNum = -1;
+	if (progCurrent != NULL) {
+		lineNum = progCurrent->lineNum;
 	}
+	varAppendData(((dataType *)vp)->dataList, lineNum);
 }
 
 
-static void progExecuteREAD(void *vp) {
-	readType *rp = (readType *)vp;
-	char *s;
+static void progExecuteDIM(void *vp) {
+	dimType *dt = (dimType *)vp;
 	unsigned long int i;
-	long int dim1, dim2;
-	for (i = 0L; i < rp->numVars; i++) {
-		dim1 = 1;
-		dim2 = 1;
-		if (rp->varList[i]->l != NULL) {
-			s = eval(rp->varList[i]->l);
-			dim1 = strtol(s, NULL, 10);
-			free(s);
-			s = NULL;
-		}
-		if (rp->varList[i]->r != NULL) {
-			s = eval(rp->varList[i]->r);
-			dim2 = strtol(s, NULL, 10);
-			free(s);
-			s = NULL;
-		}
-		if ((s = varReadData()) == NULL) {
-			goto err;
+	long d1;
+	long d2;
+	for (i = 0UL; i < dt->numElements; i++) {
+		if (evalIndices(dt->dimList[i], &d1, &d2)) {
+			utilError("couldn't dimension variable [%s]", dt->dimList[i]->value);
+			return;
 		}
-		if (varSetValue(rp->varList[i]->value, s, dim1, dim2)) {
-			goto err;
+		if (varDim(dt->dimList[i]->slot, d1, d2)) {
+			utilError("couldn't dimension variable: %s(%li, %li)", dt->dimList[i]->value, d1, d2);
+			return;
 		}
-		free(s);
-		s = NULL;
 	}
-err:
-	if (s != NULL) {
-		free(s);
-	}
-	return;
 }
 
 
-static void progExecuteREM(void *vp) {
+static void progExecuteEND(void *vp) {
 }
 
 
-static void progExecuteRESTORE(void *vp) {
-	restoreType *rp = (restoreType *)vp;
-	long int line;
-	char *s = NULL;
-	if (rp->targetLine != NULL) {
-		if ((s = eval(rp->targetLine)) != 0) {
+/*
+ * The limit and step are evaluated once, when the loop starts. Starting a
+ * loop on a variable that already has one discards that loop and any loops
+ * inside it.
+ */
+static void progExecuteFOR(void *vp) {
+	forType *fp = (forType *)vp;
+	controlFrameType *f;
+	valueType v = {valNumeric, 0, NULL};
+	varRefType r;
+	double limit;
+	double step = 1;
+	long dim1;
+	long dim2;
+	long int i;
+	if (eval(fp->startPoint->r, &v)) {
+		goto err;
+	}
+	if (evalIndices(fp->startPoint->l, &dim1, &dim2)) {
+		goto err;
+	}
+	if (evalNumeric(fp->endPoint, &limit)) {
+		goto err;
+	}
+	if (fp->step != NULL) {
+		if (evalNumeric(fp->step, &step)) {
 			goto err;
 		}
-		line = strtol(s, NULL, 10);
-	} else {
-		line = -1;
 	}
-	varRestoreData(line);
-err:
-	if (s != NULL) {
-		free(s);
+	if (varRef(fp->startPoint->l->slot, dim1, dim2, &r) || varRefSetValue(&r, &v)) {
+		goto err;
 	}
-	return;
+	if ((i = progControlFindFOR(fp->startPoint->l->slot)) >= 0) {
+		controlStackLen = i;
+	}
+	if ((f = progControlPush(kwFOR)) == NULL) {
+		goto err;
+	}
+	f->slot = fp->startPoint->l->slot;
+	f->dim1 = dim1;
+	f->dim2 = dim2;
+	f->limit = limit;
+	f->step = step;
+err:
+	valueClear(&v);
 }
 
 
-static void progExecuteRETURN(void *vp) {
+static void progExecuteGOSUB(void *vp) {
+	gosubType *gp = (gosubType *)vp;
 	progLineType *p;
-	p = stackPeek(callStack);
-	stackPop(callStack);
-	if (p == NULL) {
-		return;
-	}
-	progCurrent = p;
-	if (progCurrent) {
+	if ((p = progResolveTarget(gp->targetLine, &gp->target)) != NULL) {
+		if (progControlPush(kwGOSUB) == NULL) {
+			return;
+		}
+		progCurrent = p;
 		progCurrent->currentInstruction = progCurrent->firstInstruction;
 	}
 }
 
 
-static void progExecuteRUN(void *vp) {
-	varClearAll();
-	stackClear(forLineStack);
-	stackClear(forInstructionStack);
-	stackClear(callStack);
-	progStop = NULL;
-	progCurrent = prog;
-	while (progCurrent) {
-		progCurrent->currentInstruction = progCurrent->firstInstruction;
-		while (progCurrent->currentInstruction) {
-			if (progCurrent->currentInstruction->keyword == kwDATA) {
-				progCurrent->currentInstruction->executeFunc(progCurrent->currentInstruction);
-			}
-			progCurrent->currentInstruction = progCurrent->currentInstruction->next;
-		}
+static void progExecuteGOTO(void *vp) {
+	gotoType *gp = (gotoType *)vp;
+	progLineType *p;
+	if ((p = progResolveTarget(gp->targetLine, &gp->target)) != NULL) {
+		progCurrent = p;
 		progCurrent->currentInstruction = progCurrent->firstInstruction;
-		progCurrent = progCurrent->next;
 	}
-	progCurrent = prog;
-	progExecute();
 }
 
 
-static void progExecuteSAVE(void *vp) {
-	saveType *sp = (saveType *)vp;
-	char *fn = eval(sp->fileName);
-	int fh = -1;
-	if (fn == NULL) {
-		utilError("file name required");
-		goto err;
-	}
-	if ((fh = open(fn, O_WRONLY | O_TRUNC | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)) == -1) {
-		utilError("unable to create output file [%s]", fn);
+static void progExecuteIF(void *vp) {
+	ifType *ip = (ifType *)vp;
+	progLineType *p;
+	double d;
+	if (evalNumeric(ip->expression, &d)) {
 		goto err;
 	}
-	progList(fh, -1, -1);
-	close(fh);
-	free(fn);
-	fh = -1;
-	return;
-err:
-	if (fn != NULL) {
-		free(fn);
+	if (d != 0) {
+		if (ip->isGoto) {
+			if ((p = progResolveTarget(ip->gotoOrInstructions, &ip->target)) == NULL) {
+				goto err;
+			}
+			progCurrent = p;
+			progCurrent->currentInstruction = progCurrent->firstInstruction;
+			return;
+		} else {
+			progCurrent->currentInstruction = ip->gotoOrInstructions;
+			return;
+		}
 	}
-	if (fh != -1) {
-		close(fh);
+	progCurrent = progCurrent->next;
+	if (progCurrent) {
+		progCurrent->currentInstruction = progCurrent->firstInstruction;
 	}
+err:
 	return;
 }
 
 
-static void progExecuteSTOP(void *vp) {
-	progStop = progCurrent->next;
-}
-
-
-static void progExecuteTRAP(void *vp) {
-	trapType *tp = (trapType *)vp;
-	if (tp->targetLine == NULL) {
-		utilError("expected expression");
-		goto err;
+/*
+ * IF a <cmp> b THEN line, where a and b are operands.
+ */
+static void progExecuteIFCompare(void *vp) {
+	ifType *ip = (ifType *)vp;
+	progLineType *p;
+	double l = progOperandValue(&ip->l);
+	double r = progOperandValue(&ip->r);
+	int c;
+	switch (ip->expression->id) {
+		case kwLogicalLT:
+			c = l < r;
+			break;
+		case kwLogicalLTE:
+			c = l <= r;
+			break;
+		case kwLogicalEQ:
+			c = l == r;
+			break;
+		case kwLogicalNE:
+			c = l != r;
+			break;
+		case kwLogicalGT:
+			c = l > r;
+			break;
+		default:
+			c = l >= r;
+			break;
 	}
-	char *s = eval(tp->targetLine);
-	if (s == NULL) {
-		utilError("couldn't evaluate expression");
-		goto err;
+	if (c) {
+		if ((p = progResolveTarget(ip->gotoOrInstructions, &ip->target)) != NULL) {
+			progCurrent = p;
+			progCurrent->currentInstruction = progCurrent->firstInstruction;
+		}
+		return;
 	}
-	unsigned long int l = strtol(s, NULL, 10);
-	free(s);
-	progLineType *p = prog;
-	while (p && p->lineNum != l) {
-		p = p->next;
+	progCurrent = progCurrent->next;
+	if (progCurrent) {
+		progCurrent->currentInstruction = progCurrent->firstInstruction;
 	}
-	if (p && p->lineNum == l) {
-		progTrap = p;
-		return;
+}
+
+
+static void progExecuteINPUT(void *vp) {
+	inputType *ip = (inputType *)vp;
+	valueType v = {valNumeric, 0, NULL};
+	char *l;
+	char *t;
+	varRefType r;
+	unsigned long int i;
+	for (i = 0L; i < ip->numVars; i++) {
+		if ((l = ioReadLine()) == NULL) {
+			goto err;
+		}
+		if (evalLvalue(ip->varList[i], &r)) {
+			goto err;
+		}
+		if ((t = valueStringNew(l)) == NULL) {
+			goto err;
+		}
+		valueSetStringRef(&v, t);
+		if (varRefSetValue(&r, &v)) {
+			goto err;
+		}
 	}
-	utilError("line %l not found", l);
 err:
+	valueClear(&v);
 	return;
 }
 
 
-static void progExit(void) {
-	progNew();
+static void progExecuteLET(void *vp) {
+	letType *lp = (letType *)vp;
+	valueType v = {valNumeric, 0, NULL};
+	varRefType r;
+	if (eval(lp->assignment->r, &v)) {
+		goto err;
+	}
+	if (evalLvalue(lp->assignment->l, &r)) {
+		goto err;
+	}
+	varRefSetValue(&r, &v);
+err:
+	valueClear(&v);
 }
 
 
-static char *progFormatAssignment(void *vp) {
-	assignmentType *ap = (assignmentType *)vp;
-	char *s;
-	if (ap == NULL || ap->assignment == NULL) {
-		return(NULL);
+/*
+ * Run line p, which may be an immediate line that isn't part of the program.
+ * Frames pushed by an immediate line would be left pointing at it once it is
+ * freed, so they are dropped when it finishes.
+ */
+void progExecuteLine(progLineType *p) {
+	long int i;
+	long int j = 0;
+	progCurrent = p;
+	if (progCurrent) {
+		progCurrent->currentInstruction = progCurrent->firstInstruction;
 	}
-	if ((s = evalCode(ap->assignment)) == NULL) {
-		return(NULL);
+	progExecute();
+	if (p != NULL && p->lineNum < 0) {
+		for (i = 0; i < controlStackLen; i++) {
+			if (controlStack[i].line != p) {
+				controlStack[j++] = controlStack[i];
+			}
+		}
+		controlStackLen = j;
 	}
-	return(s);
 }
 
 
-static char *progFormatDATA(void *vp) {
-	char *l = strmergez((const char **)((dataType *)vp)->dataList, ",");
-	char *s = malloc(strlen(l) + 6);
-	if (s == NULL) {
+static void progExecuteLIST(void *vp) {
+	listType *lp = (listType *)vp;
+	double d;
+	long int l1 = -1;
+	long int l2 = -1;
+	if (lp->startLine != NULL) {
+		if (evalNumeric(lp->startLine, &d)) {
+			return;
+		}
+		l1 = d;
+	}
+	if (lp->endLine != NULL) {
+		if (evalNumeric(lp->endLine, &d)) {
+			return;
+		}
+		l2 = d;
+	}
+	progList(l1, l2);
+}
+
+
+static void progExecuteLOAD(void *vp) {
+	loadType *lp = (loadType *)vp;
+	char *fn;
+	if ((fn = evalString(lp->fileName)) != NULL) {
+		if (ioOpenInput(fn)) {
+			utilError("couldn't load file [%s]", fn);
+		}
+	} else {
+		utilError("filename required");
+		return;
+	}
+	free(fn);
+}
+
+
+/*
+ * Run the native code for the line about to start, compiling it once the
+ * line has been started JIT_THRESHOLD times. No native code is running
+ * here, so if the program has been edited all of it can be thrown away.
+ *
+ * Returns
+ *
+ *	0 = there is no native code, so the line has to be interpreted
+ *	1 = the code ran, and progCurrent is where the program carries on
+ */
+static int progExecuteNative(void) {
+	progLineType *p = progCurrent;
+	progNativeType *n;
+	instructionType *i;
+	long int rc;
+	if (progJitEdits != progEdits) {
+		progJitReset();
+	}
+	if ((n = p->native) == NULL) {
+		if (++p->runs != JIT_THRESHOLD || (n = p->native = progJitCompile(p)) == NULL) {
+			return(0);
+		}
+	}
+	if ((rc = n->func()) < 0) {
+		progCurrent = NULL;
+		return(1);
+	}
+	if (rc == 0) {
+		progCurrent = n->last->next;
+	} else {
+		i = n->jumps[rc - 1];
+		if (i->keyword == kwGOTO) {
+			progCurrent = progResolveTarget(((gotoType *)i)->targetLine, &((gotoType *)i)->target);
+		} else {
+			progCurrent = progResolveTarget(((ifType *)i)->gotoOrInstructions, &((ifType *)i)->target);
+		}
+	}
+	if (progCurrent != NULL) {
+		progCurrent->currentInstruction = progCurrent->firstInstruction;
+	}
+	return(1);
+}
+
+
+static void progExecuteNEW(void *vp) {
+	progNew();
+}
+
+
+static void progExecuteNEXT(void *vp) {
+	nextType *np = (nextType *)vp;
+	controlFrameType *f;
+	double d;
+	long int i;
+	if ((i = progControlFindFOR(np->iteratorVar->slot)) < 0) {
+		utilError("NEXT without FOR");
+		progCurrent = NULL;
+		return;
+	}
+	controlStackLen = i + 1;
+	f = &controlStack[i];
+	if (varGetNumeric(f->slot, f->dim1, f->dim2, &d)) {
+		progCurrent = NULL;
+		return;
+	}
+	d += f->step;
+	if (varSetNumeric(f->slot, d, f->dim1, f->dim2)) {
+		progCurrent = NULL;
+		return;
+	}
+	if (f->step < 0 ? d < f->limit : d > f->limit) {
+		controlStackLen--;
+		progContinueAfter(progCurrent, progCurrent->currentInstruction);
+	} else {
+		progContinueAfter(f->line, f->ins);
+	}
+}
+
+
+/*
+ * NEXT for a FOR earlier on the same line. When that loop is the innermost
+ * one, as it almost always is, its frame is on top of the stack and looping
+ * stays on this line.
+ */
+static void progExecuteNEXTLocal(void *vp) {
+	nextType *np = (nextType *)vp;
+	controlFrameType *f;
+	double d;
+	if (controlStackLen == 0 || controlStack[controlStackLen - 1].ins != np->forIns) {
+		progExecuteNEXT(vp);
+		return;
+	}
+	f = &controlStack[controlStackLen - 1];
+	if (varGetNumeric(f->slot, 1, 1, &d)) {
+		progCurrent = NULL;
+		return;
+	}
+	d += f->step;
+	if (varSetNumeric(f->slot, d, 1, 1)) {
+		progCurrent = NULL;
+		return;
+	}
+	if (f->step < 0 ? d < f->limit : d > f->limit) {
+		controlStackLen--;
+		progContinueAfter(progCurrent, progCurrent->currentInstruction);
+	} else {
+		progCurrent->currentInstruction = np->forIns->next;
+	}
+}
+
+
+/*
+ * A selector outside the table, including 0, carries on with the next
+ * statement, as Atari BASIC does.
+ */
+static void progExecuteON(void *vp) {
+	onType *op = (onType *)vp;
+	progLineType *p;
+	double d;
+	long int n;
+	if (evalNumeric(op->expression, &d)) {
+		return;
+	}
+	n = d;
+	if (n < 1 || n > op->numTargets) {
+		progContinueAfter(progCurrent, progCurrent->currentInstruction);
+		return;
+	}
+	if ((p = progResolveTarget(op->targetList[n - 1], &op->targets[n - 1])) == NULL) {
+		return;
+	}
+	if (op->instruction->id == kwGOSUB && progControlPush(kwGOSUB) == NULL) {
+		return;
+	}
+	progCurrent = p;
+	progCurrent->currentInstruction = progCurrent->firstInstruction;
+}
+
+
+/*
+ * Drop the innermost GOSUB or FOR, as Atari BASIC does.
+ */
+static void progExecutePOP(void *vp) {
+	if (controlStackLen > 0) {
+		controlStackLen--;
+	}
+}
+
+
+/*
+ * Each expression is followed by a newline unless a comma (which writes a
+ * tab) or a semicolon comes after it.
+ */
+static void progExecutePRINT(void *vp) {
+	printType *pp = (printType *)vp;
+	valueType v = {valNumeric, 0, NULL};
+	char b[VALUE_NUMERIC_LEN];
+	symbolType *e;
+	unsigned long int i;
+	for (i = 0; i < pp->numExpressions; i++) {
+		e = pp->expressionList[i];
+		if (e->id == kwComma) {
+			ioWrite("\t", 1);
+		} else if (e->id != kwSemicolon) {
+			if (eval(e, &v)) {
+				goto err;
+			}
+			if (v.type == valString) {
+				ioWrite(v.s, valueStringLength(v.s));
+			} else {
+				valueFormatNumeric(v.n, b);
+				ioWrite(b, strlen(b));
+			}
+			if (i + 1 == pp->numExpressions || (pp->expressionList[i + 1]->id != kwComma && pp->expressionList[i + 1]->id != kwSemicolon)) {
+				ioWrite("\n", 1);
+			}
+		}
+	}
+	if (pp->numExpressions == 0) {
+		ioWrite("\n", 1);
+	}
+err:
+	valueClear(&v);
+}
+
+
+static void progExecuteREAD(void *vp) {
+	readType *rp = (readType *)vp;
+	valueType v = {valNumeric, 0, NULL};
+	char *s = NULL;
+	unsigned long int i;
+	varRefType r;
+	for (i = 0L; i < rp->numVars; i++) {
+		if (evalLvalue(rp->varList[i], &r)) {
+			goto err;
+		}
+		if (r.num != NULL) {
+			if (varReadNumeric(r.num)) {
+				goto err;
+			}
+			continue;
+		}
+		if ((s = varReadData()) == NULL) {
+			goto err;
+		}
+		if (valueSetString(&v, s)) {
+			goto err;
+		}
+		if (varRefSetValue(&r, &v)) {
+			goto err;
+		}
+		free(s);
+		s = NULL;
+	}
+err:
+	valueClear(&v);
+	if (s != NULL) {
+		free(s);
+	}
+	return;
+}
+
+
+/*
+ * READ of a single numeric variable whose subscripts, if any, are operands.
+ */
+static void progExecuteREADNumeric(void *vp) {
+	readType *rp = (readType *)vp;
+	long int dim1 = 1;
+	long int dim2 = 1;
+	varRefType r;
+	if (rp->varList[0]->l != NULL) {
+		dim1 = progOperandValue(&rp->dim1);
+	}
+	if (rp->varList[0]->r != NULL) {
+		dim2 = progOperandValue(&rp->dim2);
+	}
+	if (varRef(rp->varList[0]->slot, dim1, dim2, &r) == 0) {
+		varReadNumeric(r.num);
+	}
+}
+
+
+static void progExecuteREM(void *vp) {
+}
+
+
+static void progExecuteRESTORE(void *vp) {
+	restoreType *rp = (restoreType *)vp;
+	long int line;
+	double d;
+	if (rp->targetLine != NULL) {
+		if (evalNumeric(rp->targetLine, &d)) {
+			return;
+		}
+		line = d;
+	} else {
+		line = -1;
+	}
+	varRestoreData(line);
+}
+
+
+/*
+ * Continue after the GOSUB that called the subroutine, dropping any FOR
+ * loops the subroutine left open.
+ */
+static void progExecuteRETURN(void *vp) {
+	while (controlStackLen > 0 && controlStack[controlStackLen - 1].kind != kwGOSUB) {
+		controlStackLen--;
+	}
+	if (controlStackLen == 0) {
+		utilError("RETURN without GOSUB");
+		progCurrent = NULL;
+		return;
+	}
+	controlStackLen--;
+	progContinueAfter(controlStack[controlStackLen].line, controlStack[controlStackLen].ins);
+}
+
+
+static void progExecuteRUN(void *vp) {
+	progRun();
+}
+
+
+static void progExecuteSAVE(void *vp) {
+	saveType *sp = (saveType *)vp;
+	char *fn = evalString(sp->fileName);
+	if (fn == NULL) {
+		utilError("file name required");
+		return;
+	}
+	if (ioOpenOutput(fn)) {
+		utilError("unable to create output file [%s]", fn);
+		free(fn);
+		return;
+	}
+	progList(-1, -1);
+	if (ioCloseOutput()) {
+		utilError("unable to write output file [%s]", fn);
+	}
+	free(fn);
+}
+
+
+static void progExecuteSTOP(void *vp) {
+	progStop = progCurrent->next;
+}
+
+
+static void progExecuteTRAP(void *vp) {
+	trapType *tp = (trapType *)vp;
+	progLineType *p;
+	if ((p = progResolveTarget(tp->targetLine, &tp->target)) != NULL) {
+		progTrap = p;
+	}
+}
+
+
+static progLineType *progFindLine(long int l) {
+	unsigned long int i = progIndexFind(l);
+	if (i < progIndexLen && progIndex[i]->lineNum == l) {
+		return(progIndex[i]);
+	}
+	return(NULL);
+}
+
+
+static char *progFormatAssignment(void *vp) {
+	assignmentType *ap = (assignmentType *)vp;
+	char *s;
+	if (ap == NULL || ap->assignment == NULL) {
+		return(NULL);
+	}
+	if ((s = evalCode(ap->assignment)) == NULL) {
+		return(NULL);
+	}
+	return(s);
+}
+
+
+static char *progFormatDATA(void *vp) {
+	char *l = strmergez((const char **)((dataType *)vp)->dataList, ",");
+	char *s = malloc(strlen(l) + 6);
+	if (s == NULL) {
 		free(l);
 		return(NULL);
 	}
@@ -1413,8 +2508,12 @@ static char *progFormatDIM(void *vp) {
 	strcat(s, " ");
 	for (i = 0; i < dt->numElements; i++) {
 		sLen += strlen(dt->dimList[i]->value) + 4;
-		l = eval(dt->dimList[i]->l);
-		r = eval(dt->dimList[i]->r);
+		if (dt->dimList[i]->l != NULL) {
+			l = evalCode(dt->dimList[i]->l);
+		}
+		if (dt->dimList[i]->r != NULL) {
+			r = evalCode(dt->dimList[i]->r);
+		}
 		if (l != NULL) {
 			sLen += strlen(l);
 		}
@@ -1753,11 +2852,11 @@ static char *progFormatLOAD(void *vp) {
 	if ((fn = evalCode(lt->fileName)) == NULL) {
 		goto err;
 	}
-	if ((s = malloc(strlen(fn) + strlen(scanGetKeyword(kwLOAD)) + 2)) == NULL) {
+	if ((s = malloc(strlen(fn) + strlen(scanGetKeyword(lt->ins.keyword)) + 2)) == NULL) {
 		utilError(memErr);
 		goto err;
 	}
-	strcpy(s, scanGetKeyword(kwLOAD));
+	strcpy(s, scanGetKeyword(lt->ins.keyword));
 	strcat(s, " ");
 	strcat(s, fn);
 	free(fn);
@@ -2003,11 +3102,11 @@ static char *progFormatSAVE(void *vp) {
 	if ((fn = evalCode(st->fileName)) == NULL) {
 		goto err;
 	}
-	if ((s = malloc(strlen(fn) + strlen(scanGetKeyword(kwSAVE)) + 2)) == NULL) {
+	if ((s = malloc(strlen(fn) + strlen(scanGetKeyword(st->ins.keyword)) + 2)) == NULL) {
 		utilError(memErr);
 		goto err;
 	}
-	strcpy(s, scanGetKeyword(kwSAVE));
+	strcpy(s, scanGetKeyword(st->ins.keyword));
 	strcat(s, " ");
 	strcat(s, fn);
 	free(fn);
@@ -2016,408 +3115,1227 @@ err:
 	if (fn != NULL) {
 		free(fn);
 	}
-	if (s != NULL) {
-		free(s);
+	if (s != NULL) {
+		free(s);
+	}
+	return(NULL);
+}
+
+
+static char *progFormatTRAP(void *vp) {
+	trapType *tt = (trapType *)vp;
+	char *t = NULL;
+	char *s = NULL;
+	if (tt->targetLine != NULL) {
+		if ((t = evalCode(tt->targetLine)) == NULL) {
+			goto err;
+		}
+		if ((s = malloc(strlen(scanGetKeyword(kwTRAP)) + strlen(t) + 2)) == NULL) {
+			utilError(memErr);
+			goto err;
+		}
+		strcpy(s, scanGetKeyword(kwTRAP));
+		strcat(s, " ");
+		strcat(s, t);
+		free(t);
+		t = NULL;
+	}
+	return(s);
+err:
+	if (s != NULL) {
+		free(s);
+	}
+	if (t != NULL) {
+		free(t);
+	}
+	return(NULL);
+}
+
+
+static void progFreeDATA(void *vp) {
+	dataType *dp = (dataType *)vp;
+	if (dp->dataList != NULL) {
+		free(dp->dataList);
+	}
+}
+
+
+/*
+ * Instructions and the expressions they hold live in their line's arena, so
+ * only memory an instruction owns outside it needs releasing here.
+ */
+static void progFreeDefault(void *vp) {
+}
+
+
+static void progFreeDIM(void *vp) {
+	dimType *dp = (dimType *)vp;
+	if (dp->dimList != NULL) {
+		free(dp->dimList);
+	}
+}
+
+
+static void progFreeIF(void *vp) {
+	ifType *ip = (ifType *)vp;
+	if (!ip->isGoto) {
+		progDeleteInstructions((instructionType *)ip->gotoOrInstructions);
+	}
+}
+
+
+static void progFreeINPUT(void *vp) {
+	inputType *ip = (inputType *)vp;
+	if (ip->varList != NULL) {
+		free(ip->varList);
+	}
+}
+
+
+static void progFreeON(void *vp) {
+	onType *op = (onType *)vp;
+	if (op->targetList != NULL) {
+		free(op->targetList);
+	}
+}
+
+
+static void progFreePRINT(void *vp) {
+	printType *pp = (printType *)vp;
+	if (pp->expressionList != NULL) {
+		free(pp->expressionList);
+	}
+}
+
+
+static void progFreeREAD(void *vp) {
+	readType *rp = (readType *)vp;
+	if (rp->varList != NULL) {
+		free(rp->varList);
+	}
+}
+
+
+static void progFreeREM(void *vp) {
+	remType *rp = (remType *)vp;
+	if (rp->remark != NULL) {
+		free(rp->remark);
+	}
+}
+
+
+/*
+ * Check that symbol s, read from the image along with its subtrees, has the
+ * value and the operands its kind needs, so that nothing compiling, running
+ * or listing it finds a hole the parser would never have left.
+ *
+ * Returns
+ *
+ *	0 = s is well formed
+ *	1 = s is corrupt
+ */
+static int progImageCheckSymbol(const symbolType *s) {
+	switch (s->id) {
+		case kwIdentifier:
+			return(s->value == NULL || *s->value == 0 || (s->l == NULL && s->r != NULL));
+		case kwNumeric:
+		case kwString:
+			return(s->value == NULL);
+		case kwAssignment:
+			return(s->l == NULL || s->l->id != kwIdentifier || s->r == NULL);
+		case kwOpAdd:
+		case kwOpSub:
+		case kwOpMul:
+		case kwOpDiv:
+		case kwOpExp:
+		case kwLogicalLT:
+		case kwLogicalLTE:
+		case kwLogicalEQ:
+		case kwLogicalNE:
+		case kwLogicalGT:
+		case kwLogicalGTE:
+		case kwOR:
+		case kwAND:
+			return(s->l == NULL || s->r == NULL);
+		case kwNOT:
+		case kwSignPlus:
+		case kwSignMinus:
+		case kwSubExpression:
+			return(s->r == NULL);
+		case kwABS:
+		case kwASC:
+		case kwATN:
+		case kwCLOG:
+		case kwCOS:
+		case kwEXP:
+		case kwINT:
+		case kwLEN:
+		case kwLOG:
+		case kwRND:
+		case kwSGN:
+		case kwSIN:
+		case kwSQR:
+		case kwVAL:
+		case kwCHR:
+		case kwSTR:
+			return(s->l == NULL);
+		default:
+			return(0);
+	}
+}
+
+
+/*
+ * Check that the n symbols of an INPUT, READ or DIM list are variables, and
+ * for DIM that each has a size.
+ */
+static int progImageCheckVariables(symbolType **a, unsigned long int n, int dim) {
+	unsigned long int i;
+	for (i = 0; i < n; i++) {
+		if (a[i]->id != kwIdentifier || (dim && a[i]->l == NULL)) {
+			return(1);
+		}
+	}
+	return(0);
+}
+
+
+/*
+ * Read the instructions of a line from the image into p, up to the marker
+ * that ends them. Each is rebuilt through progAppendInstruction, so it is
+ * compiled and specialised just as if it had been parsed, once it has been
+ * checked to have every operand the parser would have required of it.
+ */
+static int progImageGetInstructions(progLineType *p) {
+	progLineType ip;
+	symbolType **a = NULL;
+	symbolType *e1 = NULL;
+	symbolType *e2 = NULL;
+	symbolType *e3 = NULL;
+	const char *t;
+	char **d = NULL;
+	char *r = NULL;
+	unsigned long int k;
+	unsigned long int n;
+	int rc;
+	while (1) {
+		if (progImageGetLong(&k)) {
+			goto err;
+		}
+		if (k == IMAGE_NULL) {
+			break;
+		}
+		switch (k) {
+			case kwBYE:
+			case kwCLR:
+			case kwCLS:
+			case kwCONT:
+			case kwEND:
+			case kwNEW:
+			case kwPOP:
+			case kwRETURN:
+			case kwRUN:
+			case kwSTOP:
+				rc = progAppendInstruction(p, k, NULL);
+				break;
+			case kwAssignment:
+			case kwLET:
+				if (progImageGetSymbol(p->arena, &e1)) {
+					goto err;
+				}
+				if (e1 == NULL || e1->id != kwAssignment) {
+					utilError(imageErr);
+					goto err;
+				}
+				rc = progAppendInstruction(p, k, e1);
+				break;
+			case kwCLOAD:
+			case kwCSAVE:
+			case kwGOSUB:
+			case kwGOTO:
+			case kwLOAD:
+			case kwSAVE:
+			case kwTRAP:
+				if (progImageGetSymbol(p->arena, &e1)) {
+					goto err;
+				}
+				if (e1 == NULL) {
+					utilError(imageErr);
+					goto err;
+				}
+				rc = progAppendInstruction(p, k, e1);
+				break;
+			case kwNEXT:
+				if (progImageGetSymbol(p->arena, &e1)) {
+					goto err;
+				}
+				if (e1 == NULL || e1->id != kwIdentifier) {
+					utilError(imageErr);
+					goto err;
+				}
+				rc = progAppendInstruction(p, k, e1);
+				break;
+			case kwRESTORE:
+				if (progImageGetSymbol(p->arena, &e1)) {
+					goto err;
+				}
+				rc = progAppendInstruction(p, k, e1);
+				break;
+			case kwDATA:
+				if (progImageGetString(&t)) {
+					goto err;
+				}
+				if (t == NULL) {
+					utilError(imageErr);
+					goto err;
+				}
+				if ((d = strsplitz(t, ",")) == NULL) {
+					utilError(memErr);
+					goto err;
+				}
+				if ((rc = progAppendInstruction(p, k, d)) == 0) {
+					d = NULL;
+				}
+				break;
+			case kwDIM:
+			case kwINPUT:
+			case kwPRINT:
+			case kwREAD:
+				if (progImageGetSymbols(p->arena, &a, &n)) {
+					goto err;
+				}
+				if (k != kwPRINT && progImageCheckVariables(a, n, k == kwDIM)) {
+					utilError(imageErr);
+					goto err;
+				}
+				if ((rc = progAppendInstruction(p, k, a, n)) == 0) {
+					a = NULL;
+				}
+				break;
+			case kwFOR:
+				if (progImageGetSymbol(p->arena, &e1) || progImageGetSymbol(p->arena, &e2) || progImageGetSymbol(p->arena, &e3)) {
+					goto err;
+				}
+				if (e1 == NULL || e1->id != kwAssignment || e2 == NULL) {
+					utilError(imageErr);
+					goto err;
+				}
+				rc = progAppendInstruction(p, k, e1, e2, e3);
+				break;
+			case kwIF:
+				if (progImageGetSymbol(p->arena, &e1) || progImageGetLong(&n)) {
+					goto err;
+				}
+				if (e1 == NULL) {
+					utilError(imageErr);
+					goto err;
+				}
+				if (n) {
+					if (progImageGetSymbol(p->arena, &e2)) {
+						goto err;
+					}
+					if (e2 == NULL) {
+						utilError(imageErr);
+						goto err;
+					}
+					rc = progAppendInstruction(p, k, e1, e2, 1);
+					break;
+				}
+				if (imageDepth == IMAGE_DEPTH_MAX) {
+					utilError(imageErr);
+					goto err;
+				}
+				memset(&ip, 0, sizeof(progLineType));
+				ip.arena = p->arena;
+				imageDepth++;
+				rc = progImageGetInstructions(&ip);
+				imageDepth--;
+				if (rc) {
+					progDeleteInstructions(ip.firstInstruction);
+					goto err;
+				}
+				if ((rc = progAppendInstruction(p, k, e1, ip.firstInstruction, 0)) != 0) {
+					progDeleteInstructions(ip.firstInstruction);
+				}
+				break;
+			case kwLIST:
+				if (progImageGetSymbol(p->arena, &e1) || progImageGetSymbol(p->arena, &e2)) {
+					goto err;
+				}
+				rc = progAppendInstruction(p, k, e1, e2);
+				break;
+			case kwON:
+				if (progImageGetSymbol(p->arena, &e1) || progImageGetSymbol(p->arena, &e2) || progImageGetSymbols(p->arena, &a, &n)) {
+					goto err;
+				}
+				if (e1 == NULL || e2 == NULL || (e2->id != kwGOTO && e2->id != kwGOSUB) || n == 0) {
+					utilError(imageErr);
+					goto err;
+				}
+				if ((rc = progAppendInstruction(p, k, e1, e2, a, n)) == 0) {
+					a = NULL;
+				}
+				break;
+			case kwREM:
+				if (progImageGetString(&t)) {
+					goto err;
+				}
+				if ((r = strdup(t != NULL ? t : "")) == NULL) {
+					utilError(memErr);
+					goto err;
+				}
+				if ((rc = progAppendInstruction(p, k, r)) == 0) {
+					r = NULL;
+				}
+				break;
+			default:
+				utilError(imageErr);
+				goto err;
+		}
+		if (rc) {
+			goto err;
+		}
+	}
+	return(0);
+err:
+	if (a != NULL) {
+		free(a);
+	}
+	if (d != NULL) {
+		free(d);
+	}
+	if (r != NULL) {
+		free(r);
+	}
+	return(1);
+}
+
+
+/*
+ * Read a number written by progImagePutLong.
+ */
+static int progImageGetLong(unsigned long int *l) {
+	unsigned long int v = 0;
+	int shift = 0;
+	while (1) {
+		if (imagePos == imageEnd || shift >= sizeof(unsigned long int) * 8) {
+			utilError(imageErr);
+			return(1);
+		}
+		v |= (unsigned long int)(*imagePos & 0x7f) << shift;
+		shift += 7;
+		if (!(*imagePos++ & 0x80)) {
+			break;
+		}
+	}
+	*l = v - 1;
+	return(0);
+}
+
+
+/*
+ * Point s at the next string in the image, which stays mapped while the
+ * image is read. A NULL string was saved as IMAGE_NULL.
+ */
+static int progImageGetString(const char **s) {
+	unsigned long int len;
+	if (progImageGetLong(&len)) {
+		return(1);
+	}
+	if (len == IMAGE_NULL) {
+		*s = NULL;
+		return(0);
+	}
+	if (imageEnd - imagePos <= len || imagePos[len] != 0) {
+		utilError(imageErr);
+		return(1);
+	}
+	*s = imagePos;
+	imagePos += len + 1;
+	return(0);
+}
+
+
+/*
+ * Rebuild a symbol tree saved by progImagePutSymbol in arena a. Identifiers
+ * are bound to their variables again, as the parser does. Trees nest no
+ * deeper than IMAGE_DEPTH_MAX, so a corrupt image can't exhaust the stack.
+ */
+static int progImageGetSymbol(arenaType *a, symbolType **s) {
+	unsigned long int id;
+	unsigned long int len;
+	const char *v;
+	int rc;
+	*s = NULL;
+	if (progImageGetLong(&id)) {
+		return(1);
+	}
+	if (id == IMAGE_NULL) {
+		return(0);
+	}
+	if (id > kwSubExpression || imageDepth == IMAGE_DEPTH_MAX) {
+		utilError(imageErr);
+		return(1);
+	}
+	if (progImageGetString(&v)) {
+		return(1);
+	}
+	len = v != NULL ? strlen(v) + 1 : 0;
+	if ((*s = arenaAlloc(a, sizeof(symbolType) + len)) == NULL) {
+		utilError(memErr);
+		return(1);
+	}
+	(*s)->id = id;
+	(*s)->slot = -1;
+	(*s)->code = NULL;
+	(*s)->value = NULL;
+	if (v != NULL) {
+		(*s)->value = (char *)*s + sizeof(symbolType);
+		memcpy((*s)->value, v, len);
+	}
+	imageDepth++;
+	rc = progImageGetSymbol(a, &(*s)->l) || progImageGetSymbol(a, &(*s)->r);
+	imageDepth--;
+	if (rc) {
+		return(1);
+	}
+	if (progImageCheckSymbol(*s)) {
+		utilError(imageErr);
+		return(1);
 	}
-	return(NULL);
+	if (id == kwIdentifier && ((*s)->slot = varLookup(v)) < 0) {
+		return(1);
+	}
+	return(0);
 }
 
 
-static char *progFormatTRAP(void *vp) {
-	trapType *tt = (trapType *)vp;
-	char *t = NULL;
-	char *s = NULL;
-	if (tt->targetLine != NULL) {
-		if ((t = evalCode(tt->targetLine)) == NULL) {
+/*
+ * Read a list of symbols into a new array, which the caller frees. Lists
+ * never hold a missing symbol.
+ */
+static int progImageGetSymbols(arenaType *a, symbolType ***s, unsigned long int *n) {
+	unsigned long int i;
+	*s = NULL;
+	if (progImageGetLong(n)) {
+		return(1);
+	}
+	if (*n > imageEnd - imagePos) {
+		utilError(imageErr);
+		return(1);
+	}
+	if ((*s = malloc(sizeof(symbolType *) * (*n ? *n : 1))) == NULL) {
+		utilError(memErr);
+		return(1);
+	}
+	for (i = 0; i < *n; i++) {
+		if (progImageGetSymbol(a, &(*s)[i])) {
 			goto err;
 		}
-		if ((s = malloc(strlen(scanGetKeyword(kwTRAP)) + strlen(t) + 2)) == NULL) {
-			utilError(memErr);
+		if ((*s)[i] == NULL) {
+			utilError(imageErr);
 			goto err;
 		}
-		strcpy(s, scanGetKeyword(kwTRAP));
-		strcat(s, " ");
-		strcat(s, t);
-		free(t);
-		t = NULL;
 	}
-	return(s);
+	return(0);
 err:
-	if (s != NULL) {
-		free(s);
-	}
-	if (t != NULL) {
-		free(t);
-	}
-	return(NULL);
+	free(*s);
+	*s = NULL;
+	return(1);
 }
 
 
-static void progFreeAssignment(void *vp) {
-	assignmentType *ap = (assignmentType *)vp;
-	if (ap != NULL) {
-		if (ap->assignment != NULL) {
-			progDeleteExpression(ap->assignment);
+/*
+ * Write the instructions starting at i, each as its keyword followed by what
+ * it was built from, and then the marker that ends them.
+ */
+static void progImagePutInstructions(instructionType *i) {
+	char *t;
+	for (; i != NULL; i = i->next) {
+		progImagePutLong(i->keyword);
+		switch (i->keyword) {
+			case kwAssignment:
+				progImagePutSymbol(((assignmentType *)i)->assignment);
+				break;
+			case kwCLOAD:
+			case kwLOAD:
+				progImagePutSymbol(((loadType *)i)->fileName);
+				break;
+			case kwCSAVE:
+			case kwSAVE:
+				progImagePutSymbol(((saveType *)i)->fileName);
+				break;
+			case kwDATA:
+				t = strmergez((const char **)((dataType *)i)->dataList, ",");
+				progImagePutString(t != NULL ? t : "");
+				if (t != NULL) {
+					free(t);
+				}
+				break;
+			case kwDIM:
+				progImagePutSymbols(((dimType *)i)->dimList, ((dimType *)i)->numElements);
+				break;
+			case kwFOR:
+				progImagePutSymbol(((forType *)i)->startPoint);
+				progImagePutSymbol(((forType *)i)->endPoint);
+				progImagePutSymbol(((forType *)i)->step);
+				break;
+			case kwGOSUB:
+				progImagePutSymbol(((gosubType *)i)->targetLine);
+				break;
+			case kwGOTO:
+				progImagePutSymbol(((gotoType *)i)->targetLine);
+				break;
+			case kwIF:
+				progImagePutSymbol(((ifType *)i)->expression);
+				progImagePutLong(((ifType *)i)->isGoto);
+				if (((ifType *)i)->isGoto) {
+					progImagePutSymbol(((ifType *)i)->gotoOrInstructions);
+				} else {
+					progImagePutInstructions(((ifType *)i)->gotoOrInstructions);
+				}
+				break;
+			case kwINPUT:
+				progImagePutSymbols(((inputType *)i)->varList, ((inputType *)i)->numVars);
+				break;
+			case kwLET:
+				progImagePutSymbol(((letType *)i)->assignment);
+				break;
+			case kwLIST:
+				progImagePutSymbol(((listType *)i)->startLine);
+				progImagePutSymbol(((listType *)i)->endLine);
+				break;
+			case kwNEXT:
+				progImagePutSymbol(((nextType *)i)->iteratorVar);
+				break;
+			case kwON:
+				progImagePutSymbol(((onType *)i)->expression);
+				progImagePutSymbol(((onType *)i)->instruction);
+				progImagePutSymbols(((onType *)i)->targetList, ((onType *)i)->numTargets);
+				break;
+			case kwPRINT:
+				progImagePutSymbols(((printType *)i)->expressionList, ((printType *)i)->numExpressions);
+				break;
+			case kwREAD:
+				progImagePutSymbols(((readType *)i)->varList, ((readType *)i)->numVars);
+				break;
+			case kwREM:
+				progImagePutString(((remType *)i)->remark);
+				break;
+			case kwRESTORE:
+				progImagePutSymbol(((restoreType *)i)->targetLine);
+				break;
+			case kwTRAP:
+				progImagePutSymbol(((trapType *)i)->targetLine);
+				break;
+			default:
+				break;
 		}
-		free(ap);
 	}
+	progImagePutLong(IMAGE_NULL);
 }
 
 
-static void progFreeDATA(void *vp) {
-	dataType *dp = (dataType *)vp;
-	if (dp != NULL) {
-		if (dp->dataList != NULL) {
-			free(dp->dataList);
-		}
-		free(dp);
-	}
+/*
+ * Write l, plus one so IMAGE_NULL becomes 0, seven bits to a byte with the
+ * top bit set on all but the last. Keywords, lengths and line numbers then
+ * mostly take a byte or two.
+ */
+static void progImagePutLong(unsigned long int l) {
+	char b[(sizeof(unsigned long int) * 8 + 6) / 7];
+	int n = 0;
+	l++;
+	while (l >= 0x80) {
+		b[n++] = (l & 0x7f) | 0x80;
+		l >>= 7;
+	}
+	b[n++] = l;
+	ioWrite(b, n);
 }
 
 
-static void progFreeDefault(void *vp) {
-	if (vp != NULL) {
-		free(vp);
+/*
+ * Write s as its length and its text with the terminator, so the loader can
+ * use the text where it lies in the mapped file.
+ */
+static void progImagePutString(const char *s) {
+	unsigned long int len;
+	if (s == NULL) {
+		progImagePutLong(IMAGE_NULL);
+		return;
 	}
+	len = strlen(s);
+	progImagePutLong(len);
+	ioWrite(s, len + 1);
 }
 
 
-static void progFreeDIM(void *vp) {
-	dimType *dp = (dimType *)vp;
-	unsigned long int i;
-	if (dp != NULL) {
-		if (dp->dimList != NULL) {
-			for (i = 0; i < dp->numElements; i++) {
-				if (dp->dimList[i] != NULL) {
-					free(dp->dimList[i]);
-				}
-			}
-			free(dp->dimList);
-		}
-		free(dp);
+/*
+ * Write the tree s in prefix order: its id and value, then its left and
+ * right subtrees. A missing tree is written as IMAGE_NULL.
+ */
+static void progImagePutSymbol(symbolType *s) {
+	if (s == NULL) {
+		progImagePutLong(IMAGE_NULL);
+		return;
 	}
+	progImagePutLong(s->id);
+	progImagePutString(s->value);
+	progImagePutSymbol(s->l);
+	progImagePutSymbol(s->r);
 }
 
 
-static void progFreeFOR(void *vp) {
-	forType *fp = (forType *)vp;
-	if (fp != NULL) {
-		if (fp->startPoint != NULL) {
-			progDeleteExpression(fp->startPoint);
-		}
-		if (fp->endPoint != NULL) {
-			progDeleteExpression(fp->endPoint);
-		}
-		if (fp->step != NULL) {
-			progDeleteExpression(fp->step);
-		}
-		free(fp);
+static void progImagePutSymbols(symbolType **s, unsigned long int n) {
+	unsigned long int i;
+	progImagePutLong(n);
+	for (i = 0; i < n; i++) {
+		progImagePutSymbol(s[i]);
 	}
 }
 
 
-static void progFreeGOSUB(void *vp) {
-	gosubType *gp = (gosubType *)vp;
-	if (gp != NULL) {
-		if (gp->targetLine != NULL) {
-			progDeleteExpression(gp->targetLine);
+/*
+ * Return the position in the line index of line l, or of the first line
+ * after it if l doesn't exist.
+ */
+static unsigned long int progIndexFind(long int l) {
+	unsigned long int lo = 0;
+	unsigned long int hi = progIndexLen;
+	unsigned long int mid;
+	while (lo < hi) {
+		mid = lo + ((hi - lo) >> 1);
+		if (progIndex[mid]->lineNum < l) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
-		free(gp);
 	}
+	return(lo);
 }
 
 
-static void progFreeGOTO(void *vp) {
-	gotoType *gp = (gotoType *)vp;
-	if (gp != NULL) {
-		if (gp->targetLine != NULL) {
-			progDeleteExpression(gp->targetLine);
-		}
-		free(gp);
-	}
+/*
+ * Return whether id names a plain numeric variable, without subscripts.
+ */
+static int progIsScalar(symbolType *id) {
+	return(id != NULL && id->id == kwIdentifier && id->l == NULL && id->r == NULL && strchr(id->value, '$') == NULL);
 }
 
 
-static void progFreeIF(void *vp) {
-	ifType *ip = (ifType *)vp;
-	if (ip != NULL) {
-		if (ip->expression != NULL) {
-			progDeleteExpression(ip->expression);
+/*
+ * Describe the instructions from i on, which belong to line number line of
+ * a region, as statements for the JIT. The instructions run by IF ... THEN
+ * follow the IF.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = an instruction can't be compiled
+ */
+static int progJitAppend(progJitType *j, instructionType *i, unsigned long int line) {
+	jitStatementType *s;
+	symbolType *a;
+	forType *fp;
+	ifType *ip;
+	for (; i != NULL; i = i->next) {
+		if (j->numStatements == JIT_REGION_STATEMENTS) {
+			return(1);
 		}
-		if (ip->isGoto) {
-			progDeleteExpression((symbolType *)ip->gotoOrInstructions);
-		} else {
-			progDeleteInstructions((instructionType *)ip->gotoOrInstructions);
+		s = &j->statements[j->numStatements++];
+		memset(s, 0, sizeof(jitStatementType));
+		s->line = line;
+		switch (i->keyword) {
+			case kwAssignment:
+			case kwLET:
+				a = i->keyword == kwLET ? ((letType *)i)->assignment : ((assignmentType *)i)->assignment;
+				if (a->l->id != kwIdentifier || strchr(a->l->value, '$') != NULL || !progJitCode(a->r, &s->value)) {
+					return(1);
+				}
+				if ((a->l->l != NULL && !progJitCode(a->l->l, &s->index1)) || (a->l->r != NULL && !progJitCode(a->l->r, &s->index2))) {
+					return(1);
+				}
+				s->kind = jitAssign;
+				s->slot = a->l->slot;
+				break;
+			case kwFOR:
+				fp = (forType *)i;
+				if (!progIsScalar(fp->startPoint->l) || !progJitCode(fp->startPoint->r, &s->value) || !progJitCode(fp->endPoint, &s->limit)) {
+					return(1);
+				}
+				if (fp->step != NULL && !progJitCode(fp->step, &s->step)) {
+					return(1);
+				}
+				s->kind = jitFor;
+				s->slot = fp->startPoint->l->slot;
+				break;
+			case kwGOTO:
+				s->kind = jitGoto;
+				j->jumps[j->numJumps++] = i;
+				s->jump = j->numJumps;
+				break;
+			case kwIF:
+				ip = (ifType *)i;
+				if (!progJitCode(ip->expression, &s->value)) {
+					return(1);
+				}
+				s->kind = jitIf;
+				if (ip->isGoto) {
+					j->jumps[j->numJumps++] = i;
+					s->jump = j->numJumps;
+				} else if (progJitAppend(j, ip->gotoOrInstructions, line)) {
+					return(1);
+				}
+				break;
+			case kwNEXT:
+				if (!progIsScalar(((nextType *)i)->iteratorVar)) {
+					return(1);
+				}
+				s->kind = jitNext;
+				s->slot = ((nextType *)i)->iteratorVar->slot;
+				break;
+			case kwREM:
+				s->kind = jitRem;
+				break;
+			default:
+				return(1);
 		}
-		free(ip);
 	}
+	return(0);
 }
 
 
-static void progFreeINPUT(void *vp) {
-	inputType *ip = (inputType *)vp;
+/*
+ * Return whether the n statements s can be compiled as a region. Loops run
+ * entirely in native code, as nothing is pushed on the control stack for
+ * them, so every FOR needs its NEXT in the region and no jump may leave a
+ * loop. A NEXT after an IF on the same line only runs when the IF is true,
+ * so that is only allowed for a loop that started after the IF.
+ */
+static int progJitBalanced(const jitStatementType *s, unsigned long int n) {
+	unsigned long int open[JIT_REGION_STATEMENTS];
+	unsigned long int depth = 0;
 	unsigned long int i;
-	if (ip != NULL) {
-		if (ip->varList != NULL) {
-			for (i = 0; i < ip->numVars; i++) {
-				if (ip->varList[i] != NULL) {
-					progDeleteExpression(ip->varList[i]);
+	long int lastIf = -1;
+	for (i = 0; i < n; i++) {
+		if (i > 0 && s[i].line != s[i - 1].line) {
+			lastIf = -1;
+		}
+		switch (s[i].kind) {
+			case jitFor:
+				open[depth++] = i;
+				break;
+			case jitNext:
+				if (depth == 0 || s[open[depth - 1]].slot != s[i].slot || (long int)open[depth - 1] < lastIf) {
+					return(0);
 				}
-			}
-			free(ip->varList);
+				depth--;
+				break;
+			case jitGoto:
+				if (depth > 0) {
+					return(0);
+				}
+				break;
+			case jitIf:
+				if (s[i].jump != 0 && depth > 0) {
+					return(0);
+				}
+				lastIf = i;
+				break;
+			default:
+				break;
 		}
-		free(ip);
 	}
+	return(depth == 0);
 }
 
 
-static void progFreeLET(void *vp) {
-	letType *lp = (letType *)vp;
-	if (lp != NULL) {
-		if (lp->assignment != NULL) {
-			progDeleteExpression(lp->assignment);
-		}
-		free(lp);
+/*
+ * Set *c to the code of expression e if the JIT can compile it.
+ */
+static int progJitCode(symbolType *e, codeType **c) {
+	if (e == NULL || e->code == NULL || !jitSupports(e->code)) {
+		return(0);
 	}
+	*c = e->code;
+	return(1);
 }
 
 
-static void progFreeLIST(void *vp) {
-	listType *lp = (listType *)vp;
-	if (lp != NULL) {
-		if (lp->startLine != NULL) {
-			progDeleteExpression(lp->startLine);
-		}
-		if (lp->endLine != NULL) {
-			progDeleteExpression(lp->endLine);
+/*
+ * Compile line p to native code, together with as many of the lines after
+ * it as will go: each has to be made of statements the JIT handles, and the
+ * region as a whole has to pass progJitBalanced.
+ *
+ * Returns
+ *
+ *	NULL = the line can't be compiled
+ *	otherwise, its native code
+ */
+static progNativeType *progJitCompile(progLineType *p) {
+	progLineType *lines[JIT_REGION_LINES];
+	unsigned long int ends[JIT_REGION_LINES];
+	progNativeType *n = NULL;
+	progJitType j;
+	jitRegionType r;
+	jitFunc *func;
+	unsigned long int numLines = 0;
+	j.numStatements = j.numJumps = 0;
+	j.jumps = NULL;
+	if ((j.statements = malloc(sizeof(jitStatementType) * JIT_REGION_STATEMENTS)) == NULL) {
+		goto err;
+	}
+	if ((j.jumps = malloc(sizeof(instructionType *) * JIT_REGION_STATEMENTS)) == NULL) {
+		goto err;
+	}
+	for (; p != NULL && numLines < JIT_REGION_LINES; p = p->next) {
+		if (progJitAppend(&j, p->firstInstruction, numLines)) {
+			break;
 		}
-		free(lp);
+		lines[numLines] = p;
+		ends[numLines++] = j.numStatements;
+	}
+	while (numLines > 0 && !progJitBalanced(j.statements, ends[numLines - 1])) {
+		numLines--;
+	}
+	if (numLines == 0) {
+		goto err;
+	}
+	r.statements = j.statements;
+	r.numStatements = ends[numLines - 1];
+	r.numLines = numLines;
+	r.lineNum = lines[0]->lineNum;
+	r.counter = &progStatements;
+	r.forEnter = progJitForEnter;
+	if ((func = jitCompile(&r)) == NULL) {
+		goto err;
+	}
+	if ((n = malloc(sizeof(progNativeType))) == NULL) {
+		goto err;
+	}
+	if ((n->jumps = malloc(sizeof(instructionType *) * (j.numJumps + 1))) == NULL) {
+		free(n);
+		n = NULL;
+		goto err;
 	}
+	memcpy(n->jumps, j.jumps, sizeof(instructionType *) * j.numJumps);
+	n->func = func;
+	n->last = lines[numLines - 1];
+err:
+	free(j.statements);
+	free(j.jumps);
+	return(n);
 }
 
 
-static void progFreeLOAD(void *vp) {
-	loadType *lp = (loadType *)vp;
-	if (lp != NULL) {
-		if (lp->fileName != NULL) {
-			progDeleteExpression(lp->fileName);
-		}
-		free(lp);
+/*
+ * Called by native code as a FOR starts. Like progExecuteFOR, drop any loop
+ * on the same variable, and the loops inside it.
+ */
+static void progJitForEnter(long int slot) {
+	long int i;
+	if ((i = progControlFindFOR(slot)) >= 0) {
+		controlStackLen = i;
 	}
 }
 
 
-static void progFreeNEXT(void *vp) {
-	nextType *np = (nextType *)vp;
-	if (np != NULL) {
-		if (np->iteratorVar != NULL) {
-			progDeleteExpression(np->iteratorVar);
-		}
-		free(np);
+static void progJitFree(progLineType *p) {
+	if (p->native != NULL) {
+		free(p->native->jumps);
+		free(p->native);
+		p->native = NULL;
 	}
 }
 
 
-static void progFreeON(void *vp) {
-	onType *op = (onType *)vp;
-	unsigned long int i;
-	if (op != NULL) {
-		if (op->expression != NULL) {
-			progDeleteExpression(op->expression);
-		}
-		if (op->instruction != NULL) {
-			progDeleteExpression(op->instruction);
-		}
-		if (op->targetList != NULL) {
-			for (i = 0; i < op->numTargets; i++) {
-				if (op->targetList[i] != NULL) {
-					progDeleteExpression(op->targetList[i]);
-				}
-			}
-			free(op->targetList);
-		}
-		free(op);
+/*
+ * Drop the native code of every line, and with it the executable memory it
+ * took, so that lines are counted and compiled afresh.
+ */
+static void progJitReset(void) {
+	progLineType *p;
+	for (p = prog; p != NULL; p = p->next) {
+		progJitFree(p);
+		p->runs = 0;
 	}
+	jitReset();
+	progJitEdits = progEdits;
 }
 
 
-static void progFreePRINT(void *vp) {
-	printType *pp = (printType *)vp;
-	unsigned long int i;
-	if (pp != NULL) {
-		if (pp->expressionList != NULL) {
-			for (i = 0; i < pp->numExpressions; i++) {
-				if (pp->expressionList[i] != NULL) {
-					progDeleteExpression(pp->expressionList[i]);
-				}
-			}
-			free(pp->expressionList);
-		}
-		free(pp);
+/*
+ * Fill in o if the expression e is a plain numeric variable or folds to a
+ * numeric constant. Subexpressions aren't compiled with their statement, so
+ * e is compiled into arena a here to find out.
+ *
+ * Returns 1 if e is an operand, 0 otherwise.
+ */
+static int progOperand(symbolType *e, arenaType *a, operandType *o) {
+	if (e == NULL) {
+		return(0);
+	}
+	if (progIsScalar(e)) {
+		o->slot = e->slot;
+		o->n = 0;
+		return(1);
+	}
+	if (progCompileExpression(e, a)) {
+		return(0);
+	}
+	if (e->code->ops[0].op == opPushNumeric && e->code->ops[1].op == opEnd) {
+		o->slot = -1;
+		o->n = e->code->ops[0].arg.n;
+		return(1);
 	}
+	return(0);
 }
 
 
-static void progFreeREAD(void *vp) {
-	readType *rp = (readType *)vp;
+static double progOperandValue(operandType *o) {
+	double d;
+	if (o->slot < 0) {
+		return(o->n);
+	}
+	varGetNumeric(o->slot, 1, 1, &d);
+	return(d);
+}
+
+
+int progInit(void) {
+	srand(time(NULL));
+	return(0);
+}
+
+
+progLineType *progInsertLine(int l) {
+	progLineType *p;
+	progLineType **pi;
 	unsigned long int i;
-	if (rp != NULL) {
-		if (rp->varList != NULL) {
-			for (i = 0; i < rp->numVars; i++) {
-				if (rp->varList[i] != NULL) {
-					free(rp->varList[i]);
-				}
-			}
-			free(rp->varList);
+	if (progIndexLen == progIndexMax) {
+		i = progIndexMax ? progIndexMax << 1 : 256;
+		if ((pi = realloc(progIndex, sizeof(progLineType *) * i)) == NULL) {
+			utilError(memErr);
+			return(NULL);
 		}
-		free(rp);
+		progIndex = pi;
+		progIndexMax = i;
+	}
+	if ((p = malloc(sizeof(progLineType))) == NULL) {
+		return(NULL);
+	}
+	if ((p->arena = arenaNew()) == NULL) {
+		free(p);
+		return(NULL);
+	}
+	p->lineNum = l;
+	p->firstInstruction = p->lastInstruction = p->currentInstruction = NULL;
+	p->runs = 0;
+	p->native = NULL;
+	progEdits++;
+	i = progIndexFind(l);
+	if (i < progIndexLen && progIndex[i]->lineNum == l) {
+		p->next = progIndex[i]->next;
+		progDeleteInstructions(progIndex[i]->firstInstruction);
+		progJitFree(progIndex[i]);
+		arenaFree(progIndex[i]->arena);
+		free(progIndex[i]);
+		progGeneration++;
+	} else {
+		p->next = i < progIndexLen ? progIndex[i] : NULL;
+		memmove(&progIndex[i + 1], &progIndex[i], sizeof(progLineType *) * (progIndexLen - i));
+		progIndexLen++;
+	}
+	progIndex[i] = p;
+	if (i > 0) {
+		progIndex[i - 1]->next = p;
+	} else {
+		prog = p;
 	}
+	return(p);
 }
 
 
-static void progFreeREM(void *vp) {
-	remType *rp = (remType *)vp;
-	if (rp != NULL) {
-		if (rp->remark != NULL) {
-			free(rp->remark);
-		}
-		free(rp);
+/*
+ * Return whether file fn starts like a program image, so it can be loaded
+ * with progLoadImage instead of being parsed.
+ */
+int progIsImage(const char *fn) {
+	imageHeaderType h;
+	int fd;
+	int rc = 0;
+	if ((fd = open(fn, O_RDONLY)) < 0) {
+		return(0);
 	}
+	if (read(fd, &h, sizeof(imageHeaderType)) == sizeof(imageHeaderType) && !memcmp(h.magic, IMAGE_MAGIC, sizeof(h.magic))) {
+		rc = 1;
+	}
+	close(fd);
+	return(rc);
 }
 
 
-static void progFreeRESTORE(void *vp) {
-	restoreType *rp = (restoreType *)vp;
-	if (rp != NULL) {
-		if (rp->targetLine != NULL) {
-			progDeleteExpression(rp->targetLine);
+/*
+ * Replace the program with the image in file fn. The file is mapped rather
+ * than read, and each line is rebuilt straight from the saved trees, without
+ * scanning or parsing any text.
+ */
+int progLoadImage(const char *fn) {
+	const imageHeaderType *h;
+	progLineType *p;
+	struct stat st;
+	void *m = MAP_FAILED;
+	unsigned long int l;
+	int fd;
+	if ((fd = open(fn, O_RDONLY)) < 0 || fstat(fd, &st) < 0) {
+		utilError("couldn't load file [%s]", fn);
+		goto err;
+	}
+	if (st.st_size < sizeof(imageHeaderType) || (m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		utilError("couldn't load image [%s]", fn);
+		goto err;
+	}
+	h = m;
+	if (memcmp(h->magic, IMAGE_MAGIC, sizeof(h->magic)) || h->order != IMAGE_ORDER) {
+		utilError("not a program image [%s]", fn);
+		goto err;
+	}
+	if (h->version != IMAGE_VERSION || h->keywords != kwSubExpression + 1) {
+		utilError("program image [%s] is from another version", fn);
+		goto err;
+	}
+	progNew();
+	imagePos = (const char *)m + sizeof(imageHeaderType);
+	imageEnd = (const char *)m + st.st_size;
+	imageDepth = 0;
+	while (1) {
+		if (progImageGetLong(&l)) {
+			goto err;
+		}
+		if (l == IMAGE_NULL) {
+			break;
+		}
+		if (l > INT_MAX) {
+			utilError(imageErr);
+			goto err;
+		}
+		if ((p = progInsertLine(l)) == NULL) {
+			utilError(memErr);
+			goto err;
+		}
+		if (progImageGetInstructions(p)) {
+			goto err;
 		}
-		free(rp);
 	}
+	munmap(m, st.st_size);
+	close(fd);
+	return(0);
+err:
+	if (m != MAP_FAILED) {
+		munmap(m, st.st_size);
+		progNew();
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	return(1);
 }
 
 
-static void progFreeSAVE(void *vp) {
-	saveType *sp = (saveType *)vp;
-	if (sp != NULL) {
-		if (sp->fileName != NULL) {
-			progDeleteExpression(sp->fileName);
+/*
+ * Clear the variables, define ARGC and ARG$ when arguments were given, load
+ * the DATA statements and run the program from its first line.
+ *
+ * Returns 0 when the program ran without errors, 1 otherwise.
+ */
+int progRun(void) {
+	int errors = utilErrors;
+	varClearAll();
+	if (progArgv != NULL) {
+		progDefineArgs();
+	}
+	controlStackLen = 0;
+	progStop = NULL;
+	progCurrent = prog;
+	while (progCurrent) {
+		progCurrent->currentInstruction = progCurrent->firstInstruction;
+		while (progCurrent->currentInstruction) {
+			if (progCurrent->currentInstruction->keyword == kwDATA) {
+				progCurrent->currentInstruction->executeFunc(progCurrent->currentInstruction);
+			}
+			progCurrent->currentInstruction = progCurrent->currentInstruction->next;
 		}
-		free(sp);
+		progCurrent->currentInstruction = progCurrent->firstInstruction;
+		progCurrent = progCurrent->next;
 	}
+	progCurrent = prog;
+	progExecute();
+	return(utilErrors != errors);
 }
 
 
-static void progFreeTRAP(void *vp) {
-	trapType *tp = (trapType *)vp;
-	if (tp != NULL) {
-		if (tp->targetLine) {
-			progDeleteExpression(tp->targetLine);
-		}
-		free(tp);
+/*
+ * Write the program to file fn as an image for progLoadImage: a header, then
+ * each line as its number and its instructions, then IMAGE_NULL.
+ */
+int progSaveImage(const char *fn) {
+	imageHeaderType h;
+	progLineType *p;
+	memset(&h, 0, sizeof(imageHeaderType));
+	memcpy(h.magic, IMAGE_MAGIC, sizeof(h.magic));
+	h.version = IMAGE_VERSION;
+	h.order = IMAGE_ORDER;
+	h.keywords = kwSubExpression + 1;
+	if (ioOpenOutput((char *)fn)) {
+		utilError("unable to create output file [%s]", fn);
+		return(1);
+	}
+	ioWrite((const char *)&h, sizeof(imageHeaderType));
+	for (p = prog; p != NULL; p = p->next) {
+		progImagePutLong(p->lineNum);
+		progImagePutInstructions(p->firstInstruction);
+	}
+	progImagePutLong(IMAGE_NULL);
+	if (ioCloseOutput()) {
+		utilError("unable to write output file [%s]", fn);
+		return(1);
 	}
+	return(0);
 }
 
 
-int progInit(void) {
-	atexit(progExit);
-	stackInit(callStack);
-	stackInit(forLineStack);
-	stackInit(forInstructionStack);
-	srand(time(NULL));
-	return(0);
-err:
-	return(1);
+void progSetArgs(int ac, char **av) {
+	progArgc = ac;
+	progArgv = av;
 }
 
 
-progLineType *progInsertLine(int l) {
-	progLineType *p = malloc(sizeof(progLineType));
-	progLineType *n;
-	if (p == NULL) {
-		return(NULL);
-	}
-	p->next = NULL;
-	p->lineNum = l;
-	p->firstInstruction = p->lastInstruction = p->currentInstruction = NULL;
-	if (prog == NULL) {
-		prog = p;
-		return(p);
-	} else if (prog->lineNum == l) {
-		p->next = prog->next;
-		progDeleteInstructions(prog->firstInstruction);
-		free(prog);
-		prog = p;
-		return(p);
-	}
-	n = prog;
-	while (n->next && n->next->lineNum < l) {
-		n = n->next;
-	}
-	if (n->next) {
-		if (n->next->lineNum == l) {
-			p->next = n->next->next;
-			progDeleteInstructions(n->next->firstInstruction);
-			free(n->next);
-			n->next = p;
-			return(p);
-		}
-	}
-	p->next = n->next;
-	n->next = p;
-	return(p);
+unsigned long int progStatementCount(void) {
+	return(progStatements);
 }
 
 
-static int progList(int fh, long int start, long int end) {
+static int progList(long int start, long int end) {
 	progLineType *p = prog;
 	instructionType *i;
-	char *e = NULL;
-	char *s = NULL;
-	char *ss = NULL;
-	unsigned long int len = 1024;
-	unsigned long int eLen = 0;
-	unsigned long int sLen = 0;
-	if ((s = malloc(len)) == NULL) {
-		utilError(memErr);
-		goto err;
-	}
-	while (p && ((p->lineNum >= start || start == -1) && (p->lineNum <= end || end == -1))) {
-		sprintf(s, "%li ", p->lineNum);
-		sLen = strlen(s);
-		i = p->firstInstruction;
-		while (i) {
+	char *e;
+	for (p = prog; p != NULL && (p->lineNum <= end || end == -1); p = p->next) {
+		if (p->lineNum < start) {
+			continue;
+		}
+		ioPrintf("%li ", p->lineNum);
+		for (i = p->firstInstruction; i != NULL; i = i->next) {
 			if ((e = i->formatFunc(i)) != NULL) {
-				eLen = strlen(e);
-				if (sLen + eLen + 5 > len) {
-					len <<= 1;
-					if ((ss = realloc(s, len)) == NULL) {
-						utilError(memErr);
-						goto err;
-					}
-					s = ss;
-				}
-				strcat(s, e);
+				ioWrite(e, strlen(e));
+				free(e);
 				if (i->next != NULL) {
-					strcat(s, " : ");
+					ioWrite(" : ", 3);
 				}
-				free(e);
-				e = NULL;
 			}
-			i = i->next;
 		}
-		write(fh, s, strlen(s));
-		s[0] = '\n';
-		write(fh, s, 1);
-		p = p->next;
-	}
-err:
-	if (e != NULL) {
-		free(e);
-	}
-	if (s != NULL) {
-		free(s);
+		ioWrite("\n", 1);
 	}
+	return(0);
 }
 
 
@@ -2427,469 +4345,177 @@ int progNew(void) {
 	while (p) {
 		t = p->next;
 		progDeleteInstructions(p->firstInstruction);
+		progJitFree(p);
+		arenaFree(p->arena);
 		free(p);
 		p = t;
 	}
 	prog = NULL;
+	progIndexLen = 0;
+	progGeneration++;
+	progEdits++;
+	controlStackLen = 0;
 }
 
 
-static int isNumeric(char *s) {
-	char haveSign = 0;
-	char haveDecimal = 0;
-	/* skip whitespace */
-	while (isspace(*s)) {
-		s++;
-	}
-	if (*s == 0) {
-		return(0);
-	}
-	/* can have an optional + or - now */
-	if (*s == '+' || *s == '-') {
-		haveSign = 1;
-		s++;
-	}
-	/* skip whitespace */
-	while (isspace(*s)) {
-		s++;
-	}
-	if (*s == 0) {
-		return(0);
+/*
+ * Find the line a GOTO, GOSUB, IF or TRAP jumps to. When the target is a
+ * constant the line is remembered in t until the program is next edited.
+ */
+static progLineType *progResolveTarget(symbolType *e, targetType *t) {
+	progLineType *p;
+	double d;
+	if (t->generation == progGeneration) {
+		return(t->line);
 	}
-	/* now, we can have digits and one . */
-	while (isdigit(*s) || (*s == '.')) {
-		if (*s == '.') {
-			if (haveDecimal) {
-				return(0);
-			}
-			haveDecimal = 1;
-		}
-		s++;
+	if (e == NULL) {
+		utilError("expected expression");
+		return(NULL);
 	}
-	if (*s == 0) {
-		return(1);
+	if (e->id == kwNumeric) {
+		d = strtod(e->value, NULL);
+	} else if (evalNumeric(e, &d)) {
+		utilError("couldn't evaluate expression");
+		return(NULL);
 	}
-	/* skip whitespace */
-	while (isspace(*s)) {
-		s++;
+	if ((p = progFindLine(d)) == NULL) {
+		utilError("line %li not found", (long int)d);
+		return(NULL);
 	}
-	if (*s == 0) {
-		return(1);
+	if (e->id == kwNumeric) {
+		t->line = p;
+		t->generation = progGeneration;
 	}
-	/* a non-whitespace, non string-terminator character was found */
-	return(0);
+	return(p);
 }
 
 
-static char *eval(symbolType *expr) {
-	if (expr == NULL) {
-		return(NULL);
-	}
-	char *r = malloc(maxStringLen + 1);
-	char *left = NULL;
-	char *right = NULL;
-	char *s = NULL;
-	double o1 = 0;
-	double o2 = 0;
-	long d1 = 1;
-	long d2 = 1;
-	int e1, e2;
-	if (r == NULL) {
-		utilError("couldn't allocate memory");
-		goto err;
-	}
-	switch (expr->id) {
-		case kwString:
-		case kwNumeric:
-			strcpy(r, expr->value);
-			break;
-		case kwIdentifier:
-			if (expr->l != NULL) {
-				if ((left = eval(expr->l)) != NULL) {
-					d1 = strtol(left, NULL, 10);
-					free(left);
-					left = NULL;
-				}
-			}
-			if (expr->r != NULL) {
-				if ((right = eval(expr->r)) != NULL) {
-					d2 = strtol(right, NULL, 10);
-					free(right);
-					right = NULL;
-				}
+/*
+ * Replace the execute function of i with a fused one when the statement is
+ * one of a few common shapes, so it runs without going through eval. p is
+ * the line i is being added to.
+ */
+static void progSpecialise(progLineType *p, instructionType *i) {
+	assignmentType *ap;
+	ifType *ip;
+	nextType *np;
+	readType *rp;
+	instructionType *j;
+	symbolType *e;
+	switch (i->keyword) {
+		case kwAssignment:
+			ap = (assignmentType *)i;
+			e = ap->assignment->r;
+			if (!progIsScalar(ap->assignment->l)) {
+				break;
 			}
-			if ((right = varGetValue(expr->value, d1, d2)) != NULL) {
-				strcpy(r, right);
+			if (progOperand(e, p->arena, &ap->a)) {
+				ap->op = kwAssignment;
+			} else if ((e->id == kwOpAdd || e->id == kwOpSub || e->id == kwOpMul || e->id == kwOpDiv) && progOperand(e->l, p->arena, &ap->a) && progOperand(e->r, p->arena, &ap->b)) {
+				ap->op = e->id;
+			} else {
+				break;
 			}
+			i->executeFunc = progExecuteAssignmentFused;
 			break;
-		case kwOpAdd:
-		case kwOpSub:
-		case kwOpMul:
-		case kwOpDiv:
-		case kwOpExp:
-		case kwLogicalLT:
-		case kwLogicalLTE:
-		case kwLogicalEQ:
-		case kwLogicalNE:
-		case kwLogicalGT:
-		case kwLogicalGTE:
-			left = eval(expr->l);
-			right = eval(expr->r);
-			if (left != NULL) {
-				o1 = strtod(left, NULL);
-			}
-			if (right != NULL) {
-				o2 = strtod(right, NULL);
+		case kwIF:
+			ip = (ifType *)i;
+			e = ip->expression;
+			if (!ip->isGoto || e->id < kwLogicalLT || e->id > kwLogicalGTE) {
+				break;
 			}
-			e1 = isNumeric(left);
-			e2 = isNumeric(right);
-			switch (expr->id) {
-				case kwOpAdd:
-					sprintf(r, "%f", o1 + o2);
-					break;
-				case kwOpSub:
-					sprintf(r, "%f", o1 - o2);
-					break;
-				case kwOpMul:
-					sprintf(r, "%f", o1 * o2);
-					break;
-				case kwOpDiv:
-					sprintf(r, "%f", o1 / o2);
-					break;
-				case kwOpExp:
-					sprintf(r, "%f", pow(o1, o2));
-					break;
-				case kwLogicalLT:
-					if (e1 + e2 != 0) {
-						if (o1 < o2) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					} else {
-						if (strcmp(left, right) < 0) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					}
-					r[1] = 0;
-					break;
-				case kwLogicalLTE:
-					if (e1 + e2 != 0) {
-						if (o1 <= o2) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					} else {
-						if (strcmp(left, right) <= 0) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					}
-					r[1] = 0;
-					break;
-				case kwLogicalEQ:
-					if (e1 + e2 != 0) {
-						if (o1 == o2) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					} else {
-						if (strcmp(left, right) == 0) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					}
-					r[1] = 0;
-					break;
-				case kwLogicalNE:
-					if (e1 + e2 != 0) {
-						if (o1 != o2) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					} else {
-						if (strcmp(left, right) != 0) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					}
-					r[1] = 0;
-					break;
-				case kwLogicalGT:
-					if (e1 + e2 != 0) {
-						if (o1 > o2) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					} else {
-						if (strcmp(left, right) > 0) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					}
-					r[1] = 0;
-					break;
-				case kwLogicalGTE:
-					if (e1 + e2 != 0) {
-						if (o1 >= o2) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					} else {
-						if (strcmp(left, right) >= 0) {
-							r[0] = '1';
-						} else {
-							r[0] = '0';
-						}
-					}
-					r[1] = 0;
-					break;
+			if (progOperand(e->l, p->arena, &ip->l) && progOperand(e->r, p->arena, &ip->r)) {
+				i->executeFunc = progExecuteIFCompare;
 			}
 			break;
-		case kwAssignment:
-			right = eval(expr->r);
-			if (expr->l->l != NULL) {
-				if ((s = eval(expr->l->l)) == NULL) {
-					goto err;
-				}
-				d1 = strtol(s, NULL, 10);
-				free(s);
-				if ((s = eval(expr->l->r)) == NULL) {
-					goto err;
+		case kwNEXT:
+			np = (nextType *)i;
+			np->forIns = NULL;
+			if (!progIsScalar(np->iteratorVar)) {
+				break;
+			}
+			for (j = p->firstInstruction; j != NULL && j != i; j = j->next) {
+				if (j->keyword == kwFOR && ((forType *)j)->startPoint->l->slot == np->iteratorVar->slot && progIsScalar(((forType *)j)->startPoint->l)) {
+					np->forIns = j;
 				}
-				d2 = strtol(s, NULL, 10);
-				free(s);
 			}
-			if (varSetValue(expr->l->value, right, d1, d2)) {
-				goto err;
+			if (np->forIns != NULL) {
+				i->executeFunc = progExecuteNEXTLocal;
 			}
 			break;
-		case kwSignPlus:
-			right = eval(expr->r);
-			o2 = strtod(right, NULL);
-			sprintf(r, "%f", o2);
-			break;
-		case kwSignMinus:
-			right = eval(expr->r);
-			o2 = strtod(right, NULL);
-			o2 = 0 - o2;
-			sprintf(r, "%f", o2);
-			break;
-		case kwSubExpression:
-			right = eval(expr->r);
-			strcpy(r, right);
-			break;
-		case kwABS:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = abs(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwASC:
-			left = eval(expr->l);
-			o1 = left[0];
-			sprintf(r, "%f", o1);
-			break;
-		case kwATN:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = atan(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwCLOG:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = log10(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwCOS:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = cos(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwEXP:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = exp(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwINT:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = trunc(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwLEN:
-			left = eval(expr->l);
-			sprintf(r, "%i", strlen(left));
-			break;
-		case kwLOG:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = log(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwRND:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = (double)rand() / (double)RAND_MAX;
-			sprintf(r, "%f", o1);
-			break;
-		case kwSGN:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			if (o1 > 0) {
-				r[0] = '1';
-				r[1] = 0;
-			} else if (o1 == 0) {
-				r[0] = '0';
-				r[1] = 0;
-			} else if (o1 < 0) {
-				r[0] = '-';
-				r[1] = '1';
-				r[2] = 0;
+		case kwREAD:
+			rp = (readType *)i;
+			e = rp->numVars == 1 ? rp->varList[0] : NULL;
+			if (e == NULL || strchr(e->value, '$') != NULL) {
+				break;
 			}
-			break;
-		case kwSIN:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = sin(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwSQR:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = sqrt(o1);
-			sprintf(r, "%f", o1);
-			break;
-		case kwVAL:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			sprintf(r, "%f", o1);
-			break;
-		case kwCHR:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			o1 = trunc(o1);
-			r[0] = (char)o1;
-			r[1] = 0;
-			break;
-		case kwSTR:
-			left = eval(expr->l);
-			o1 = strtod(left, NULL);
-			sprintf(r, "%f", o1);
-			break;
-		case kwOR:
-			left = eval(expr->l);
-			right = eval(expr->r);
-			o1 = strtod(left, NULL);
-			o2 = strtod(right, NULL);
-			if (o1 || o2) {
-				r[0] = '1';
-			} else {
-				r[0] = '0';
+			if (e->l != NULL && !progOperand(e->l, p->arena, &rp->dim1)) {
+				break;
 			}
-			r[1] = 0;
-			break;
-		case kwAND:
-			left = eval(expr->l);
-			right = eval(expr->r);
-			o1 = strtod(left, NULL);
-			o2 = strtod(right, NULL);
-			if (o1 && o2) {
-				r[0] = '1';
-			} else {
-				r[0] = '0';
+			if (e->r != NULL && !progOperand(e->r, p->arena, &rp->dim2)) {
+				break;
 			}
-			r[1] = 0;
+			i->executeFunc = progExecuteREADNumeric;
 			break;
-		case kwNOT:
-			left = eval(expr->r);
-			o1 = strtod(left, NULL);
-			if (o1) {
-				r[0] = '0';
-			} else {
-				r[0] = '1';
-			}
-			r[1] = 0;
+		default:
 			break;
 	}
-	if (left != NULL) {
-		free(left);
-	}
-	if (right != NULL) {
-		free(right);
-	}
-	if (isNumeric(r)) {
-		progCleanupNumeric(r);
-	}
-	return(r);
-err:
-	if (r != NULL) {
-		free(r);
-	}
-	if (left != NULL) {
-		free(left);
-	}
-	if (right != NULL) {
-		free(right);
+}
+
+
+static int eval(symbolType *expr, valueType *r) {
+	if (expr == NULL || expr->code == NULL) {
+		return(1);
 	}
-	return(NULL);
+	return(codeExecute(expr->code, r));
 }
 
 
+/*
+ * Format an expression tree back into source text. Each piece is formatted
+ * by evalFormat, so every string is allocated at exactly its length.
+ */
 static char *evalCode(symbolType *exp) {
-	char *s = malloc(maxStringLen + 1);
+	char *s = NULL;
 	char *t = NULL;
 	char *r = NULL;
 	char *l = NULL;
-	char ch;
 	if (exp == NULL) {
-		return(strdup(""));
+		return(evalFormat(""));
 	}
-	if (s == NULL) {
-		utilError("couldn't allocate memory");
+	if (exp->l != NULL && (l = evalCode(exp->l)) == NULL) {
+		goto err;
+	}
+	if (exp->r != NULL && (r = evalCode(exp->r)) == NULL) {
 		goto err;
 	}
 	switch (exp->id) {
 		case kwAssignment:
-			l = evalCode(exp->l);
-			r = evalCode(exp->r);
-			sprintf(s, "%s = %s", l, r);
+			s = evalFormat("%s = %s", l, r);
 			break;
 		case kwOpAdd:
 		case kwOpSub:
 		case kwOpMul:
 		case kwOpDiv:
-			l = evalCode(exp->l);
-			r = evalCode(exp->r);
+		case kwOpExp:
 			switch (exp->id) {
 				case kwOpAdd:
-					ch = '+';
+					t = "+";
 					break;
 				case kwOpSub:
-					ch = '-';
+					t = "-";
 					break;
 				case kwOpMul:
-					ch = '*';
+					t = "*";
 					break;
 				case kwOpDiv:
-					ch = '/';
+					t = "/";
+					break;
+				default:
+					t = "^";
 					break;
 			}
-			sprintf(s, "%s %c %s", l, ch, r);
+			s = evalFormat("%s %s %s", l, t, r);
 			break;
 		case kwLogicalLT:
 		case kwLogicalLTE:
@@ -2897,8 +4523,6 @@ static char *evalCode(symbolType *exp) {
 		case kwLogicalNE:
 		case kwLogicalGT:
 		case kwLogicalGTE:
-			l = evalCode(exp->l);
-			r = evalCode(exp->r);
 			switch (exp->id) {
 				case kwLogicalLT:
 					t = "<";
@@ -2915,45 +4539,33 @@ static char *evalCode(symbolType *exp) {
 				case kwLogicalGT:
 					t = ">";
 					break;
-				case kwLogicalGTE:
+				default:
 					t = ">=";
 					break;
 			}
-			sprintf(s, "%s %s %s", l, t, r);
+			s = evalFormat("%s %s %s", l, t, r);
 			break;
 		case kwSignPlus:
+			s = evalFormat("+%s", r);
+			break;
 		case kwSignMinus:
-			if (exp->id == kwSignPlus) {
-				strcpy(s, "+");
-			} else {
-				strcpy(s, "-");
-			}
-			r = evalCode(exp->r);
-			strcat(s, r);
+			s = evalFormat("-%s", r);
 			break;
 		case kwIdentifier:
 		case kwNumeric:
-			strcpy(s, exp->value);
-			if (exp->id == kwIdentifier && exp->l != NULL) {
-				strcat(s, "(");
-				if (exp->l != NULL) {
-					l = evalCode(exp->l);
-					strcat(s, l);
-					if (exp->r != NULL) {
-						strcat(s, ",");
-						r = evalCode(exp->r);
-						strcat(s, r);
-					}
-				}
-				strcat(s, ")");
+			if (exp->id == kwNumeric || l == NULL) {
+				s = evalFormat("%s", exp->value);
+			} else if (r == NULL) {
+				s = evalFormat("%s(%s)", exp->value, l);
+			} else {
+				s = evalFormat("%s(%s,%s)", exp->value, l, r);
 			}
 			break;
 		case kwString:
-			sprintf(s, "\"%s\"", exp->value);
+			s = evalFormat("\"%s\"", exp->value);
 			break;
 		case kwSubExpression:
-			l = evalCode(exp->r);
-			sprintf(s, "(%s)", l);
+			s = evalFormat("(%s)", r);
 			break;
 		case kwABS:
 		case kwASC:
@@ -2971,24 +4583,22 @@ static char *evalCode(symbolType *exp) {
 		case kwVAL:
 		case kwCHR:
 		case kwSTR:
-			l = evalCode(exp->l);
-			sprintf(s, "%s(%s)", scanGetKeyword(exp->id), l);
+			s = evalFormat("%s(%s)", scanGetKeyword(exp->id), l);
 			break;
 		case kwAND:
-			l = evalCode(exp->l);
-			r = evalCode(exp->r);
-			sprintf(s, "%s and %s", l, r);
+			s = evalFormat("%s and %s", l, r);
 			break;
 		case kwOR:
-			l = evalCode(exp->l);
-			r = evalCode(exp->r);
-			sprintf(s, "%s or %s", l, r);
+			s = evalFormat("%s or %s", l, r);
 			break;
 		case kwNOT:
-			r = evalCode(exp->r);
-			sprintf(s, "not %s", r);
+			s = evalFormat("not %s", r);
+			break;
+		default:
+			s = evalFormat("");
 			break;
 	}
+err:
 	if (l != NULL) {
 		free(l);
 	}
@@ -2996,17 +4606,84 @@ static char *evalCode(symbolType *exp) {
 		free(r);
 	}
 	return(s);
-err:
-	if (s != NULL) {
-		free(s);
+}
+
+
+/*
+ * Return a newly allocated string formatted from fmt, sized to fit.
+ */
+static char *evalFormat(const char *fmt, ...) {
+	va_list vl;
+	char *s;
+	int len;
+	va_start(vl, fmt);
+	len = vsnprintf(NULL, 0, fmt, vl);
+	va_end(vl);
+	if (len < 0 || (s = malloc(len + 1)) == NULL) {
+		utilError("couldn't allocate memory");
+		return(NULL);
 	}
-	if (r != NULL) {
-		free(r);
+	va_start(vl, fmt);
+	vsnprintf(s, len + 1, fmt, vl);
+	va_end(vl);
+	return(s);
+}
+
+
+static int evalIndices(symbolType *id, long *dim1, long *dim2) {
+	double d;
+	*dim1 = 1;
+	*dim2 = 1;
+	if (id->l != NULL) {
+		if (evalNumeric(id->l, &d)) {
+			return(1);
+		}
+		*dim1 = d;
 	}
-	if (l != NULL) {
-		free(l);
+	if (id->r != NULL) {
+		if (evalNumeric(id->r, &d)) {
+			return(1);
+		}
+		*dim2 = d;
 	}
-	return(NULL);
+	return(0);
+}
+
+
+/*
+ * Evaluate the subscripts of the variable id and resolve the element they
+ * select, for a statement to assign to.
+ */
+static int evalLvalue(symbolType *id, varRefType *r) {
+	long dim1;
+	long dim2;
+	if (evalIndices(id, &dim1, &dim2)) {
+		return(1);
+	}
+	return(varRef(id->slot, dim1, dim2, r));
+}
+
+
+static int evalNumeric(symbolType *expr, double *d) {
+	valueType v = {valNumeric, 0, NULL};
+	if (eval(expr, &v)) {
+		valueClear(&v);
+		return(1);
+	}
+	*d = valueGetNumeric(&v);
+	valueClear(&v);
+	return(0);
+}
+
+
+static char *evalString(symbolType *expr) {
+	valueType v = {valNumeric, 0, NULL};
+	char *s = NULL;
+	if (eval(expr, &v) == 0) {
+		s = valueGetString(&v);
+	}
+	valueClear(&v);
+	return(s);
 }
 
 
@@ -8,6 +8,7 @@
 
 #include <stdarg.h>
 
+#include "arena.h"
 #include "scan.h"
 
 
@@ -32,7 +33,10 @@ typedef struct progLineType {
 	instructionType *firstInstruction;
 	instructionType *lastInstruction;
 	instructionType *currentInstruction;
+	arenaType *arena;
 	long int lineNum;
+	unsigned long int runs;
+	struct progNativeType *native;
 } progLineType;
 
 
@@ -42,17 +46,33 @@ typedef struct progLineType {
 
 extern int progAppendInstruction(progLineType *p, keywords k, ...);
 
-extern void progDeleteExpression(symbolType *s);
+extern int progCreate(void);
 
 extern void progDeleteInstructions(instructionType *p);
 
 extern void progDeleteLine(progLineType *p);
 
+extern void progDestroy(void);
+
+extern int progEmitC(const char *fn);
+
 extern void progExecuteLine(progLineType *p);
 
 extern int progInit(void);
 
 extern progLineType *progInsertLine(int l);
 
+extern int progIsImage(const char *fn);
+
+extern int progLoadImage(const char *fn);
+
+extern int progRun(void);
+
+extern int progSaveImage(const char *fn);
+
+extern void progSetArgs(int ac, char **av);
+
+extern unsigned long int progStatementCount(void);
+
 
 #endif /* PROG_H */
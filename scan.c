@@ -7,24 +7,56 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
+#include "interp.h"
 #include "io.h"
 #include "scan.h"
 #include "util.h"
 
 
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define SCAN_TEXT_LEN_DEF 128
+#define KEYWORD_HASH_LEN 128
+
+
+/*
+ * LOCAL DATA TYPES
+ */
+
+/*
+ * The scanner of one interpreter: the symbol last scanned, with its text,
+ * and the arena new symbols are made in.
+ */
+typedef struct scanStateType {
+	symbolType current;
+	arenaType *arena;
+	char *text;
+	unsigned long int textLen;
+	unsigned long int textMax;
+	unsigned long int textHash;
+} scanStateType;
+
+
 /*
  * LOCAL DATA
+ *
+ * The keyword tables are shared; the rest name the state of the current
+ * interpreter.
  */
 
-static symbolType *keywordTree = NULL;
 static symbolType keywordTable[] = {
 	{NULL, NULL, "and", kwAND},
 	{NULL, NULL, "or", kwOR},
 	{NULL, NULL, "not", kwNOT},
 	{NULL, NULL, "bye", kwBYE},
+	{NULL, NULL, "cload", kwCLOAD},
 	{NULL, NULL, "clr", kwCLR},
 	{NULL, NULL, "cls", kwCLS},
 	{NULL, NULL, "cont", kwCONT},
+	{NULL, NULL, "csave", kwCSAVE},
 	{NULL, NULL, "data", kwDATA},
 	{NULL, NULL, "dim", kwDIM},
 	{NULL, NULL, "end", kwEND},
@@ -69,43 +101,34 @@ static symbolType keywordTable[] = {
 	{NULL, NULL, "chr$", kwCHR},
 	{NULL, NULL, "str$", kwSTR}
 };
-static symbolType *scanCurrent = NULL;
 static symbolType *idToKeywordTable[kwNumKeywords];
+static symbolType *keywordHash[KEYWORD_HASH_LEN];
+
+#define scanCurrent (&interpCurrent->scanState->current)
+#define scanArena (interpCurrent->scanState->arena)
+#define scanText (interpCurrent->scanState->text)
+#define scanTextLen (interpCurrent->scanState->textLen)
+#define scanTextMax (interpCurrent->scanState->textMax)
+#define scanTextHash (interpCurrent->scanState->textHash)
 
 
 /*
  * LOCAL FUNCTIONS
  */
 
-static int cmpKeywords(const void *a, const void *b);
-static char *scanGetName(void);
-static char *scanGetNum(void);
-static char *scanGetOp(void);
-static char *scanGetString(void);
-static symbolType *insertSymbol(symbolType *p, long s, long e);
+static void scanAppend(char c);
+static int scanGetLOp(void);
+static int scanGetName(void);
+static int scanGetNum(void);
+static int scanGetOp(void);
+static int scanGetString(void);
+static unsigned long int scanHash(unsigned long int h, char c);
 static int isop(char c);
-static int lookup(symbolType *t, char *s);
-static void scanExit(void);
+static int islop(char c);
+static int lookup(const char *s, unsigned long int h);
 static void skipWhite(void);
 
 
-static int cmpKeywords(const void *a, const void *b) {
-	return(strcmp(((symbolType *)a)->value, ((symbolType *)b)->value));
-}
-
-
-static symbolType *insertSymbol(symbolType *p, long s, long e) {
-	if (s > e) {
-		return(NULL);
-	}
-	long m = (s + e) / 2;
-	symbolType *root = &p[m];
-	root->l = insertSymbol(p, s, m - 1);
-	root->r = insertSymbol(p, m + 1, e);
-	return(root);
-}
-
-
 static int isop(char c) {
 	return(c == '+' || c == '-' || c == '*' || c == '/' || c == '^');
 }
@@ -116,23 +139,18 @@ static int islop(char c) {
 }
 
 
-static int lookup(symbolType *t, char *s) {
-	if (s == NULL) {
-		return(-1);
-	}
-	int i;
-	while (t != NULL) {
-		i = strcasecmp(t->value, s);
-		if (i == 0) {
-			break;
-		} else if (i < 0) {
-			t = t->r;
-		} else {
-			t = t->l;
+/*
+ * Find the keyword s, whose hash h was worked out as it was scanned. Only
+ * the keyword in the slot the hash leads to is compared with s.
+ */
+static int lookup(const char *s, unsigned long int h) {
+	symbolType *t;
+	h &= KEYWORD_HASH_LEN - 1;
+	while ((t = keywordHash[h]) != NULL) {
+		if (!strcasecmp(t->value, s)) {
+			return(t->id);
 		}
-	}
-	if (t != NULL) {
-		return(t->id);
+		h = (h + 1) & (KEYWORD_HASH_LEN - 1);
 	}
 	return(-1);
 }
@@ -152,197 +170,210 @@ char *scanGetKeyword(keywords k) {
 }
 
 
-static char *scanGetLOp(void) {
-	char *s = malloc(3);
-	char *t = s;
+static int scanGetLOp(void) {
 	switch (ioPeek()) {
 		case '<':
-			*t++ = '<';
 			ioNext();
-			if (ioPeek() == '=' || ioPeek() == '>') {
-				*t++ = ioPeek();
+			if (ioPeek() == '=') {
+				scanCurrent->id = kwLogicalLTE;
 				ioNext();
+			} else if (ioPeek() == '>') {
+				scanCurrent->id = kwLogicalNE;
+				ioNext();
+			} else {
+				scanCurrent->id = kwLogicalLT;
 			}
-			*t = 0;
-			skipWhite();
-			return(s);
+			break;
 		case '>':
-			*t++ = '>';
 			ioNext();
 			if (ioPeek() == '=') {
-				*t++ = ioPeek();
+				scanCurrent->id = kwLogicalGTE;
 				ioNext();
+			} else {
+				scanCurrent->id = kwLogicalGT;
 			}
-			*t = 0;
-			skipWhite();
-			return(s);
+			break;
 		case '=':
-			*t++ = '=';
-			*t = 0;
 			ioNext();
-			skipWhite();
-			return(s);
-	}
-	if (s) {
-		free(s);
+			scanCurrent->id = kwLogicalEQ;
+			break;
+		default:
+			return(1);
 	}
-	return(NULL);
+	skipWhite();
+	return(0);
 }
 
 
-static char *scanGetName(void) {
-	char *s = malloc(maxStringLen + 1);
-	char *t = s;
-	int i = maxStringLen;
-	if (s == NULL) {
-		aborts("memory allocation error");
+/*
+ * Append c to the text of the current token. The buffer grows as needed, so
+ * names, numbers and strings can be any length.
+ */
+static void scanAppend(char c) {
+	unsigned long int max;
+	char *t;
+	if (scanTextLen + 1 >= scanTextMax) {
+		max = scanTextMax << 1;
+		if ((t = realloc(scanText, max)) == NULL) {
+			aborts("memory allocation error");
+		}
+		scanText = t;
+		scanTextMax = max;
+		scanCurrent->value = scanText;
 	}
+	scanText[scanTextLen++] = c;
+	scanText[scanTextLen] = 0;
+}
+
+
+static int scanGetName(void) {
+	scanTextLen = 0;
+	scanText[0] = 0;
 	if (!isalpha(ioPeek())) {
-		utilError("expected alphabetic character\n");
-		free(s);
-		return(NULL);
+		utilError("expected alphabetic character");
+		return(1);
 	}
-	while (i > 0 && (isalnum(ioPeek()) || ioPeek() == '$')) {
-		*t++ = ioPeek();
+	scanTextHash = 2166136261UL;
+	while (isalnum(ioPeek()) || ioPeek() == '$') {
+		scanAppend(ioPeek());
+		scanTextHash = scanHash(scanTextHash, ioPeek());
 		ioNext();
-		i--;
-	}
-	if (i < 0) {
-		utilError("string exceeds maximum length of %i\n", maxStringLen);
-		free(s);
-		return(NULL);
 	}
-	*t = 0;
 	skipWhite();
-	return(s);
+	return(0);
 }
 
 
-static char *scanGetNum(void) {
-	char *s = malloc(maxStringLen + 1);
-	char *t = s;
-	int i = maxStringLen;
+static int scanGetNum(void) {
+	scanTextLen = 0;
+	scanText[0] = 0;
 	if (!isdigit(ioPeek())) {
 		utilError("expected digit");
-		return(NULL);
+		return(1);
 	}
-	while (i >= 0 && (isdigit(ioPeek()) || ioPeek() == '.')) {
-		*t++ = ioPeek();
+	while (isdigit(ioPeek()) || ioPeek() == '.') {
+		scanAppend(ioPeek());
 		ioNext();
-		i--;
 	}
-	if (i < 0) {
-		utilError("string exceeds maximum length of %i", maxStringLen);
-		free(s);
-		return(NULL);
-	}
-	*t = 0;
 	skipWhite();
-	return(s);
+	return(0);
 }
 
 
-static char *scanGetOp(void) {
-	char *s = malloc(maxStringLen + 1);
-	char *t = s;
-	int i = maxStringLen;
-	if (s == NULL) {
-		aborts("memory allocation error");
-	}
-	if (!isop(ioPeek())) {
-		utilError("expected operator");
-		free(s);
-		return(NULL);
-	}
-	while (i >= 0 && isop(ioPeek())) {
-		*t++ = ioPeek();
-		ioNext();
-		i--;
-	}
-	if (i < 0) {
-		utilError("string exceeds maximum length of %i", maxStringLen);
-		free(s);
-		return(NULL);
+static int scanGetOp(void) {
+	switch (ioPeek()) {
+		case '+':
+			scanCurrent->id = kwOpAdd;
+			break;
+		case '-':
+			scanCurrent->id = kwOpSub;
+			break;
+		case '*':
+			scanCurrent->id = kwOpMul;
+			break;
+		case '/':
+			scanCurrent->id = kwOpDiv;
+			break;
+		case '^':
+			scanCurrent->id = kwOpExp;
+			break;
+		default:
+			utilError("expected operator");
+			return(1);
 	}
-	*t = 0;
+	ioNext();
 	skipWhite();
-	return(s);
+	return(0);
 }
 
 
-static char *scanGetString(void) {
-	char *s = malloc(maxStringLen + 1);
-	char *t = s;
-	int i = maxStringLen;
-	if (s == NULL) {
-		utilError("memory allocation error");
-		return(NULL);
-	}
+static int scanGetString(void) {
+	scanTextLen = 0;
+	scanText[0] = 0;
 	if (ioPeek() != '"') {
 		utilError("expected quote");
-		free(s);
-		return(NULL);
+		return(1);
 	}
 	ioNext();
-	while (i >= 0 && ioPeek() != '"' && ioPeek() != '\n' && ioPeek() != IO_EOF) {
-		*t++ = ioPeek();
+	while (ioPeek() != '"' && ioPeek() != '\n' && ioPeek() != IO_EOF) {
+		scanAppend(ioPeek());
 		ioNext();
-		i--;
-	}
-	if (i < 0) {
-		utilError("string exceeds maximum length of %i\n", maxStringLen);
-		free(s);
-		return(NULL);
 	}
 	if (ioPeek() == '\n' || ioPeek() == IO_EOF) {
-		utilError("unterminated string\n");
-		free(s);
-		return(NULL);
+		utilError("unterminated string");
+		return(1);
 	}
-	*t = 0;
 	ioNext();
 	skipWhite();
-	return(s);
+	return(0);
+}
+
+
+/*
+ * Add c to the hash h of a name, ignoring case, so keywords can be looked up
+ * without another pass over the text.
+ */
+static unsigned long int scanHash(unsigned long int h, char c) {
+	return((h ^ (unsigned char)tolower((unsigned char)c)) * 16777619UL);
 }
 
 
 symbolType *scanGetText(void) {
-	char *s = malloc(maxStringLen + 1);
-	char *t = scanCurrent->value;
-	int i = maxStringLen;
-	while (i >= 0 && ioPeek() != '\n' && ioPeek() != IO_EOF) {
-		*t++ = ioPeek();
+	scanTextLen = 0;
+	scanText[0] = 0;
+	while (ioPeek() != '\n' && ioPeek() != IO_EOF) {
+		scanAppend(ioPeek());
 		ioNext();
-		i--;
-	}
-	if (i < 0) {
-		utilError("string exceeds maximum length of %i\n", maxStringLen);
-		return(NULL);
 	}
-	*t = 0;
 	scanCurrent->id = kwText;
 	return(scanCurrent);
 }
 
 
-static void scanExit(void) {
-    if (scanCurrent != NULL) {
-        free(scanCurrent);
-    }
+int scanCreate(void) {
+	if ((interpCurrent->scanState = calloc(1, sizeof(scanStateType))) == NULL) {
+		return(1);
+	}
+	if ((scanText = malloc(SCAN_TEXT_LEN_DEF)) == NULL) {
+		return(1);
+	}
+	scanText[0] = 0;
+	scanTextMax = SCAN_TEXT_LEN_DEF;
+	scanCurrent->value = scanText;
+	scanCurrent->id = kwEof;
+	scanCurrent->slot = -1;
+	return(0);
+}
+
+
+void scanDestroy(void) {
+	if (interpCurrent->scanState == NULL) {
+		return;
+	}
+	if (scanText != NULL) {
+		free(scanText);
+	}
+	free(interpCurrent->scanState);
+	interpCurrent->scanState = NULL;
 }
 
 
 int scanInit(void) {
-	long l = sizeof(keywordTable) / sizeof(symbolType);
+	unsigned long int l;
+	unsigned long int h;
+	char *t;
 	long i;
-	qsort(keywordTable, l, sizeof(symbolType), cmpKeywords);
-	if ((keywordTree = insertSymbol(keywordTable, 0, l - 1)) == NULL) {
-		return(1);
+	for (l = 0; l < sizeof(keywordTable) / sizeof(symbolType); l++) {
+		h = 2166136261UL;
+		for (t = keywordTable[l].value; *t; t++) {
+			h = scanHash(h, *t);
+		}
+		h &= KEYWORD_HASH_LEN - 1;
+		while (keywordHash[h] != NULL) {
+			h = (h + 1) & (KEYWORD_HASH_LEN - 1);
+		}
+		keywordHash[h] = &keywordTable[l];
 	}
-	atexit(scanExit);
-    if ((scanCurrent = malloc(sizeof(symbolType) + maxStringLen + 1)) == NULL) {
-        return(1);
-    }
 	for (i = 0; i < kwNumKeywords; i++) {
 		for (l = 0; l < sizeof(keywordTable) / sizeof(symbolType); l++) {
 			if (keywordTable[l].id == i) {
@@ -350,10 +381,6 @@ int scanInit(void) {
 			}
 		}
 	}
-    scanCurrent->l = NULL;
-    scanCurrent->r = NULL;
-    scanCurrent->value = (char *)scanCurrent + sizeof(symbolType);
-    scanCurrent->id = kwEof;
 	return(0);
 }
 
@@ -364,12 +391,13 @@ symbolType *scanNewSymbol(keywords k, char *v) {
 	if (v != NULL) {
 		l = strlen(v) + 1;
 	}
-	if ((s = malloc(sizeof(symbolType) + l)) == NULL) {
-		utilError("couldn't allocate memory");
+	if ((s = arenaAlloc(scanArena, sizeof(symbolType) + l)) == NULL) {
 		return(NULL);
 	}
 	s->l = s->r = NULL;
 	s->id = k;
+	s->slot = -1;
+	s->code = NULL;
 	s->value = (char *)s + sizeof(symbolType);
 	if (l > 0) {
 		strcpy(s->value, v);
@@ -381,7 +409,6 @@ symbolType *scanNewSymbol(keywords k, char *v) {
 
 
 int scanNext(void) {
-	char *s = NULL;
 	int i;
 	skipWhite();
 	if (ioPeek() == IO_EOF) {
@@ -424,69 +451,37 @@ int scanNext(void) {
 		skipWhite();
 		return(0);
 	} else if (isalpha(ioPeek())) {
-		if ((s = scanGetName()) != NULL) {
-            i = lookup(keywordTree, s);
+		if (scanGetName() == 0) {
+            i = lookup(scanText, scanTextHash);
             if (i == -1) {
                 scanCurrent->id = kwIdentifier;
-            	strcpy(scanCurrent->value, s);
             } else {
                 scanCurrent->id = i;
 				scanCurrent->value[0] = 0;
             }
-            free(s);
             return(0);
         }
         return(1);
 	} else if (isdigit(ioPeek())) {
-        if ((s = scanGetNum()) != NULL) {
+        if (scanGetNum() == 0) {
             scanCurrent->id = kwNumeric;
-            strcpy(scanCurrent->value, s);
-            free(s);
             return(0);
         }
         return(1);
 	} else if (isop(ioPeek())) {
-		if ((s = scanGetOp()) != NULL) {
+		if (scanGetOp() == 0) {
 			scanCurrent->value[0] = 0;
-			if (!strcmp(s, "+")) {
-            	scanCurrent->id = kwOpAdd;
-			} else if (!strcmp(s, "-")) {
-				scanCurrent->id = kwOpSub;
-			} else if (!strcmp(s, "*")) {
-				scanCurrent->id = kwOpMul;
-			} else if (!strcmp(s, "/")) {
-				scanCurrent->id = kwOpDiv;
-			} else if (!strcmp(s, "^")) {
-				scanCurrent->id = kwOpExp;
-			}
-            free(s);
             return(0);
         }
 		return(1);
 	} else if (islop(ioPeek())) {
-		if ((s = scanGetLOp()) != NULL) {
+		if (scanGetLOp() == 0) {
 			scanCurrent->value[0] = 0;
-			if (!strcmp(s, "<")) {
-				scanCurrent->id = kwLogicalLT;
-			} else if (!strcmp(s, "<=")) {
-				scanCurrent->id = kwLogicalLTE;
-			} else if (!strcmp(s, "=")) {
-				scanCurrent->id = kwLogicalEQ;
-			} else if (!strcmp(s, "<>")) {
-				scanCurrent->id = kwLogicalNE;
-			} else if (!strcmp(s, ">")) {
-				scanCurrent->id = kwLogicalGT;
-			} else if (!strcmp(s, ">=")) {
-				scanCurrent->id = kwLogicalGTE;
-			}
-			free(s);
 			return(0);
 		}
 	} else if (ioPeek() == '"') {
-		if ((s = scanGetString()) != NULL) {
+		if (scanGetString() == 0) {
             scanCurrent->id = kwString;
-            strcpy(scanCurrent->value, s);
-            free(s);
             return(0);
         }
         return(1);
@@ -501,6 +496,11 @@ symbolType *scanPeek(void) {
 }
 
 
+void scanSetArena(arenaType *a) {
+	scanArena = a;
+}
+
+
 static void skipWhite(void) {
 	while (isspace(ioPeek()) && ioPeek() != '\n') {
 		ioNext();
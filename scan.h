@@ -6,15 +6,20 @@
 #define SCAN_H
 
 
+#include "arena.h"
+
+
 /*
  * GLOBAL DATA TYPES
  */
 
 typedef enum {
 	kwBYE,				
+	kwCLOAD,
 	kwCLR,				
 	kwCLS,
 	kwCONT,
+	kwCSAVE,
 	kwDATA,
 	kwDIM,
 	kwEND,
@@ -96,6 +101,8 @@ typedef struct symbolType {
 	struct symbolType *r;
 	char *value;
 	keywords id;
+	long int slot;
+	struct codeType *code;
 } symbolType;
 
 
@@ -105,6 +112,10 @@ typedef struct symbolType {
 
 extern int scanConsumeEol(void);
 
+extern int scanCreate(void);
+
+extern void scanDestroy(void);
+
 extern char *scanGetKeyword(keywords k);
 
 extern symbolType *scanGetText(void);
@@ -117,5 +128,7 @@ extern int scanNext(void);
 
 extern symbolType *scanPeek(void);
 
+extern void scanSetArena(arenaType *a);
+
 
 #endif /* SCAN_H */
@@ -0,0 +1,74 @@
+#!/bin/sh
+#
+# image.sh
+#
+# Check that CLOAD refuses damaged program images cleanly. The demo programs
+# are saved as images, and a hundred or so truncations of each and copies
+# with random bytes overwritten are loaded and listed. Each must load or
+# fail with an error; a crash or a hang fails the test. The interpreter
+# binary defaults to ../abasic relative to this directory; the number of
+# overwritten copies of each image can be given as the second argument.
+#
+
+dir=$(cd "$(dirname "$0")" && pwd)
+abasic=${1:-$dir/../abasic}
+mutations=${2:-100}
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+failed=0
+
+# check name
+#
+# CLOAD and LIST $tmp/test.img, failing if abasic was killed by a signal or
+# didn't finish in time.
+check() {
+	printf 'cload "%s"\nlist\nbye\n' "$tmp/test.img" | timeout 10 "$abasic" > /dev/null 2>&1
+	rc=$?
+	if [ $rc -ge 124 ]; then
+		echo "FAIL $1 (exit status $rc)"
+		failed=$((failed + 1))
+	fi
+}
+
+for f in "$dir"/../demos/*.bas; do
+	name=$(basename "$f" .bas)
+	printf 'load "%s"\ncsave "%s"\nbye\n' "$f" "$tmp/$name.img" | "$abasic" > /dev/null
+	size=$(wc -c < "$tmp/$name.img")
+	if printf 'cload "%s"\nbye\n' "$tmp/$name.img" | "$abasic" 2>&1 | grep -q ERROR; then
+		echo "FAIL $name (image doesn't load)"
+		failed=$((failed + 1))
+	fi
+	i=0
+	while [ $i -lt "$size" ]; do
+		head -c $i "$tmp/$name.img" > "$tmp/test.img"
+		check "$name-truncated-$i"
+		i=$((i + size / 100 + 1))
+	done
+	# Overwrite one to four bytes after the 32 byte header with random values.
+	awk -v n="$mutations" -v size="$size" -v seed="$(printf '%s' "$name" | cksum | cut -d' ' -f1)" 'BEGIN {
+		srand(seed)
+		for (i = 0; i < n; i++) {
+			m = 1 + int(rand() * 4)
+			line = i
+			for (j = 0; j < m; j++) {
+				line = line " " (32 + int(rand() * (size - 32))) " " int(rand() * 256)
+			}
+			print line
+		}
+	}' > "$tmp/mutations"
+	while read -r i edits; do
+		cp "$tmp/$name.img" "$tmp/test.img"
+		set -- $edits
+		while [ $# -ge 2 ]; do
+			printf "$(printf '\\%03o' "$2")" | dd of="$tmp/test.img" bs=1 seek="$1" conv=notrunc 2> /dev/null
+			shift 2
+		done
+		check "$name-mutated-$i"
+	done < "$tmp/mutations"
+done
+
+if [ $failed -gt 0 ]; then
+	echo "$failed image tests failed"
+	exit 1
+fi
+echo "image tests passed"
@@ -7,30 +7,23 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "io.h"
 #include "util.h"
 
 
-/*
- * CONSTANTS
- */
-
-#define MAX_STRING_LEN_DEF 128
-
-
 /*
  * DATA
  */
 
 unsigned long int sBufferIncrementz = 128;
-int maxStringLen = MAX_STRING_LEN_DEF;
 
 
 void aborts(char *s, ...) {
 	va_list vl;
 	va_start(vl, s);
-	printf("ERROR: ");
-	vprintf(s, vl);
-	printf("\n");
+	ioPrintf("ERROR: ");
+	ioVPrintf(s, vl);
+	ioPrintf("\n");
 	va_end(vl);
 	exit(1);
 }
@@ -38,16 +31,20 @@ void aborts(char *s, ...) {
 
 void utilError(char *s, ...) {
 	va_list vl;
+	utilErrors++;
 	va_start(vl, s);
-	printf("ERROR: ");
-	vprintf(s, vl);
-	printf("\n");
+	ioPrintf("ERROR: ");
+	ioVPrintf(s, vl);
+	ioPrintf("\n");
 	va_end(vl);
 }
 
 
 void utilReady(void) {
-	printf("\nready\n");
+	if (utilQuiet) {
+		return;
+	}
+	ioPrintf("\nready\n");
 }
 
 
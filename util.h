@@ -6,7 +6,15 @@
 #define UTIL_H
 
 
-extern int maxStringLen;
+#include "interp.h"
+
+
+/*
+ * The number of errors reported by, and the quiet flag of, the current
+ * interpreter. A quiet interpreter doesn't prompt.
+ */
+#define utilErrors (interpCurrent->errors)
+#define utilQuiet (interpCurrent->quiet)
 
 
 extern void aborts(char *s, ...);
@@ -0,0 +1,340 @@
+/*
+ * value.c
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interp.h"
+#include "util.h"
+#include "value.h"
+
+
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define MAX_WHOLE_NUMBER 1e15
+#define INTERN_LEN_DEF 256
+#define REFS_INTERNED ((unsigned long int)-1)
+
+
+/*
+ * LOCAL DATA TYPES
+ */
+
+/*
+ * The header in front of the text of every shared string, which carries its
+ * length so nothing has to scan for the terminator. A string with refs of
+ * REFS_INTERNED belongs to the intern table and is never released.
+ */
+typedef struct stringType {
+	unsigned long int refs;
+	unsigned long int len;
+	char text[];
+} stringType;
+
+/*
+ * The intern table of one interpreter.
+ */
+typedef struct valueStateType {
+	char **internTable;
+	unsigned long int internLen;
+	unsigned long int internMax;
+} valueStateType;
+
+
+/*
+ * LOCAL DATA
+ *
+ * These name the state of the current interpreter.
+ */
+
+#define internTable (interpCurrent->valueState->internTable)
+#define internLen (interpCurrent->valueState->internLen)
+#define internMax (interpCurrent->valueState->internMax)
+
+
+/*
+ * LOCAL FUNCTIONS
+ */
+
+static unsigned long int valueHashString(const char *s);
+static stringType *valueHeader(char *s);
+static int valueRehash(unsigned long int len);
+static char *valueStringAlloc(const char *s, unsigned long int len, unsigned long int refs);
+
+
+void valueClear(valueType *v) {
+	if (v->s != NULL) {
+		valueStringRelease(v->s);
+	}
+	v->type = valNumeric;
+	v->n = 0;
+	v->s = NULL;
+}
+
+
+int valueCompare(const valueType *v1, const valueType *v2) {
+	double d1;
+	double d2;
+	if (v1->type == valString && v2->type == valString) {
+		return(strcmp(v1->s != NULL ? v1->s : "", v2->s != NULL ? v2->s : ""));
+	}
+	d1 = valueGetNumeric(v1);
+	d2 = valueGetNumeric(v2);
+	if (d1 < d2) {
+		return(-1);
+	} else if (d1 > d2) {
+		return(1);
+	}
+	return(0);
+}
+
+
+int valueCopy(valueType *d, const valueType *s) {
+	if (s->type == valString) {
+		valueSetStringRef(d, valueStringRetain(s->s));
+		return(0);
+	}
+	valueSetNumeric(d, s->n);
+	return(0);
+}
+
+
+int valueCreate(void) {
+	if ((interpCurrent->valueState = calloc(1, sizeof(valueStateType))) == NULL) {
+		return(1);
+	}
+	return(0);
+}
+
+
+void valueDestroy(void) {
+	unsigned long int i;
+	if (interpCurrent->valueState == NULL) {
+		return;
+	}
+	for (i = 0; i < internMax; i++) {
+		if (internTable[i] != NULL) {
+			free(valueHeader(internTable[i]));
+		}
+	}
+	if (internTable != NULL) {
+		free(internTable);
+	}
+	free(interpCurrent->valueState);
+	interpCurrent->valueState = NULL;
+}
+
+
+/*
+ * Whole numbers, which is nearly everything a program prints, have their
+ * digits produced directly rather than through sprintf.
+ */
+char *valueFormatNumeric(double d, char *b) {
+	char t[VALUE_NUMERIC_LEN];
+	char *p = b;
+	long long int i;
+	int n = 0;
+	if (fabs(d) < MAX_WHOLE_NUMBER) {
+		if (d == trunc(d)) {
+			i = d;
+			if (i < 0) {
+				*p++ = '-';
+				i = -i;
+			}
+			do {
+				t[n++] = '0' + i % 10;
+				i /= 10;
+			} while (i > 0);
+			while (n > 0) {
+				*p++ = t[--n];
+			}
+			*p = 0;
+		} else {
+			sprintf(b, "%f", d);
+		}
+	} else {
+		sprintf(b, "%g", d);
+	}
+	return(b);
+}
+
+
+double valueGetNumeric(const valueType *v) {
+	if (v->type == valString) {
+		if (v->s == NULL) {
+			return(0);
+		}
+		return(strtod(v->s, NULL));
+	}
+	return(v->n);
+}
+
+
+char *valueGetString(const valueType *v) {
+	char b[VALUE_NUMERIC_LEN];
+	char *s;
+	if (v->type == valString) {
+		s = strdup(v->s != NULL ? v->s : "");
+	} else {
+		s = strdup(valueFormatNumeric(v->n, b));
+	}
+	if (s == NULL) {
+		utilError("couldn't allocate memory");
+	}
+	return(s);
+}
+
+
+static unsigned long int valueHashString(const char *s) {
+	unsigned long int h = 2166136261UL;
+	while (*s) {
+		h ^= (unsigned char)*s++;
+		h *= 16777619UL;
+	}
+	return(h);
+}
+
+
+static stringType *valueHeader(char *s) {
+	return((stringType *)(s - offsetof(stringType, text)));
+}
+
+
+static int valueRehash(unsigned long int len) {
+	char **table;
+	unsigned long int h;
+	unsigned long int i;
+	if ((table = calloc(len, sizeof(char *))) == NULL) {
+		utilError("couldn't allocate memory");
+		return(1);
+	}
+	for (i = 0; i < internMax; i++) {
+		if (internTable[i] != NULL) {
+			h = valueHashString(internTable[i]) & (len - 1);
+			while (table[h] != NULL) {
+				h = (h + 1) & (len - 1);
+			}
+			table[h] = internTable[i];
+		}
+	}
+	if (internTable != NULL) {
+		free(internTable);
+	}
+	internTable = table;
+	internMax = len;
+	return(0);
+}
+
+
+void valueSetNumeric(valueType *v, double d) {
+	valueClear(v);
+	v->n = d;
+}
+
+
+int valueSetString(valueType *v, const char *s) {
+	char *t = valueStringNew(s);
+	if (t == NULL) {
+		return(1);
+	}
+	valueSetStringRef(v, t);
+	return(0);
+}
+
+
+void valueSetStringRef(valueType *v, char *s) {
+	valueClear(v);
+	v->type = valString;
+	v->s = s;
+}
+
+
+static char *valueStringAlloc(const char *s, unsigned long int len, unsigned long int refs) {
+	stringType *t;
+	if ((t = malloc(sizeof(stringType) + len + 1)) == NULL) {
+		utilError("couldn't allocate memory");
+		return(NULL);
+	}
+	t->refs = refs;
+	t->len = len;
+	if (len > 0) {
+		memcpy(t->text, s, len);
+	}
+	t->text[len] = 0;
+	return(t->text);
+}
+
+
+char *valueStringIntern(const char *s) {
+	unsigned long int h;
+	char *t;
+	if (s == NULL) {
+		s = "";
+	}
+	if (internMax == 0 || internLen * 2 >= internMax) {
+		if (valueRehash(internMax == 0 ? INTERN_LEN_DEF : internMax << 1)) {
+			return(NULL);
+		}
+	}
+	h = valueHashString(s) & (internMax - 1);
+	while (internTable[h] != NULL) {
+		if (!strcmp(internTable[h], s)) {
+			return(internTable[h]);
+		}
+		h = (h + 1) & (internMax - 1);
+	}
+	if ((t = valueStringAlloc(s, strlen(s), REFS_INTERNED)) == NULL) {
+		return(NULL);
+	}
+	internTable[h] = t;
+	internLen++;
+	return(t);
+}
+
+
+unsigned long int valueStringLength(const char *s) {
+	if (s == NULL) {
+		return(0);
+	}
+	return(((const stringType *)(s - offsetof(stringType, text)))->len);
+}
+
+
+char *valueStringNew(const char *s) {
+	return(valueStringAlloc(s, s != NULL ? strlen(s) : 0, 1));
+}
+
+
+char *valueStringNewLen(const char *s, unsigned long int len) {
+	return(valueStringAlloc(s, len, 1));
+}
+
+
+void valueStringRelease(char *s) {
+	stringType *t;
+	if (s == NULL) {
+		return;
+	}
+	t = valueHeader(s);
+	if (t->refs != REFS_INTERNED && --t->refs == 0) {
+		free(t);
+	}
+}
+
+
+char *valueStringRetain(char *s) {
+	stringType *t;
+	if (s != NULL) {
+		t = valueHeader(s);
+		if (t->refs != REFS_INTERNED) {
+			t->refs++;
+		}
+	}
+	return(s);
+}
@@ -0,0 +1,224 @@
+/*
+ * value.h
+ *
+ * Tagged values. Expressions evaluate to a valueType, which is either numeric
+ * or a string. Numbers are carried as doubles and only converted to text when
+ * something (PRINT, STR$, string comparison) actually needs the text.
+ *
+ * Strings are immutable and reference counted. The text pointer in a
+ * valueType is a counted reference, so copying a value or assigning it to a
+ * variable shares the text instead of duplicating it, and valueClear drops
+ * the reference. String literals are interned once, when they are compiled,
+ * and live until exit. A NULL string is the empty string.
+ */
+
+#ifndef VALUE_H
+#define VALUE_H
+
+
+/*
+ * GLOBAL CONSTANTS
+ */
+
+#define VALUE_NUMERIC_LEN 64
+
+
+/*
+ * GLOBAL DATA TYPES
+ */
+
+typedef enum {
+	valNumeric,
+	valString
+} valueKind;
+
+typedef struct valueType {
+	valueKind type;
+	double n;
+	char *s;
+} valueType;
+
+
+/*
+ * GLOBAL FUNCTIONS
+ */
+
+
+/*
+ * valueClear
+ *
+ * Release any string held by v and reset it to the numeric value 0.
+ */
+extern void valueClear(valueType *v);
+
+
+/*
+ * valueCompare
+ *
+ * Compare v1 and v2. Two strings are compared as text; any other pairing is
+ * compared numerically.
+ *
+ * Returns
+ *
+ *	< 0 = v1 is less than v2
+ *	0 = v1 equals v2
+ *	> 0 = v1 is greater than v2
+ */
+extern int valueCompare(const valueType *v1, const valueType *v2);
+
+
+/*
+ * valueCopy
+ *
+ * Copy s into d, sharing its string. d is cleared first.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int valueCopy(valueType *d, const valueType *s);
+
+
+/*
+ * valueCreate
+ *
+ * Set up the intern table of the current interpreter.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int valueCreate(void);
+
+
+/*
+ * valueDestroy
+ *
+ * Free the intern table of the current interpreter, and the strings in it.
+ */
+extern void valueDestroy(void);
+
+
+/*
+ * valueFormatNumeric
+ *
+ * Format d into buffer b, which must hold at least VALUE_NUMERIC_LEN
+ * characters. Whole numbers are formatted without a fraction.
+ *
+ * Returns b.
+ */
+extern char *valueFormatNumeric(double d, char *b);
+
+
+/*
+ * valueGetNumeric
+ *
+ * Return the numeric value of v. Strings are converted with strtod.
+ */
+extern double valueGetNumeric(const valueType *v);
+
+
+/*
+ * valueGetString
+ *
+ * Return the text of v in a newly allocated string, which the caller must
+ * free.
+ *
+ * Returns
+ *
+ *	NULL = error
+ *	otherwise, the string
+ */
+extern char *valueGetString(const valueType *v);
+
+
+/*
+ * valueSetNumeric
+ *
+ * Clear v and set it to the number d.
+ */
+extern void valueSetNumeric(valueType *v, double d);
+
+
+/*
+ * valueSetString
+ *
+ * Clear v and set it to a copy of the string s.
+ *
+ * Returns
+ *
+ *	0 = success
+ *	1 = error
+ */
+extern int valueSetString(valueType *v, const char *s);
+
+
+/*
+ * valueSetStringRef
+ *
+ * Clear v and make it the string s, taking over the caller's reference to s.
+ */
+extern void valueSetStringRef(valueType *v, char *s);
+
+
+/*
+ * valueStringIntern
+ *
+ * Return the interned copy of s, creating it if needed. Interned strings are
+ * shared by everything that interns the same text, and retaining or
+ * releasing them has no effect.
+ *
+ * Returns
+ *
+ *	NULL = error
+ *	otherwise, the interned string
+ */
+extern char *valueStringIntern(const char *s);
+
+
+/*
+ * valueStringLength
+ *
+ * Return the length of the counted string s, without scanning it. NULL has
+ * length 0.
+ */
+extern unsigned long int valueStringLength(const char *s);
+
+
+/*
+ * valueStringNew, valueStringNewLen
+ *
+ * Return a new counted copy of s, or of its first len characters, holding
+ * one reference.
+ *
+ * Returns
+ *
+ *	NULL = error
+ *	otherwise, the string
+ */
+extern char *valueStringNew(const char *s);
+
+extern char *valueStringNewLen(const char *s, unsigned long int len);
+
+
+/*
+ * valueStringRelease
+ *
+ * Drop a reference to the counted string s, freeing it with the last one.
+ */
+extern void valueStringRelease(char *s);
+
+
+/*
+ * valueStringRetain
+ *
+ * Add a reference to the counted string s.
+ *
+ * Returns s.
+ */
+extern char *valueStringRetain(char *s);
+
+
+#endif /* VALUE_H */
@@ -6,250 +6,491 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "interp.h"
 #include "scan.h"
 #include "util.h"
+#include "value.h"
 #include "var.h"
 
 
+/*
+ * LOCAL CONSTANTS
+ */
+
+#define VAR_TABLE_LEN_DEF 64
+#define VAR_HASH_LEN_DEF 128
+#define DATA_TABLE_LEN_DEF 64
+
+
 /*
  * LOCAL DATA TYPES
  */
 
+/*
+ * Numeric variables keep their elements in a contiguous array of doubles and
+ * string variables in an array of counted strings, a NULL pointer being the
+ * empty string. A plain variable is a 1 by 1 array. Neither array exists
+ * until the variable is first dimensioned or assigned.
+ */
 typedef struct variableType {
-	struct variableType *next;
 	long dim1;
 	long dim2;
 	char *name;
-	char **value;
+	int isString;
+	double *num;
+	char **str;
 } variableType;
 
 typedef struct dataType {
-	struct dataType *next;
-	int lineNum;
+	long lineNum;
 	char *value;
+	double n;
 } dataType;
 
+/*
+ * The variables and DATA of one interpreter.
+ */
+typedef struct varStateType {
+	variableType *varTable;
+	long varTableLen;
+	long varTableMax;
+	long *varHash;
+	unsigned long varHashLen;
+	dataType *dataTable;
+	long dataTableLen;
+	long dataTableMax;
+	long dataPos;
+} varStateType;
+
 
 /*
  * LOCAL DATA
+ *
+ * These name the state of the current interpreter.
  */
 
-static variableType *varList = NULL;
-static dataType *dataList = NULL;
-static dataType *dataPtr = NULL;
+#define varTable (interpCurrent->varState->varTable)
+#define varTableLen (interpCurrent->varState->varTableLen)
+#define varTableMax (interpCurrent->varState->varTableMax)
+#define varHash (interpCurrent->varState->varHash)
+#define varHashLen (interpCurrent->varState->varHashLen)
+#define dataTable (interpCurrent->varState->dataTable)
+#define dataTableLen (interpCurrent->varState->dataTableLen)
+#define dataTableMax (interpCurrent->varState->dataTableMax)
+#define dataPos (interpCurrent->varState->dataPos)
 
 
 /*
  * LOCAL FUNCTIONS
  */
 
-static void varExit(void);
+static void varClear(variableType *var);
+static long varDataFind(long lineNum);
+static unsigned long varHashName(const char *name);
+static int varIndex(variableType *var, long dim1, long dim2, long *i);
+static int varIsString(const char *name);
+static int varRehash(unsigned long len);
 
 
+/*
+ * DATA items are kept in line number order, so RESTORE can binary search
+ * for its line and a DATA statement that runs again is not appended twice.
+ */
 int varAppendData(char **list, int lineNum) {
-	char **p = list;
-	dataType *dl = dataList;
-	dataType *dt = NULL;
-	if (dl) {
-		while (dl->next) {
-			if (dl->lineNum == lineNum) {
-				return(0);
-			}
-			dl = dl->next;
+	dataType *dt;
+	char **p;
+	long n = 0;
+	long max;
+	long i;
+	long j = 0;
+	i = varDataFind(lineNum);
+	if (i < dataTableLen && dataTable[i].lineNum == lineNum) {
+		return(0);
+	}
+	for (p = list; *p; p++) {
+		n++;
+	}
+	if (dataTableLen + n > dataTableMax) {
+		max = dataTableMax ? dataTableMax : DATA_TABLE_LEN_DEF;
+		while (dataTableLen + n > max) {
+			max <<= 1;
 		}
+		if ((dt = realloc(dataTable, sizeof(dataType) * max)) == NULL) {
+			utilError("memory allocation error");
+			return(1);
+		}
+		dataTable = dt;
+		dataTableMax = max;
 	}
-	while (*p) {
-		dt = malloc(sizeof(dataType) + strlen(*p) + 1);
-		if (dt == NULL) {
+	memmove(&dataTable[i + n], &dataTable[i], sizeof(dataType) * (dataTableLen - i));
+	for (j = 0; j < n; j++) {
+		dataTable[i + j].lineNum = lineNum;
+		if ((dataTable[i + j].value = strdup(list[j])) == NULL) {
 			utilError("memory allocation error");
 			goto err;
 		}
-		if (dl == NULL) {
-			dl = dataList = dataPtr = dt;
-		} else {
-			dl->next = dt;
-			dl = dt;
-		}
-		dl->next = NULL;
-		dl->value = (char *)dl + sizeof(dataType);
-		dl->lineNum = lineNum;
-		strcpy(dl->value, *p);
-		p++;
+		dataTable[i + j].n = strtod(list[j], NULL);
+	}
+	dataTableLen += n;
+	if (dataPos > i) {
+		dataPos += n;
 	}
 	return(0);
 err:
+	while (j-- > 0) {
+		free(dataTable[i + j].value);
+	}
+	memmove(&dataTable[i], &dataTable[i + n], sizeof(dataType) * (dataTableLen - i));
 	return(1);
 }
 
 
-static void varExit(void) {
+/*
+ * Return the index of the first DATA item at or after line lineNum.
+ */
+static long varDataFind(long lineNum) {
+	long lo = 0;
+	long hi = dataTableLen;
+	long mid;
+	while (lo < hi) {
+		mid = lo + ((hi - lo) >> 1);
+		if (dataTable[mid].lineNum < lineNum) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return(lo);
+}
+
+
+int varCreate(void) {
+	if ((interpCurrent->varState = calloc(1, sizeof(varStateType))) == NULL) {
+		return(1);
+	}
+	return(0);
+}
+
+
+void varDestroy(void) {
+	long i;
+	if (interpCurrent->varState == NULL) {
+		return;
+	}
 	varClearAll();
+	if (dataTable != NULL) {
+		free(dataTable);
+	}
+	for (i = 0; i < varTableLen; i++) {
+		free(varTable[i].name);
+	}
+	if (varTable != NULL) {
+		free(varTable);
+	}
+	if (varHash != NULL) {
+		free(varHash);
+	}
+	free(interpCurrent->varState);
+	interpCurrent->varState = NULL;
 }
 
 
-void varClearAll(void) {
-	variableType *vl = varList;
-	variableType *vt;
+static void varClear(variableType *var) {
 	long i;
-	while (vl) {
-		vt = vl->next;
-		if (vl->name != NULL) {
-			free(vl->name);
+	if (var->str != NULL) {
+		for (i = 0L; i < var->dim1 * var->dim2; i++) {
+			valueStringRelease(var->str[i]);
 		}
-		if (vl->value != NULL) {
-			for (i = 0L; i < vl->dim1 * vl->dim2; i++) {
-				if (vl->value[i] != NULL) {
-					free(vl->value[i]);
-				}
-			}
-		}
-		free(vl);
-		vl = vt;
+		free(var->str);
 	}
-	varList = NULL;
-	dataType *dl = dataList;
-	dataType *dt;
-	while (dl) {
-		dt = dl->next;
-		free(dl);
-		dl = dt;
+	if (var->num != NULL) {
+		free(var->num);
 	}
-	dataList = NULL;
-	dataPtr = NULL;
+	var->num = NULL;
+	var->str = NULL;
+	var->dim1 = 1;
+	var->dim2 = 1;
 }
 
 
-int varDim(const char *name, long dim1, long dim2) {
+void varClearAll(void) {
+	long i;
+	long j;
+	for (j = 0; j < varTableLen; j++) {
+		varClear(&varTable[j]);
+	}
+	for (i = 0L; i < dataTableLen; i++) {
+		if (dataTable[i].value != NULL) {
+			free(dataTable[i].value);
+		}
+	}
+	dataTableLen = 0;
+	dataPos = 0;
+}
+
+
+int varDim(long slot, long dim1, long dim2) {
+	variableType *var = &varTable[slot];
+	double *num = NULL;
+	char **str = NULL;
 	if (dim1 < 1) {
 		dim1 = 1;
 	}
 	if (dim2 < 1) {
 		dim2 = 1;
 	}
-	variableType *var = malloc(sizeof(variableType) + (sizeof(char *) * (dim1 * dim2)));
-	if (var == NULL) {
+	if (var->isString) {
+		str = calloc(dim1 * dim2, sizeof(char *));
+	} else {
+		num = calloc(dim1 * dim2, sizeof(double));
+	}
+	if (num == NULL && str == NULL) {
 		return(1);
 	}
-	memset(var, 0, sizeof(variableType) + (sizeof(char *) * (dim1 * dim2)));
-	var->next = varList;
-	var->name = strdup(name);
-	var->value = (char **)((char *)var + sizeof(variableType));
+	varClear(var);
+	var->num = num;
+	var->str = str;
 	var->dim1 = dim1;
 	var->dim2 = dim2;
-	varList = var;
 	return(0);
 }
 
 
-char *varGetValue(const char *name, long dim1, long dim2) {
-	variableType *var = varList;
+int varGetNumeric(long slot, long dim1, long dim2, double *d) {
+	variableType *var = &varTable[slot];
+	long i;
+	if (varIndex(var, dim1, dim2, &i)) {
+		return(1);
+	}
+	if (var->num != NULL) {
+		*d = var->num[i];
+	} else if (var->str != NULL && var->str[i] != NULL) {
+		*d = strtod(var->str[i], NULL);
+	} else {
+		*d = 0;
+	}
+	return(0);
+}
+
+
+int varGetValue(long slot, long dim1, long dim2, valueType *v) {
+	variableType *var = &varTable[slot];
 	long i;
+	if (varIndex(var, dim1, dim2, &i)) {
+		return(1);
+	}
+	if (var->isString) {
+		valueSetStringRef(v, var->str != NULL ? valueStringRetain(var->str[i]) : NULL);
+		return(0);
+	}
+	valueSetNumeric(v, var->num != NULL ? var->num[i] : 0);
+	return(0);
+}
+
+
+static unsigned long varHashName(const char *name) {
+	unsigned long h = 2166136261UL;
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619UL;
+	}
+	return(h);
+}
+
+
+/*
+ * Check that the 1-based subscripts dim1 and dim2 are within the dimensions
+ * of var, and store the offset of the element they select in i.
+ */
+static int varIndex(variableType *var, long dim1, long dim2, long *i) {
 	dim1--;
 	dim2--;
-	while (var) {
-		if (!strcmp(var->name, name)) {
-			if (dim1 >= var->dim1 || dim2 >= var->dim2) {
-				utilError("dimensions out of bounds");
-				return(NULL);
-			}
-			if (var->value != NULL) {
-				i = dim2 * var->dim1 + dim1;
-				return(strdup(var->value[i]));
-			} else {
-				return(NULL);
-			}
-		}
-		var = var->next;
+	if (dim1 < 0 || dim2 < 0 || dim1 >= var->dim1 || dim2 >= var->dim2) {
+		utilError("dimensions out of bounds");
+		return(1);
 	}
-	return(NULL);
+	*i = dim2 * var->dim1 + dim1;
+	return(0);
 }
 
 
-int varInit(void) {
-	atexit(varExit);
+int varIsNumeric(long slot) {
+	return(!varTable[slot].isString);
+}
+
+
+static int varIsString(const char *name) {
+	return(strchr(name, '$') != NULL);
+}
+
+
+long varLookup(const char *name) {
+	variableType *t;
+	unsigned long h;
+	if (varHashLen == 0 || varTableLen * 2 >= varHashLen) {
+		if (varRehash(varHashLen == 0 ? VAR_HASH_LEN_DEF : varHashLen << 1)) {
+			return(-1);
+		}
+	}
+	h = varHashName(name) & (varHashLen - 1);
+	while (varHash[h] != -1) {
+		if (!strcmp(varTable[varHash[h]].name, name)) {
+			return(varHash[h]);
+		}
+		h = (h + 1) & (varHashLen - 1);
+	}
+	if (varTableLen == varTableMax) {
+		long max = varTableMax == 0 ? VAR_TABLE_LEN_DEF : varTableMax << 1;
+		if ((t = realloc(varTable, sizeof(variableType) * max)) == NULL) {
+			utilError("couldn't allocate memory");
+			return(-1);
+		}
+		varTable = t;
+		varTableMax = max;
+	}
+	t = &varTable[varTableLen];
+	if ((t->name = strdup(name)) == NULL) {
+		utilError("couldn't allocate memory");
+		return(-1);
+	}
+	t->dim1 = 1;
+	t->dim2 = 1;
+	t->isString = varIsString(name);
+	t->num = NULL;
+	t->str = NULL;
+	varHash[h] = varTableLen;
+	return(varTableLen++);
 }
 
 
 char *varReadData(void) {
 	char *s;
-	if (dataPtr == NULL) {
+	if (dataPos >= dataTableLen) {
 		return(NULL);
 	}
-	s = strdup(dataPtr->value);
-	dataPtr = dataPtr->next;
+	if ((s = strdup(dataTable[dataPos].value)) != NULL) {
+		dataPos++;
+	}
 	return(s);
 }
 
 
-int varRestoreData(long int lineNum) {
-	if (lineNum == -1) {
-		dataPtr = dataList;
-		return(0);
-	}
-	dataType *d = dataList;
-	while (d) {
-		if (d->lineNum == lineNum) {
-			dataPtr = d;
-			return(0);
-		}
+/*
+ * The numeric value of each DATA item is converted once, when the item is
+ * added, so reading into a numeric variable doesn't copy or parse the text.
+ */
+int varReadNumeric(double *d) {
+	if (dataPos >= dataTableLen) {
+		return(1);
 	}
-	return(1);
+	*d = dataTable[dataPos++].n;
+	return(0);
 }
 
 
-int varSetValue(const char *name, const char *value, long dim1, long dim2) {
-	variableType *var = varList;
+static int varRehash(unsigned long len) {
+	long *hash;
+	unsigned long h;
 	long i;
-	if (name == NULL) {
-		return(1);
-	}
-	if (name[0] == 0) {
+	if ((hash = malloc(sizeof(long) * len)) == NULL) {
+		utilError("couldn't allocate memory");
 		return(1);
 	}
-	if (value == NULL) {
-		value = "";
+	for (h = 0; h < len; h++) {
+		hash[h] = -1;
 	}
-	dim1--;
-	dim2--;
-	while (var) {
-		if (!strcmp(var->name, name)) {
-			if (dim1 >= var->dim1 || dim2 >= var->dim2) {
-				utilError("dimensions out of bounds");
-				return(1);
-			}
-			if (var->value) {
-				i = dim2 * var->dim1 + dim1;
-				if (var->value[i]) {
-					free(var->value[i]);
-					var->value[i] = NULL;
-				}
-				var->value[i] = strdup(value);
-				if (var->value[i] == NULL) {
-					return(1);
-				}
-				return(0);
-			}
+	for (i = 0; i < varTableLen; i++) {
+		h = varHashName(varTable[i].name) & (len - 1);
+		while (hash[h] != -1) {
+			h = (h + 1) & (len - 1);
 		}
-		var = var->next;
+		hash[h] = i;
 	}
-	if (dim1 > 1 || dim2 > 1) {
-		utilError("dimensions out of bounds");
+	if (varHash != NULL) {
+		free(varHash);
+	}
+	varHash = hash;
+	varHashLen = len;
+	return(0);
+}
+
+
+/*
+ * Resolve element (dim1, dim2) of the variable in slot into r, checking the
+ * subscripts once. The storage of a plain variable is allocated here the
+ * first time it is assigned.
+ */
+int varRef(long slot, long dim1, long dim2, varRefType *r) {
+	variableType *var = &varTable[slot];
+	long i;
+	if (varIndex(var, dim1, dim2, &i)) {
 		return(1);
 	}
-	if ((var = malloc(sizeof(variableType) + sizeof(char *))) == NULL) {
+	if (var->num == NULL && var->str == NULL && varDim(slot, 1, 1)) {
+		utilError("couldn't allocate memory");
 		return(1);
 	}
-	var->next = varList;
-	var->name = strdup(name);
-	var->value = (char **)((char *)var + sizeof(variableType)); 
-	var->value[0] = strdup(value);
-	var->dim1 = 1;
-	var->dim2 = 1;
-	if (var->name == NULL || var->value[0] == NULL) {
-		free(var);
+	r->num = var->num != NULL ? &var->num[i] : NULL;
+	r->str = var->str != NULL ? &var->str[i] : NULL;
+	return(0);
+}
+
+
+int varRefSetNumeric(varRefType *r, double d) {
+	char b[VALUE_NUMERIC_LEN];
+	char *s;
+	if (r->num != NULL) {
+		*r->num = d;
+		return(0);
+	}
+	if ((s = valueStringNew(valueFormatNumeric(d, b))) == NULL) {
 		return(1);
 	}
-	varList = var;
+	valueStringRelease(*r->str);
+	*r->str = s;
+	return(0);
+}
+
+
+int varRefSetValue(varRefType *r, const valueType *value) {
+	char *s;
+	if (r->num != NULL) {
+		*r->num = valueGetNumeric(value);
+		return(0);
+	}
+	if (value->type != valString) {
+		return(varRefSetNumeric(r, value->n));
+	}
+	s = valueStringRetain(value->s);
+	valueStringRelease(*r->str);
+	*r->str = s;
 	return(0);
 }
 
+
+int varRestoreData(long int lineNum) {
+	if (lineNum == -1) {
+		dataPos = 0;
+		return(0);
+	}
+	dataPos = varDataFind(lineNum);
+	return(dataPos >= dataTableLen);
+}
+
+
+int varSetNumeric(long slot, double d, long dim1, long dim2) {
+	varRefType r;
+	if (varRef(slot, dim1, dim2, &r)) {
+		return(1);
+	}
+	return(varRefSetNumeric(&r, d));
+}
+
+
+int varSetValue(long slot, const valueType *value, long dim1, long dim2) {
+	varRefType r;
+	if (varRef(slot, dim1, dim2, &r)) {
+		return(1);
+	}
+	return(varRefSetValue(&r, value));
+}
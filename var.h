@@ -10,6 +10,22 @@
 #include <stdarg.h>
 
 #include "scan.h"
+#include "value.h"
+
+
+/*
+ * GLOBAL DATA TYPES
+ */
+
+/*
+ * A reference to one element of a variable, resolved by varRef. Exactly one
+ * of num and str is set, depending on the type of the variable. A reference
+ * stays valid until the variable is next dimensioned or cleared.
+ */
+typedef struct varRefType {
+	double *num;
+	char **str;
+} varRefType;
 
 
 /*
@@ -20,17 +36,35 @@ extern int varAppendData(char **d, int lineNum);
 
 extern void varClearAll(void);
 
-extern int varDim(const char *name, long dim1, long dim2);
+extern int varCreate(void);
+
+extern void varDestroy(void);
 
-extern char *varGetValue(const char *name, long dim1, long dim2);
+extern int varDim(long slot, long dim1, long dim2);
 
-extern int varInit(void);
+extern int varGetNumeric(long slot, long dim1, long dim2, double *d);
+
+extern int varGetValue(long slot, long dim1, long dim2, valueType *v);
+
+extern int varIsNumeric(long slot);
+
+extern long varLookup(const char *name);
 
 extern char *varReadData(void);
 
+extern int varReadNumeric(double *d);
+
+extern int varRef(long slot, long dim1, long dim2, varRefType *r);
+
+extern int varRefSetNumeric(varRefType *r, double d);
+
+extern int varRefSetValue(varRefType *r, const valueType *value);
+
 extern int varRestoreData(long int lineNum);
 
-extern int varSetValue(const char *name, const char *value, long dim1, long dim2);
+extern int varSetNumeric(long slot, double d, long dim1, long dim2);
+
+extern int varSetValue(long slot, const valueType *value, long dim1, long dim2);
 
 
 #endif /* VAR_H */